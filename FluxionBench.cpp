@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+#include "fluxion.h"
+#include "internals/Expression.h"
+#include "internals/Parser.h"
+#include "internals/Compiler.h"
+#include "internals/Context.h"
+#include "internals/Bytecode.h"
+#include "internals/Jit.h"
+#include "internals/DenseMultiplication.h"
+#include "internals/StaticFormula.h"
+#include "internals/Instrumentation.h"
+
+#define BENCH_MIN_PHASE_TIME 0.2 // Seconds each corpus is interpreted for at least.
+#define BENCH_MIN_ITERATIONS 5
+
+namespace {
+    std::atomic<std::size_t> allocations {0}; // Calls to operator new, in this process, the library included.
+}
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+    /**
+     * A generated source stressing one part of the interpreter.
+     */
+    struct Corpus {
+        std::string name;
+        std::string source;
+    };
+
+    const char *phaseNames[PHASE_COUNT] = {"parse", "compile", "evaluate", "getString"};
+
+    struct PhaseResult {
+        double nanoseconds; // Per iteration.
+        double allocations; // Per iteration.
+    };
+
+    struct CorpusResult {
+        const Corpus *corpus;
+        bool successful;
+        std::size_t iterations;
+        std::size_t tokens;
+        std::size_t arenaBytes;
+        std::size_t outputLength;
+        PhaseResult phases[PHASE_COUNT];
+        long peakRss; // Kilobytes, after running the corpus.
+    };
+
+    /**
+     * x0 + x1 + ... with distinct variables, nothing to simplify.
+     */
+    std::string flatSum(std::size_t terms) {
+        std::string source;
+        for (std::size_t i = 0; i < terms; i++) {
+            source += (i == 0 ? "x" : " + x") + std::to_string(i);
+        }
+        return source;
+    }
+
+    /**
+     * x0 * (x1 * (x2 * ...)), as deep as it is long.
+     */
+    std::string deepProduct(std::size_t depth) {
+        std::string source;
+        for (std::size_t i = 0; i + 1 < depth; i++) {
+            source += "x" + std::to_string(i) + " * (";
+        }
+        source += "x" + std::to_string(depth - 1);
+        source.append(depth - 1, ')');
+        return source;
+    }
+
+    /**
+     * 2 * x + 3 * x + ... which all collapse into a single term.
+     */
+    std::string likeTerms(std::size_t terms) {
+        std::string source;
+        for (std::size_t i = 0; i < terms; i++) {
+            source += (i == 0 ? "" : " + ") + std::to_string(i + 2) + " * x";
+        }
+        return source;
+    }
+
+    /**
+     * The same subtree repeated, which hash consing shares.
+     */
+    std::string repeatedSubtrees(std::size_t copies) {
+        std::string source;
+        for (std::size_t i = 0; i < copies; i++) {
+            source += (i == 0 ? "" : " + ") + std::string("(a * b + c / (a - b)) ^ 2");
+        }
+        return source;
+    }
+
+    /**
+     * Long literals with fractions, mixed with variables.
+     */
+    std::string largeConstants(std::size_t terms) {
+        std::string source;
+        std::uint64_t state = 88172645463325252ULL;
+        for (std::size_t i = 0; i < terms; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            std::string literal = std::to_string(state % 100000000000000ULL) + "." + std::to_string(state % 1000003);
+            source += (i == 0 ? "" : " + ") + literal + " * x" + std::to_string(i % 8);
+        }
+        return source;
+    }
+
+    std::vector<Corpus> generateCorpora() {
+        std::vector<Corpus> corpora;
+        for (std::size_t size : {16, 256, 2048}) {
+            corpora.push_back({"flat_sum_" + std::to_string(size), flatSum(size)});
+        }
+        for (std::size_t size : {16, 128, 512}) {
+            corpora.push_back({"deep_product_" + std::to_string(size), deepProduct(size)});
+        }
+        for (std::size_t size : {16, 256, 2048}) {
+            corpora.push_back({"like_terms_" + std::to_string(size), likeTerms(size)});
+        }
+        for (std::size_t size : {4, 64, 512}) {
+            corpora.push_back({"repeated_subtrees_" + std::to_string(size), repeatedSubtrees(size)});
+        }
+        for (std::size_t size : {16, 256, 2048}) {
+            corpora.push_back({"large_constants_" + std::to_string(size), largeConstants(size)});
+        }
+        return corpora;
+    }
+
+    /**
+     * @return the peak resident set size of the process in kilobytes, or -1 if unknown.
+     */
+    long peakRss() {
+#if defined(__unix__) || defined(__APPLE__)
+        struct rusage usage {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return -1;
+        }
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#else
+        return -1;
+#endif
+    }
+
+    /**
+     * Interpret the corpus in a fresh context over and over, timing every phase on its own.
+     */
+    CorpusResult runCorpus(const Corpus &corpus) {
+        CorpusResult result {};
+        result.corpus = &corpus;
+        result.successful = true;
+        double seconds[PHASE_COUNT] = {};
+        std::size_t allocated[PHASE_COUNT] = {};
+        Context context;
+        Context::Scope scope {context};
+        auto begin = std::chrono::steady_clock::now();
+        while (result.iterations < BENCH_MIN_ITERATIONS ||
+               std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() < BENCH_MIN_PHASE_TIME) {
+            auto time = std::chrono::steady_clock::now();
+            std::size_t count = allocations.load(std::memory_order_relaxed);
+            // Advances to the next phase, charging it the time and allocations since the last one.
+            auto lap = [&](InstrumentedPhase phase) {
+                auto now = std::chrono::steady_clock::now();
+                std::size_t nowCount = allocations.load(std::memory_order_relaxed);
+                seconds[phase] += std::chrono::duration<double>(now - time).count();
+                allocated[phase] += nowCount - count;
+                time = now;
+                count = nowCount;
+            };
+            Parser parser {corpus.source.c_str()};
+            ParsingStatus parsingStatus = parser.parse();
+            lap(PHASE_PARSE);
+            if (parsingStatus == PARSING_FAILED) {
+                result.successful = false;
+                break;
+            }
+            Compiler compiler {parser.getTokens()};
+            CompilationStatus compilationStatus = compiler.compile();
+            lap(PHASE_COMPILE);
+            if (compilationStatus == COMPILATION_FAILED) {
+                result.successful = false;
+                break;
+            }
+            Expression *simplified = compiler.getRoot()->evaluate();
+            lap(PHASE_EVALUATE);
+            std::string output = simplified->getString();
+            lap(PHASE_GET_STRING);
+            result.tokens = parser.getTokens().size();
+            result.outputLength = output.size();
+            result.arenaBytes = context.arena.bytesAllocated();
+            result.iterations++;
+            context.reset();
+        }
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            double iterations = result.iterations == 0 ? 1 : (double) result.iterations;
+            result.phases[phase].nanoseconds = seconds[phase] * 1e9 / iterations;
+            result.phases[phase].allocations = (double) allocated[phase] / iterations;
+        }
+        result.peakRss = peakRss();
+        return result;
+    }
+
+    double perToken(double value, const CorpusResult &result) {
+        return result.tokens == 0 ? 0 : value / (double) result.tokens;
+    }
+
+    struct EvaluationResult {
+        const char *formula;
+        double tree;
+        double bytecode;
+        double native;
+        double compiled; // Compiled at build time by StaticFormula.
+    };
+
+    // Listed once, so the formulas compiled at build time are the same as those parsed at run time.
+#define BENCH_FORMULAS(FORMULA) \
+    FORMULA("a * b + c") \
+    FORMULA("(a + b) * (a - 2) / 3 + a ^ 3 - b ^ 0.5 + c * a") \
+    FORMULA("a * 1.05 ^ b - c / (1 + a) ^ 2 + (a - c) * (b - c) * (a + b + c)") \
+    FORMULA("a ^ c + b ^ 2.5")
+#define BENCH_SOURCE(formula) formula,
+#define BENCH_STATIC(formula) [](const double *values) {return FLUXION_FORMULA(formula).evaluate(values);},
+
+    const char *formulas[] = {BENCH_FORMULAS(BENCH_SOURCE)};
+    double (*const staticFormulas[])(const double*) = {BENCH_FORMULAS(BENCH_STATIC)};
+
+    /**
+     * Evaluate by walking the expression tree, this is the baseline.
+     */
+    double evaluateTree(Expression *expression, const std::unordered_map<Expression*, double> &values) {
+        switch (expression->type) {
+            case EXPRESSION_CONSTANT:
+                return ((Constant*) expression)->getValue();
+            case EXPRESSION_VARIABLE:
+                return values.at(expression);
+            default:
+                break;
+        }
+        auto operation = (Operation*) expression;
+        double result = evaluateTree(operation->getOperand(0), values);
+        for (std::uint32_t i = 1; i < operation->getOperandCount(); i++) {
+            double operand = evaluateTree(operation->getOperand(i), values);
+            switch (operation->getOperationType()) {
+                case OP_ADD:
+                    result += operand;
+                    break;
+                case OP_MIN:
+                    result -= operand;
+                    break;
+                case OP_MUL:
+                    result *= operand;
+                    break;
+                case OP_DIV:
+                    result /= operand;
+                    break;
+                case OP_EXP:
+                    result = std::pow(result, operand);
+                    break;
+                default:
+                    return NAN;
+            }
+        }
+        return result;
+    }
+
+    void collectVariables(Expression *expression, std::unordered_map<std::string, Expression*> &found) {
+        if (expression->type == EXPRESSION_VARIABLE) {
+            found[((Variable*) expression)->getVariableName()] = expression;
+        } else if (expression->type == EXPRESSION_OPERATION) {
+            auto operation = (Operation*) expression;
+            for (std::uint32_t i = 0; i < operation->getOperandCount(); i++) {
+                collectVariables(operation->getOperand(i), found);
+            }
+        }
+    }
+
+    /**
+     * Time a function over a number of iterations.
+     *
+     * @return nanoseconds per iteration.
+     */
+    template <typename Function>
+    double measure(std::size_t iterations, Function function) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; i++) {
+            function(i);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(stop - start).count() / (double) iterations;
+    }
+
+    /**
+     * Compare evaluating simplified formulas numerically by walking the tree, with bytecode, with native code
+     * and compiled at build time.
+     */
+    std::vector<EvaluationResult> runEvaluations() {
+        const std::size_t iterations = 1000000;
+        volatile double sink = 0; // Keeps the evaluations from being optimised away.
+        std::vector<EvaluationResult> results;
+        for (std::size_t f = 0; f < sizeof(formulas) / sizeof(formulas[0]); f++) {
+            const char *formula = formulas[f];
+            fluxion::Session session;
+            Expression *expression = session.simplify(formula);
+            Program program {expression};
+            NativeCode native {expression};
+            std::vector<double> values(program.getVariables().size());
+            std::unordered_map<Expression*, double> bindings;
+            std::unordered_map<std::string, Expression*> variables;
+            collectVariables(expression, variables);
+            std::vector<Expression*> nodes;
+            for (const std::string &name : program.getVariables()) {
+                nodes.push_back(variables[name]);
+            }
+            for (std::size_t i = 0; i < values.size(); i++) {
+                values[i] = 1.25 + 0.5 * (double) i;
+            }
+            auto bind = [&](std::size_t i) {
+                values[0] = 1.25 + 1e-9 * (double) i;
+            };
+            double tree = measure(iterations, [&](std::size_t i) {
+                bind(i);
+                for (std::size_t v = 0; v < values.size(); v++) {
+                    bindings[nodes[v]] = values[v];
+                }
+                sink = sink + evaluateTree(expression, bindings);
+            });
+            double bytecode = measure(iterations, [&](std::size_t i) {
+                bind(i);
+                sink = sink + program.evaluate(values.data());
+            });
+            double nativeTime = measure(iterations, [&](std::size_t i) {
+                bind(i);
+                sink = sink + native.evaluate(values.data());
+            });
+            double compiled = measure(iterations, [&](std::size_t i) {
+                bind(i);
+                sink = sink + staticFormulas[f](values.data());
+            });
+            results.push_back({formula, tree, bytecode, nativeTime, compiled});
+        }
+        return results;
+    }
+
+    struct MultiplicationResult {
+        std::size_t size;
+        double schoolbook;
+        double karatsuba;
+        double ntt;
+    };
+
+    /**
+     * Time each dense multiplication on random integer polynomials of growing sizes, to find where one
+     * method overtakes the other.
+     */
+    std::vector<MultiplicationResult> runMultiplications() {
+        std::vector<MultiplicationResult> results;
+        std::uint64_t state = 88172645463325252ULL;
+        auto random = [&]() {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return (double) (std::int64_t) (state % 2001) - 1000;
+        };
+        for (std::size_t size = 8; size <= 32768; size *= 2) {
+            std::vector<double> a(size), b(size), output(2 * size - 1);
+            std::vector<std::int64_t> aIntegers(size), bIntegers(size);
+            std::vector<dense::WideInteger> exact(2 * size - 1);
+            for (std::size_t i = 0; i < size; i++) {
+                a[i] = random();
+                b[i] = random();
+                aIntegers[i] = (std::int64_t) a[i];
+                bIntegers[i] = (std::int64_t) b[i];
+            }
+            // About the same amount of schoolbook work at every size.
+            std::size_t iterations = std::max<std::size_t>(1, (std::size_t(1) << 26) / (size * size));
+            double schoolbook = measure(iterations, [&](std::size_t) {
+                dense::schoolbook(a.data(), size, b.data(), size, output.data());
+            });
+            double karatsuba = measure(iterations, [&](std::size_t) {
+                dense::karatsuba(a.data(), size, b.data(), size, output.data());
+            });
+            double ntt = measure(iterations, [&](std::size_t) {
+                dense::ntt(aIntegers.data(), size, bIntegers.data(), size, exact.data());
+            });
+            results.push_back({size, schoolbook, karatsuba, ntt});
+        }
+        return results;
+    }
+
+    /**
+     * @return the smallest size from which the faster method always wins, 0 if it never does.
+     */
+    std::size_t crossover(const std::vector<MultiplicationResult> &results,
+                          double MultiplicationResult::*slower, double MultiplicationResult::*faster) {
+        std::size_t size = 0;
+        for (const MultiplicationResult &result : results) {
+            if (result.*faster >= result.*slower) {
+                size = 0;
+            } else if (size == 0) {
+                size = result.size;
+            }
+        }
+        return size;
+    }
+
+    /**
+     * Escape a string for a JSON document.
+     */
+    std::string quote(const std::string &value) {
+        std::string quoted = "\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    void printJson(const std::vector<CorpusResult> &corpora, const std::vector<EvaluationResult> &evaluations,
+                   const std::vector<MultiplicationResult> &multiplications) {
+        std::cout << "{\n  \"nativeCodeSupported\": " << (NativeCode::isSupported() ? "true" : "false") << ",\n";
+        std::cout << "  \"corpora\": [";
+        for (std::size_t i = 0; i < corpora.size(); i++) {
+            const CorpusResult &result = corpora[i];
+            double total = 0;
+            std::cout << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << quote(result.corpus->name)
+                      << ", \"successful\": " << (result.successful ? "true" : "false")
+                      << ", \"sourceBytes\": " << result.corpus->source.size()
+                      << ", \"tokens\": " << result.tokens
+                      << ", \"iterations\": " << result.iterations
+                      << ", \"outputBytes\": " << result.outputLength
+                      << ", \"arenaBytes\": " << result.arenaBytes
+                      << ", \"peakRssKb\": " << result.peakRss << ", \"phases\": {";
+            for (int phase = 0; phase < PHASE_COUNT; phase++) {
+                const PhaseResult &timing = result.phases[phase];
+                total += timing.nanoseconds;
+                std::cout << (phase == 0 ? "" : ", ") << quote(phaseNames[phase])
+                          << ": {\"ns\": " << timing.nanoseconds
+                          << ", \"nsPerToken\": " << perToken(timing.nanoseconds, result)
+                          << ", \"allocations\": " << timing.allocations << "}";
+            }
+            std::cout << "}, \"nsPerToken\": " << perToken(total, result) << "}";
+        }
+        std::cout << "\n  ],\n  \"evaluation\": [";
+        for (std::size_t i = 0; i < evaluations.size(); i++) {
+            const EvaluationResult &result = evaluations[i];
+            std::cout << (i == 0 ? "\n" : ",\n") << "    {\"formula\": " << quote(result.formula)
+                      << ", \"treeNs\": " << result.tree
+                      << ", \"bytecodeNs\": " << result.bytecode
+                      << ", \"nativeNs\": " << result.native
+                      << ", \"staticNs\": " << result.compiled << "}";
+        }
+        std::cout << "\n  ],\n  \"multiplication\": [";
+        for (std::size_t i = 0; i < multiplications.size(); i++) {
+            const MultiplicationResult &result = multiplications[i];
+            std::cout << (i == 0 ? "\n" : ",\n") << "    {\"size\": " << result.size
+                      << ", \"schoolbookNs\": " << result.schoolbook
+                      << ", \"karatsubaNs\": " << result.karatsuba
+                      << ", \"nttNs\": " << result.ntt << "}";
+        }
+        std::cout << "\n  ],\n  \"karatsubaCrossover\": "
+                  << crossover(multiplications, &MultiplicationResult::schoolbook, &MultiplicationResult::karatsuba)
+                  << ",\n  \"nttCrossover\": "
+                  << crossover(multiplications, &MultiplicationResult::karatsuba, &MultiplicationResult::ntt)
+                  << ",\n  \"peakRssKb\": " << peakRss() << "\n}\n";
+    }
+
+    void printTable(const std::vector<CorpusResult> &corpora, const std::vector<EvaluationResult> &evaluations,
+                    const std::vector<MultiplicationResult> &multiplications) {
+        std::cout << "ns/token\tparse\tcompile\tevaluate\tgetString\tallocs\ttokens\tcorpus\n";
+        for (const CorpusResult &result : corpora) {
+            double allocated = 0;
+            for (int phase = 0; phase < PHASE_COUNT; phase++) {
+                std::cout << "\t" << perToken(result.phases[phase].nanoseconds, result);
+                allocated += result.phases[phase].allocations;
+            }
+            std::cout << "\t" << allocated << "\t" << result.tokens << "\t" << result.corpus->name
+                      << (result.successful ? "" : " (failed)") << "\n";
+        }
+        std::cout << "\nnative code supported: " << (NativeCode::isSupported() ? "yes" : "no") << "\n";
+        std::cout << "ns/eval\ttree\tbytecode\tnative\tstatic\tformula\n";
+        for (const EvaluationResult &result : evaluations) {
+            std::cout << "\t" << result.tree << "\t" << result.bytecode << "\t" << result.native << "\t" << result.compiled << "\t" << result.formula << "\n";
+        }
+        std::cout << "\nns/multiply\tschoolbook\tkaratsuba\tntt\tsize\n";
+        for (const MultiplicationResult &result : multiplications) {
+            std::cout << "\t" << result.schoolbook << "\t" << result.karatsuba << "\t" << result.ntt
+                      << "\t" << result.size << "\n";
+        }
+        std::cout << "karatsuba from size "
+                  << crossover(multiplications, &MultiplicationResult::schoolbook, &MultiplicationResult::karatsuba)
+                  << ", ntt from size "
+                  << crossover(multiplications, &MultiplicationResult::karatsuba, &MultiplicationResult::ntt) << "\n";
+        std::cout << "\npeak RSS: " << peakRss() << " KB\n";
+    }
+}
+
+/**
+ * Usage: FluxionBench [--json]
+ */
+int main(int argc, char **argv) {
+    bool json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+    // The cache would turn every iteration after the first into a lookup.
+    fluxion::setCacheCapacity(0);
+    std::vector<Corpus> corpora = generateCorpora();
+    std::vector<CorpusResult> results;
+    for (const Corpus &corpus : corpora) {
+        results.push_back(runCorpus(corpus));
+    }
+    std::vector<EvaluationResult> evaluations = runEvaluations();
+    std::vector<MultiplicationResult> multiplications = runMultiplications();
+    if (json) {
+        printJson(results, evaluations, multiplications);
+    } else {
+        printTable(results, evaluations, multiplications);
+    }
+}
\ No newline at end of file
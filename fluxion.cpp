@@ -1,25 +1,391 @@
+#include <cctype>
 #include <iostream>
 #include "fluxion.h"
 #include "internals/debug.h"
 #include "internals/Parser.h"
 #include "internals/Compiler.h"
 #include "internals/Expression.h"
+#include "internals/Context.h"
+#include "internals/Columnar.h"
+#include "internals/SimplificationCache.h"
+#include "internals/ThreadPool.h"
+#include "internals/Instrumentation.h"
+#include "internals/Polynomial.h"
+#include "internals/Image.h"
+#include "internals/Tape.h"
+#include "internals/RuleSet.h"
+#include "internals/EGraph.h"
 
-std::string fluxion::interpret(const char *source) {
-    Parser parser {source};
-    ParsingStatus status = parser.parse();
-    std::vector<Token*> tokens = parser.getTokens();
-    if (status != PARSING_FAILED) {
-        Compiler compiler {tokens};
-        CompilationStatus cStatus = compiler.compile();
-        if (cStatus != COMPILATION_FAILED) {
-            Expression *expression = compiler.getRoot();
-            return expression->evaluate()->getString();
+namespace {
+    /**
+     * Parse and compile the source in the current context.
+     *
+     * @param error Set to the reason of the failure, if any.
+     * @return the compiled expression, not simplified, or nullptr if it failed.
+     */
+    Expression *compileSource(const char *source, std::string &error) {
+        Parser parser {source};
+        ParsingStatus status = parser.parse();
+        const std::vector<Token> &tokens = parser.getTokens();
+        if (status != PARSING_FAILED) {
+            Compiler compiler {tokens};
+            CompilationStatus cStatus = compiler.compile();
+            if (cStatus != COMPILATION_FAILED) {
+                error.clear();
+                return compiler.getRoot();
+            } else {
+                error = "CompilationException: Compilation Failed.";
+            }
         } else {
-            std::cerr << "CompilationException: Compilation Failed.\n";
+            error = "ParsingException: Parsing failed.";
+        }
+        return nullptr;
+    }
+
+    /**
+     * Parse, compile and simplify the source in the given context.
+     *
+     * @param error Set to the reason of the failure, if any.
+     * @return the simplified expression or nullptr if it failed.
+     */
+    Expression *simplifyIn(Context &context, const char *source, std::string &error) {
+        Context::Scope scope {context};
+        Expression *expression = compileSource(source, error);
+        return expression != nullptr ? expression->evaluate() : nullptr;
+    }
+
+    inline const char *skipBlanks(const char *c) {
+        while (*c == ' ' || *c == '\t') {
+            c++;
+        }
+        return c;
+    }
+
+    inline const char *skipWord(const char *c) {
+        while (std::isalnum((unsigned char) *c)) {
+            c++;
+        }
+        return c;
+    }
+
+    /**
+     * Read pattern variables such as "x, n: integer".
+     *
+     * @return false if a name or a guard is malformed.
+     */
+    bool parseRuleVariables(const char *source, std::vector<RuleVariable> &variables) {
+        static const std::pair<const char*, RuleGuard> guards[] = {
+            {"constant", GUARD_CONSTANT}, {"integer", GUARD_INTEGER}, {"positive", GUARD_POSITIVE},
+            {"nonzero", GUARD_NONZERO}, {"variable", GUARD_VARIABLE}, {"nonconstant", GUARD_NOT_CONSTANT},
+        };
+        const char *c = skipBlanks(source);
+        while (*c != '\0') {
+            if (!std::isalpha((unsigned char) *c)) {
+                return false;
+            }
+            const char *end = skipWord(c);
+            RuleVariable variable {std::string(c, end), GUARD_ANY};
+            c = skipBlanks(end);
+            if (*c == ':') {
+                const char *guard = skipBlanks(c + 1);
+                end = skipWord(guard);
+                std::size_t known = 0;
+                while (known < sizeof(guards) / sizeof(guards[0]) && std::string(guard, end) != guards[known].first) {
+                    known++;
+                }
+                if (known == sizeof(guards) / sizeof(guards[0])) {
+                    return false;
+                }
+                variable.guard = guards[known].second;
+                c = skipBlanks(end);
+            }
+            variables.push_back(variable);
+            if (*c == ',') {
+                c = skipBlanks(c + 1);
+                if (*c == '\0') {
+                    return false; // A trailing comma.
+                }
+            } else if (*c != '\0') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    fluxion::BatchResult interpretIn(Context &context, const char *source) {
+        fluxion::BatchResult result {false, "", ""};
+        Expression *expression = simplifyIn(context, source, result.error);
+        if (expression != nullptr) {
+            Context::Scope scope {context};
+            result.output = expression->getString();
+            result.successful = true;
         }
-    } else {
-        std::cerr << "ParsingException: Parsing failed.\n";
+        return result;
+    }
+}
+
+fluxion::Session::Session()
+        : context(new Context()), limits {EGRAPH_MAX_NODES, EGRAPH_MAX_ITERATIONS, EGRAPH_MAX_MICROSECONDS} {
+
+}
+
+fluxion::Session::~Session() {
+    delete context;
+}
+
+void fluxion::Session::reset() {
+    context->reset();
+}
+
+void fluxion::Session::setExactNumbers(bool exact) {
+    context->numberMode = exact ? NUMBER_MODE_EXACT : NUMBER_MODE_DOUBLE;
+}
+
+const std::string &fluxion::Session::getError() const {
+    return this->error;
+}
+
+Expression *fluxion::Session::simplify(const char *source) {
+    return simplifyIn(*context, source, error);
+}
+
+Expression *fluxion::Session::expand(const char *source) {
+    Expression *expression = simplify(source);
+    if (expression == nullptr) {
+        return nullptr;
+    }
+    Context::Scope scope {*context};
+    return Polynomial::expand(expression);
+}
+
+Expression *fluxion::Session::saturate(const char *source) {
+    Context::Scope scope {*context};
+    Expression *expression = compileSource(source, error);
+    if (expression == nullptr) {
+        return nullptr;
+    }
+    EGraph graph {limits.nodes, limits.iterations, limits.microseconds};
+    Expression *greedy = expression->evaluate();
+    std::uint32_t root = graph.add(expression, false);
+    std::uint32_t simplified = graph.add(greedy, true);
+    // The greedy result is known to be equal, so the result costs no more than it, and it is
+    // the result when the time runs out before the graph can be costed.
+    if (root == EGRAPH_NO_CLASS || simplified == EGRAPH_NO_CLASS) {
+        return greedy;
+    }
+    graph.merge(root, simplified);
+    if (graph.saturate() == SATURATION_TIME_LIMIT) {
+        return greedy;
+    }
+    return graph.extract(root);
+}
+
+void fluxion::Session::setSaturationLimits(const SaturationLimits &limits) {
+    this->limits = limits;
+}
+
+std::string fluxion::Session::interpret(const char *source) {
+    Expression *expression = simplify(source);
+    if (expression == nullptr) {
+        return "";
+    }
+    Context::Scope scope {*context};
+    return expression->getString();
+}
+
+bool fluxion::Session::interpret(const char *source, OutputSink &sink) {
+    Expression *expression = simplify(source);
+    if (expression == nullptr) {
+        return false;
+    }
+    Context::Scope scope {*context};
+    expression->write(sink);
+    return true;
+}
+
+Expression *fluxion::Session::load(const FormulaFile &file, std::size_t index) {
+    Context::Scope scope {*context};
+    Expression *expression = index < file.getCount() ? file.image->restore((std::uint32_t) index) : nullptr;
+    error = expression != nullptr ? "" : "FileException: Malformed formula file.";
+    return expression;
+}
+
+bool fluxion::Session::loadAll(const FormulaFile &file, std::vector<Expression*> &expressions) {
+    Context::Scope scope {*context};
+    bool loaded = file.image->restoreAll(expressions);
+    error = loaded ? "" : "FileException: Malformed formula file.";
+    return loaded;
+}
+
+fluxion::FormulaFile::FormulaFile() : image(new Image()) {
+
+}
+
+fluxion::FormulaFile::~FormulaFile() {
+    delete image;
+}
+
+bool fluxion::FormulaFile::open(const char *path) {
+    switch (image->open(path)) {
+        case IMAGE_SUCCESSFUL:
+            error.clear();
+            return true;
+        case IMAGE_UNREADABLE:
+            error = "FileException: Could not read the file.";
+            return false;
+        case IMAGE_UNSUPPORTED_VERSION:
+            error = "FileException: Saved by an incompatible version.";
+            return false;
+        default:
+            error = "FileException: Not a formula file.";
+            return false;
+    }
+}
+
+void fluxion::FormulaFile::close() {
+    image->close();
+}
+
+std::size_t fluxion::FormulaFile::getCount() const {
+    return image->getRootCount();
+}
+
+const std::string &fluxion::FormulaFile::getError() const {
+    return this->error;
+}
+
+fluxion::Gradient::Gradient(Expression *expression) : tape(new Tape(expression)) {
+
+}
+
+fluxion::Gradient::~Gradient() {
+    delete tape;
+}
+
+const std::vector<std::string> &fluxion::Gradient::getVariables() const {
+    return tape->getVariables();
+}
+
+double fluxion::Gradient::evaluate(const double *values, double *gradient) const {
+    return tape->evaluate(values, gradient);
+}
+
+bool fluxion::save(const char *path, Expression *const *expressions, std::size_t count) {
+    ImageWriter writer {IMAGE_FLAG_SIMPLIFIED};
+    for (std::size_t i = 0; i < count; i++) {
+        writer.add(expressions[i]);
+    }
+    return writer.save(path) == IMAGE_SUCCESSFUL;
+}
+
+bool fluxion::save(const char *path, const std::vector<Expression*> &expressions) {
+    return save(path, expressions.data(), expressions.size());
+}
+
+std::string fluxion::interpret(const char *source) {
+    Session session;
+    std::string result = session.interpret(source);
+    if (!session.getError().empty()) {
+        std::cerr << session.getError() << "\n";
+    }
+    return result;
+}
+
+std::string fluxion::expand(const char *source) {
+    Session session;
+    Expression *expression = session.expand(source);
+    if (expression == nullptr) {
+        std::cerr << session.getError() << "\n";
+        return "";
+    }
+    return expression->getString();
+}
+
+std::string fluxion::saturate(const char *source) {
+    Session session;
+    Expression *expression = session.saturate(source);
+    if (expression == nullptr) {
+        std::cerr << session.getError() << "\n";
+        return "";
     }
-    return "";
+    return expression->getString();
+}
+
+void fluxion::write(Expression *expression, OutputSink &sink) {
+    expression->write(sink);
+}
+
+std::vector<fluxion::BatchResult> fluxion::interpretBatch(const char *const *sources, std::size_t count) {
+    std::vector<BatchResult> results(count);
+    ThreadPool::global().run(count, [&](std::size_t index, unsigned) {
+        // Every worker has its own context, recycled between sources so its arena blocks are reused.
+        thread_local Context context;
+        results[index] = interpretIn(context, sources[index]);
+        context.reset();
+    });
+    return results;
+}
+
+std::vector<fluxion::BatchResult> fluxion::interpretBatch(const std::vector<std::string> &sources) {
+    std::vector<const char*> pointers;
+    pointers.reserve(sources.size());
+    for (const std::string &source : sources) {
+        pointers.push_back(source.c_str());
+    }
+    return interpretBatch(pointers.data(), pointers.size());
+}
+
+bool fluxion::evaluateColumns(Expression *expression, const std::unordered_map<std::string, const double *> &columns,
+                              double *output, std::size_t rows) {
+    ColumnEvaluator evaluator {expression};
+    return evaluator.evaluate(columns, output, rows);
+}
+
+namespace {
+    fluxion::PhaseStats getPhaseStats(InstrumentedPhase phase) {
+        return {Instrumentation::getCalls(phase), Instrumentation::getNanoseconds(phase), Instrumentation::getDepth(phase)};
+    }
+}
+
+void fluxion::setStatsEnabled(bool enabled) {
+    Instrumentation::setEnabled(enabled);
+}
+
+fluxion::Stats fluxion::getStats() {
+    Stats stats {};
+    stats.parse = getPhaseStats(PHASE_PARSE);
+    stats.compile = getPhaseStats(PHASE_COMPILE);
+    stats.evaluate = getPhaseStats(PHASE_EVALUATE);
+    stats.getString = getPhaseStats(PHASE_GET_STRING);
+    stats.nodes = Instrumentation::getCount(COUNTER_NODES);
+    stats.tokens = Instrumentation::getCount(COUNTER_TOKENS);
+    stats.bytes = Instrumentation::getCount(COUNTER_BYTES);
+    return stats;
+}
+
+void fluxion::resetStats() {
+    Instrumentation::reset();
+}
+
+fluxion::CacheStats fluxion::getCacheStats() {
+    CacheStatistics statistics = SimplificationCache::global().getStatistics();
+    return {statistics.hits, statistics.misses, statistics.insertions, statistics.evictions,
+            statistics.entries, statistics.bytes, statistics.capacity};
+}
+
+void fluxion::setCacheCapacity(std::size_t bytes) {
+    SimplificationCache::global().setCapacity(bytes);
+}
+
+void fluxion::clearCache() {
+    SimplificationCache::global().clear();
+}
+
+bool fluxion::addRule(const char *pattern, const char *replacement, const char *variables) {
+    std::vector<RuleVariable> declared;
+    return parseRuleVariables(variables, declared) && RuleSet::global().add(pattern, replacement, declared) == RULE_ADDED;
+}
+
+void fluxion::clearRules() {
+    RuleSet::global().clear();
 }
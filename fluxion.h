@@ -1,7 +1,304 @@
 #ifndef FLUXION_FLUXION_H
 #define FLUXION_FLUXION_H
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "internals/OutputSink.h"
+
+class Context;
+class Expression;
+class Image;
+class Tape;
+
 namespace fluxion {
+    /**
+     * Counters of the simplification cache shared by every session.
+     */
+    struct CacheStats {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t insertions;
+        std::uint64_t evictions;
+        std::uint64_t entries;
+        std::uint64_t bytes; // Memory used by the entries.
+        std::uint64_t capacity; // Maximum memory the entries may use.
+    };
+
+    /**
+     * Counters of one phase of interpreting.
+     */
+    struct PhaseStats {
+        std::uint64_t calls; // Outermost calls, recursive calls are part of them.
+        std::uint64_t nanoseconds; // Wall time spent in the outermost calls.
+        std::uint64_t maxDepth; // Deepest nesting seen, of parentheses when parsing, of the explicit stack otherwise.
+    };
+
+    struct Stats {
+        PhaseStats parse;
+        PhaseStats compile;
+        PhaseStats evaluate;
+        PhaseStats getString;
+        std::uint64_t nodes; // Expressions created.
+        std::uint64_t tokens; // Tokens created.
+        std::uint64_t bytes; // Bytes allocated for tokens and expressions.
+    };
+
+    /**
+     * Outcome of interpreting one source of a batch.
+     */
+    struct BatchResult {
+        bool successful;
+        std::string output;
+        std::string error; // Why it failed, empty if successful.
+    };
+
+    /**
+     * Bounds of Session::saturate, whichever is reached first stops it.
+     */
+    struct SaturationLimits {
+        std::size_t nodes; // E-nodes the e-graph may hold.
+        std::size_t iterations; // Rounds of rewriting.
+        std::uint64_t microseconds; // Wall time.
+    };
+
+    /**
+     * Formulas saved by fluxion::save, mapped read only into memory.
+     * Opening only checks the header of the file, nothing is parsed or
+     * copied until formulas are loaded into a session.
+     */
+    class FormulaFile {
+    private:
+        Image *image;
+        std::string error;
+        friend class Session;
+    public:
+        /**
+         * @return false if the file cannot be read, is not a formula file or
+         * was saved by an incompatible version.
+         */
+        bool open(const char *path);
+        void close();
+        /**
+         * @return number of formulas in the file.
+         */
+        std::size_t getCount() const;
+        /**
+         * @return why opening failed, empty if it succeeded.
+         */
+        const std::string &getError() const;
+        FormulaFile();
+        FormulaFile(const FormulaFile&) = delete;
+        FormulaFile &operator=(const FormulaFile&) = delete;
+        ~FormulaFile();
+    };
+
+    /**
+     * Value and gradient of a simplified expression, computed by recording
+     * it once as a tape and sweeping it forward then backward. Each call
+     * costs a small constant factor of one evaluation, whatever the number
+     * of variables. The expression is only read while constructing.
+     */
+    class Gradient {
+    private:
+        Tape *tape;
+    public:
+        /**
+         * @return names of the variables, in the order values and derivatives are given.
+         */
+        const std::vector<std::string> &getVariables() const;
+        /**
+         * @param values Value of each variable, in the order of getVariables.
+         * @param gradient Set to the partial derivative with respect to each variable, in the same order.
+         * @return value of the expression.
+         */
+        double evaluate(const double *values, double *gradient) const;
+        /**
+         * @param expression Expression to differentiate, as returned by Session::simplify.
+         */
+        explicit Gradient(Expression *expression);
+        Gradient(const Gradient&) = delete;
+        Gradient &operator=(const Gradient&) = delete;
+        ~Gradient();
+    };
+
+    /**
+     * A session owns every token and expression created while
+     * interpreting, they are allocated from a single arena and released
+     * in one shot when the session is reset or destroyed.
+     */
+    class Session {
+    private:
+        Context *context;
+        std::string error;
+        SaturationLimits limits;
+    public:
+        /**
+         * Parse, compile and simplify the source, the expression is
+         * owned by the session and valid until it is reset.
+         *
+         * @return the simplified expression, or nullptr if the source is malformed.
+         */
+        Expression *simplify(const char *source);
+        /**
+         * Simplify the source, then expand products and powers of sums,
+         * so (x + 1) ^ 2 becomes x ^ 2 + 2x + 1.
+         *
+         * @return the expanded expression, or nullptr if the source is malformed.
+         */
+        Expression *expand(const char *source);
+        /**
+         * Simplify the source by equality saturation, every rewrite of the
+         * simplifier is applied to every part of the expression, as well as
+         * distributing and factoring, keeping all the equal forms found in
+         * an e-graph. The smallest of them is returned, so the result does not
+         * depend on how the source was written, and a * (b + c) - a * b is
+         * a * c. Slower than simplify, within the limits, once the time limit
+         * is reached the source is only simplified.
+         *
+         * @return the smallest expression found, or nullptr if the source is malformed.
+         */
+        Expression *saturate(const char *source);
+        /**
+         * Change the limits of saturate, by default it takes at most about
+         * 50 milliseconds more than simplifying the source.
+         */
+        void setSaturationLimits(const SaturationLimits &limits);
+        /**
+         * @return why the last call failed, empty if it succeeded.
+         */
+        const std::string &getError() const;
+        /**
+         * Interpret the source inside this session, memory used stays
+         * allocated until the session is reset.
+         */
+        std::string interpret(const char *source);
+        /**
+         * Interpret the source inside this session, writing the result
+         * straight to the sink rather than returning it.
+         *
+         * @return false if the source is malformed, nothing is written then.
+         */
+        bool interpret(const char *source, OutputSink &sink);
+        /**
+         * Load a formula of a file into this session, it was simplified
+         * before it was saved so it is neither parsed nor simplified again.
+         *
+         * @param index Position of the formula in the expressions it was saved with.
+         * @return the expression, or nullptr if the file is malformed.
+         */
+        Expression *load(const FormulaFile &file, std::size_t index);
+        /**
+         * Load every formula of a file into this session, in a single pass.
+         *
+         * @param expressions Set to the expression of each formula, in order.
+         * @return false if the file is malformed.
+         */
+        bool loadAll(const FormulaFile &file, std::vector<Expression*> &expressions);
+        /**
+         * Read number literals as exact rationals, the default, so 0.1 + 0.2
+         * is 0.3, or as doubles, so it is 0.30000000000000004.
+         */
+        void setExactNumbers(bool exact);
+        /**
+         * Release everything created in this session, while keeping
+         * the memory around for reuse.
+         */
+        void reset();
+        Session();
+        Session(const Session&) = delete;
+        Session &operator=(const Session&) = delete;
+        ~Session();
+    };
+    /**
+     * Interpret the source in a temporary session, all intermediate
+     * memory is released before returning. Failures are written to std::cerr.
+     */
     std::string interpret(const char *source);
+    /**
+     * Expand the source in a temporary session, like interpret.
+     */
+    std::string expand(const char *source);
+    /**
+     * Saturate the source in a temporary session, like interpret.
+     */
+    std::string saturate(const char *source);
+    /**
+     * Print an expression, as returned by Session::simplify, into a sink in
+     * a single pass, with parentheses only where precedence needs them.
+     */
+    void write(Expression *expression, OutputSink &sink);
+    /**
+     * Save expressions, as returned by Session::simplify, to a file that can
+     * be opened as a FormulaFile. Shared subexpressions, names and constants
+     * are stored once.
+     *
+     * @return false if the file could not be written.
+     */
+    bool save(const char *path, Expression *const *expressions, std::size_t count);
+    bool save(const char *path, const std::vector<Expression*> &expressions);
+    /**
+     * Start or stop collecting stats, they are off by default
+     * since timing every phase is not free.
+     */
+    void setStatsEnabled(bool enabled);
+    /**
+     * @return the stats collected by every thread since the last reset.
+     */
+    Stats getStats();
+    void resetStats();
+    /**
+     * Interpret many sources in parallel on the shared thread pool,
+     * each worker uses its own arena. Failures are only reported
+     * through the results.
+     *
+     * @return one result per source, in the same order.
+     */
+    std::vector<BatchResult> interpretBatch(const char *const *sources, std::size_t count);
+    std::vector<BatchResult> interpretBatch(const std::vector<std::string> &sources);
+    CacheStats getCacheStats();
+    /**
+     * Limit the memory the simplification cache may use, least recently
+     * used entries are evicted to fit, 0 disables the cache.
+     */
+    void setCacheCapacity(std::size_t bytes);
+    /**
+     * Remove every entry from the simplification cache and reset its counters.
+     */
+    void clearCache();
+    /**
+     * Add a rule rewriting every simplified operation matching the pattern
+     * into the replacement, in every session, so addRule("x ^ 2 - y ^ 2",
+     * "(x + y) * (x - y)", "x, y") factors differences of squares. Patterns
+     * are simplified, then matched operand by operand. When several rules
+     * match, the first one added is applied. Rules must not be added while
+     * other threads simplify.
+     *
+     * @param variables Pattern variables separated by commas, each may be
+     * followed by a colon and a guard restricting what it matches: constant,
+     * integer, positive, nonzero, variable or nonconstant. Other variables
+     * only match themselves.
+     * @return false if the pattern, the replacement or the variables are malformed,
+     * or the pattern simplifies to a constant or a variable.
+     */
+    bool addRule(const char *pattern, const char *replacement, const char *variables);
+    /**
+     * Remove every rule added by addRule.
+     */
+    void clearRules();
+    /**
+     * Evaluate a simplified expression once per row, reading the value
+     * of each variable from the column with its name.
+     *
+     * @param expression Expression to evaluate, as returned by Session::simplify.
+     * @param columns Values of each variable, each holding at least rows values.
+     * @param output Column of rows values to write the results to.
+     * @param rows Number of rows.
+     * @return false if one of the variables has no column.
+     */
+    bool evaluateColumns(Expression *expression, const std::unordered_map<std::string, const double*> &columns,
+                         double *output, std::size_t rows);
 }
 #endif //FLUXION_FLUXION_H
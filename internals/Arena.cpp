@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include "Arena.h"
+
+#define ARENA_MIN_BLOCK_SIZE 4096
+#define ARENA_MAX_BLOCK_SIZE (1 << 20)
+
+Arena::Arena() : current(nullptr), cursor(nullptr), limit(nullptr), finalizers(nullptr), allocated(0) {
+
+}
+
+Arena::~Arena() {
+    release();
+}
+
+std::size_t Arena::bytesAllocated() const {
+    return this->allocated;
+}
+
+void Arena::grow(std::size_t size, std::size_t alignment) {
+    // Blocks double in size up to a limit, so small sessions stay small and
+    // large ones do not call malloc often.
+    std::size_t blockSize = current == nullptr ? ARENA_MIN_BLOCK_SIZE : current->size * 2;
+    if (blockSize > ARENA_MAX_BLOCK_SIZE) {
+        blockSize = ARENA_MAX_BLOCK_SIZE;
+    }
+    if (blockSize < size + alignment) {
+        blockSize = size + alignment; // Oversized allocations get their own block.
+    }
+    auto block = static_cast<Block*>(std::malloc(sizeof(Block) + blockSize));
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    block->previous = current;
+    block->size = blockSize;
+    current = block;
+    cursor = reinterpret_cast<char*>(block + 1);
+    limit = cursor + blockSize;
+}
+
+void Arena::runFinalizers() {
+    for (Finalizer *finalizer = finalizers; finalizer != nullptr; finalizer = finalizer->next) {
+        finalizer->destroy(finalizer->object);
+    }
+    finalizers = nullptr;
+}
+
+void Arena::reset() {
+    runFinalizers();
+    if (current == nullptr) {
+        return;
+    }
+    // Keep the newest block, which is also the largest one.
+    Block *previous = current->previous;
+    while (previous != nullptr) {
+        Block *next = previous->previous;
+        std::free(previous);
+        previous = next;
+    }
+    current->previous = nullptr;
+    cursor = reinterpret_cast<char*>(current + 1);
+    limit = cursor + current->size;
+    allocated = 0;
+}
+
+void Arena::release() {
+    runFinalizers();
+    while (current != nullptr) {
+        Block *previous = current->previous;
+        std::free(current);
+        current = previous;
+    }
+    cursor = nullptr;
+    limit = nullptr;
+    allocated = 0;
+}
@@ -0,0 +1,101 @@
+#ifndef FLUXION_ARENA_H
+#define FLUXION_ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "Instrumentation.h"
+
+/**
+ * A bump allocator, objects allocated from an arena are never freed
+ * individually, instead the whole arena is released at once.
+ */
+class Arena {
+private:
+    /**
+     * Header of a chunk of memory owned by the arena, the usable
+     * memory follows the header.
+     */
+    struct Block {
+        Block *previous;
+        std::size_t size;
+    };
+    /**
+     * Destructors of the non trivially destructible objects, these
+     * are ran when the arena is released.
+     */
+    struct Finalizer {
+        void (*destroy)(void *object);
+        void *object;
+        Finalizer *next;
+    };
+    Block *current;
+    char *cursor;
+    char *limit;
+    Finalizer *finalizers;
+    std::size_t allocated; // Total bytes handed out since the last release.
+    /**
+     * Allocate a new block that can hold at least size bytes.
+     */
+    void grow(std::size_t size, std::size_t alignment);
+    void runFinalizers();
+    template <typename T>
+    static void destroy(void *object) {
+        static_cast<T*>(object)->~T();
+    }
+public:
+    /**
+     * Allocate uninitialised memory from the arena.
+     *
+     * @param size Size in bytes.
+     * @param alignment Alignment, must be a power of two.
+     * @return pointer to the memory.
+     */
+    inline void *allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+        auto address = reinterpret_cast<std::size_t>(cursor);
+        std::size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+        if (cursor == nullptr || padding + size > (std::size_t) (limit - cursor)) {
+            grow(size, alignment);
+            return allocate(size, alignment);
+        }
+        char *memory = cursor + padding;
+        cursor = memory + size;
+        allocated += size;
+        Instrumentation::count(COUNTER_BYTES, size);
+        return memory;
+    }
+    /**
+     * Construct an object inside the arena, its destructor is ran
+     * when the arena is released if it is not trivial.
+     */
+    template <typename T, typename... Args>
+    T *make(Args&&... args) {
+        T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            auto finalizer = static_cast<Finalizer*>(allocate(sizeof(Finalizer), alignof(Finalizer)));
+            *finalizer = {&Arena::destroy<T>, object, finalizers};
+            finalizers = finalizer;
+        }
+        return object;
+    }
+    /**
+     * @return bytes allocated since the last release.
+     */
+    std::size_t bytesAllocated() const;
+    /**
+     * Destroy every object and free every block, except the last
+     * one which is kept so the arena can be reused without calling malloc.
+     */
+    void reset();
+    /**
+     * Destroy every object and free all memory.
+     */
+    void release();
+    Arena();
+    Arena(const Arena&) = delete;
+    Arena &operator=(const Arena&) = delete;
+    ~Arena();
+};
+
+#endif //FLUXION_ARENA_H
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Bytecode.h"
+
+#define PROGRAM_MAX_INTEGER_EXPONENT 64
+
+namespace {
+    inline bool readsB(OpCode opCode) {
+        return opCode != OPCODE_POWI && opCode != OPCODE_SQRT;
+    }
+
+    inline bool isTemporary(std::uint32_t encoded) {
+        return (encoded >> 30) == 2;
+    }
+
+    /**
+     * @return true for a product with a negative coefficient, subtracted when it is a term of a sum.
+     */
+    inline bool isNegated(Expression *term) {
+        if (term->type != EXPRESSION_OPERATION || ((Operation*) term)->getOperationType() != OP_MUL) {
+            return false;
+        }
+        Expression *coefficient = ((Operation*) term)->getOperand(0);
+        return coefficient->type == EXPRESSION_CONSTANT && ((Constant*) coefficient)->getValue() < 0;
+    }
+
+    /**
+     * @return true for a power with a negative constant exponent, divided by when it is a factor of a product.
+     */
+    inline bool isDivisor(Expression *factor) {
+        if (factor->type != EXPRESSION_OPERATION || ((Operation*) factor)->getOperationType() != OP_EXP) {
+            return false;
+        }
+        Expression *exponent = ((Operation*) factor)->getOperand(1);
+        return exponent->type == EXPRESSION_CONSTANT && ((Constant*) exponent)->getValue() < 0;
+    }
+
+    double apply(OperationType opType, double left, double right) {
+        switch (opType) {
+            case OP_ADD:
+                return left + right;
+            case OP_MIN:
+                return left - right;
+            case OP_MUL:
+                return left * right;
+            case OP_DIV:
+                return left / right;
+            case OP_EXP:
+                return std::pow(left, right);
+            default:
+                return NAN;
+        }
+    }
+}
+
+Program::Program(Expression *expression) : result(0), registerCount(0), temporaryCount(0) {
+    // Constants are only known after lowering, so registers are numbered
+    // in a separate space for each kind and relocated at the end.
+    Schedule schedule {expression};
+    std::vector<Variable*> found = schedule.getVariables();
+    std::sort(found.begin(), found.end(), [](Variable *a, Variable *b) {
+        return a->getVariableName() < b->getVariableName();
+    });
+    Lowering lowering;
+    for (Variable *variable : found) {
+        lowering.variableIndices[variable] = (std::uint32_t) variables.size();
+        variables.push_back(variable->getVariableName());
+        symbols.push_back(variable->getSymbol());
+    }
+    // Subtracted terms and divisors used once are lowered by the sum or the product
+    // using them, so x - y stays a subtraction. Those used more are computed once.
+    const std::vector<Operation*> &operations = schedule.getOperations();
+    std::unordered_set<Expression*, NodeHash> shared;
+    for (std::size_t i = 0; i < operations.size(); i++) {
+        if (schedule.getUses(i) > 1) {
+            shared.insert(operations[i]);
+        }
+    }
+    for (Operation *operation : operations) {
+        OperationType opType = operation->getOperationType();
+        for (std::uint32_t i = 0; i < operation->getOperandCount(); i++) {
+            Expression *operand = operation->getOperand(i);
+            if (shared.count(operand) == 0 && ((opType == OP_ADD && isNegated(operand)) || (opType == OP_MUL && isDivisor(operand)))) {
+                lowering.absorbed.insert(operand);
+            }
+        }
+    }
+    // Operands come first in the schedule, so every operation is lowered after them.
+    for (Operation *operation : operations) {
+        if (lowering.absorbed.count(operation) == 0) {
+            lowering.registers.emplace(operation, lowerOperation(operation, lowering));
+        }
+    }
+    this->result = lower(expression, lowering);
+    allocateTemporaries();
+    auto variableBase = (std::uint32_t) constants.size();
+    auto temporaryBase = variableBase + (std::uint32_t) variables.size();
+    this->registerCount = temporaryBase + temporaryCount;
+    auto relocate = [=](std::uint32_t encoded) -> std::uint32_t {
+        // Encoded registers use the two top bits to tell their kind apart.
+        std::uint32_t index = encoded & 0x3fffffffU;
+        switch (encoded >> 30) {
+            case 0:
+                return index; // Constant
+            case 1:
+                return variableBase + index;
+            default:
+                return temporaryBase + index;
+        }
+    };
+    for (Instruction &instruction : instructions) {
+        instruction.dst = relocate(instruction.dst);
+        instruction.a = relocate(instruction.a);
+        if (readsB(instruction.opCode)) {
+            instruction.b = relocate(instruction.b);
+        }
+    }
+    this->result = relocate(this->result);
+}
+
+std::uint32_t Program::constantRegister(double value, Lowering &lowering) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto existing = lowering.constantIndices.find(bits);
+    if (existing != lowering.constantIndices.end()) {
+        return existing->second;
+    }
+    auto encoded = (std::uint32_t) constants.size();
+    constants.push_back(value);
+    lowering.constantIndices[bits] = encoded;
+    return encoded;
+}
+
+void Program::allocateTemporaries() {
+    // Each value gets the lowest free temporary when it is written, and
+    // gives it back after the instruction reading it for the last time.
+    std::vector<std::size_t> lastUses(temporaryCount, 0);
+    for (std::size_t i = 0; i < instructions.size(); i++) {
+        const Instruction &instruction = instructions[i];
+        if (isTemporary(instruction.a)) {
+            lastUses[instruction.a & 0x3fffffffU] = i;
+        }
+        if (readsB(instruction.opCode) && isTemporary(instruction.b)) {
+            lastUses[instruction.b & 0x3fffffffU] = i;
+        }
+    }
+    if (isTemporary(result)) {
+        lastUses[result & 0x3fffffffU] = instructions.size(); // Read after the last instruction.
+    }
+    std::vector<std::uint32_t> assigned(temporaryCount);
+    std::vector<std::uint32_t> freeTemporaries;
+    std::uint32_t count = 0;
+    auto release = [&](std::uint32_t encoded, std::size_t position) {
+        std::uint32_t value = encoded & 0x3fffffffU;
+        if (lastUses[value] == position) {
+            freeTemporaries.push_back(assigned[value]);
+        }
+        return (2U << 30) | assigned[value];
+    };
+    for (std::size_t i = 0; i < instructions.size(); i++) {
+        Instruction &instruction = instructions[i];
+        // Operands are freed first, so the destination may reuse one of them.
+        bool same = instruction.a == instruction.b;
+        if (readsB(instruction.opCode) && isTemporary(instruction.b)) {
+            instruction.b = release(instruction.b, i);
+        }
+        if (isTemporary(instruction.a)) {
+            instruction.a = same && readsB(instruction.opCode) ? instruction.b : release(instruction.a, i);
+        }
+        std::uint32_t value = instruction.dst & 0x3fffffffU;
+        if (freeTemporaries.empty()) {
+            assigned[value] = count++;
+        } else {
+            assigned[value] = freeTemporaries.back();
+            freeTemporaries.pop_back();
+        }
+        instruction.dst = (2U << 30) | assigned[value];
+    }
+    if (isTemporary(result)) {
+        this->result = (2U << 30) | assigned[result & 0x3fffffffU];
+    }
+    this->temporaryCount = count;
+}
+
+std::uint32_t Program::emit(OpCode opCode, std::uint32_t a, std::uint32_t b) {
+    // Every value is written once to a temporary of its own, allocateTemporaries then
+    // renumbers them so values whose lifetimes do not overlap share a register.
+    Instruction instruction {};
+    instruction.opCode = opCode;
+    instruction.a = a;
+    instruction.b = b;
+    instruction.dst = (2U << 30) | temporaryCount++;
+    instructions.push_back(instruction);
+    return instruction.dst;
+}
+
+std::uint32_t Program::lowerPower(std::uint32_t base, double exponent, Lowering &lowering) {
+    if (exponent == std::floor(exponent) && std::fabs(exponent) <= PROGRAM_MAX_INTEGER_EXPONENT) {
+        return emit(OPCODE_POWI, base, (std::uint32_t) (std::int32_t) exponent);
+    } else if (exponent == 0.5) {
+        return emit(OPCODE_SQRT, base, 0);
+    }
+    return emit(OPCODE_POW, base, constantRegister(exponent, lowering));
+}
+
+std::uint32_t Program::lowerSum(Operation *sum, Lowering &lowering) {
+    double constant = 0;
+    std::uint32_t accumulator = 0;
+    bool started = false;
+    std::vector<Operation*> subtracted;
+    for (std::uint32_t i = 0; i < sum->getOperandCount(); i++) {
+        Expression *term = sum->getOperand(i);
+        if (term->type == EXPRESSION_CONSTANT) {
+            constant += ((Constant*) term)->getValue(); // Fold what the simplifier left behind.
+            continue;
+        }
+        if (lowering.absorbed.count(term) != 0) {
+            subtracted.push_back((Operation*) term);
+            continue;
+        }
+        std::uint32_t value = lower(term, lowering);
+        accumulator = started ? emit(OPCODE_ADD, accumulator, value) : value;
+        started = true;
+    }
+    for (Operation *term : subtracted) {
+        double coefficient = ((Constant*) term->getOperand(0))->getValue();
+        if (!started) {
+            accumulator = lowerProduct(coefficient, term->getOperands() + 1, term->getOperandCount() - 1, lowering);
+            started = true;
+        } else {
+            std::uint32_t value = lowerProduct(-coefficient, term->getOperands() + 1, term->getOperandCount() - 1, lowering);
+            accumulator = emit(OPCODE_SUB, accumulator, value);
+        }
+    }
+    if (!started) {
+        return constantRegister(constant, lowering);
+    }
+    if (constant != 0) {
+        accumulator = emit(OPCODE_ADD, accumulator, constantRegister(constant, lowering));
+    }
+    return accumulator;
+}
+
+std::uint32_t Program::lowerProduct(double coefficient, Expression *const *factors, std::size_t count, Lowering &lowering) {
+    std::uint32_t accumulator = 0;
+    bool started = false;
+    std::vector<std::pair<Expression*, double>> divisors;
+    for (std::size_t i = 0; i < count; i++) {
+        Expression *factor = factors[i];
+        if (factor->type == EXPRESSION_CONSTANT) {
+            coefficient *= ((Constant*) factor)->getValue();
+            continue;
+        }
+        if (lowering.absorbed.count(factor) != 0) {
+            divisors.emplace_back(((Operation*) factor)->getOperand(0), -((Constant*) ((Operation*) factor)->getOperand(1))->getValue());
+            continue;
+        }
+        std::uint32_t value = lower(factor, lowering);
+        accumulator = started ? emit(OPCODE_MUL, accumulator, value) : value;
+        started = true;
+    }
+    if (!started || coefficient != 1) {
+        std::uint32_t value = constantRegister(coefficient, lowering);
+        accumulator = started ? emit(OPCODE_MUL, value, accumulator) : value;
+        started = true;
+    }
+    for (const std::pair<Expression*, double> &divisor : divisors) {
+        std::uint32_t value = lower(divisor.first, lowering);
+        if (divisor.second != 1) {
+            value = lowerPower(value, divisor.second, lowering);
+        }
+        accumulator = emit(OPCODE_DIV, accumulator, value);
+    }
+    return accumulator;
+}
+
+std::uint32_t Program::lower(Expression *expression, Lowering &lowering) {
+    switch (expression->type) {
+        case EXPRESSION_CONSTANT:
+            return constantRegister(((Constant*) expression)->getValue(), lowering);
+        case EXPRESSION_VARIABLE:
+            return (1U << 30) | lowering.variableIndices.at(expression);
+        default:
+            return lowering.registers.at(expression);
+    }
+}
+
+std::uint32_t Program::lowerOperation(Operation *operation, Lowering &lowering) {
+    OperationType opType = operation->getOperationType();
+    if (opType == OP_ADD) {
+        return lowerSum(operation, lowering);
+    } else if (opType == OP_MUL) {
+        return lowerProduct(1, operation->getOperands(), operation->getOperandCount(), lowering);
+    }
+    Expression *left = operation->getOperand(0);
+    Expression *right = operation->getOperand(1);
+    if (left->type == EXPRESSION_CONSTANT && right->type == EXPRESSION_CONSTANT) {
+        // Fold what the simplifier left behind, rather than computing it every evaluation.
+        return constantRegister(apply(opType, ((Constant*) left)->getValue(), ((Constant*) right)->getValue()), lowering);
+    }
+    std::uint32_t base = lower(left, lowering);
+    if (opType == OP_EXP && right->type == EXPRESSION_CONSTANT) {
+        return lowerPower(base, ((Constant*) right)->getValue(), lowering);
+    }
+    std::uint32_t value = lower(right, lowering);
+    switch (opType) {
+        case OP_MIN:
+            return emit(OPCODE_SUB, base, value);
+        case OP_DIV:
+            return emit(OPCODE_DIV, base, value);
+        default:
+            return emit(OPCODE_POW, base, value);
+    }
+}
+
+const std::vector<Instruction> &Program::getInstructions() const {
+    return this->instructions;
+}
+
+const std::vector<double> &Program::getConstants() const {
+    return this->constants;
+}
+
+const std::vector<std::string> &Program::getVariables() const {
+    return this->variables;
+}
+
+const std::vector<symbol_t> &Program::getSymbols() const {
+    return this->symbols;
+}
+
+std::uint32_t Program::getResult() const {
+    return this->result;
+}
+
+std::uint32_t Program::getRegisterCount() const {
+    return this->registerCount;
+}
+
+std::uint32_t Program::getVariableBase() const {
+    return (std::uint32_t) this->constants.size();
+}
+
+std::uint32_t Program::getTemporaryBase() const {
+    return (std::uint32_t) (this->constants.size() + this->variables.size());
+}
+
+double Program::evaluate(const double *values) const {
+    double stackRegisters[PROGRAM_STACK_REGISTERS];
+    std::vector<double> heapRegisters;
+    double *r = stackRegisters;
+    if (registerCount > PROGRAM_STACK_REGISTERS) {
+        heapRegisters.resize(registerCount);
+        r = heapRegisters.data();
+    }
+    // Plain loops, the pools are usually too small for a call to memcpy to pay off.
+    std::size_t constantCount = constants.size();
+    for (std::size_t i = 0; i < constantCount; i++) {
+        r[i] = constants[i];
+    }
+    for (std::size_t i = 0; i < variables.size(); i++) {
+        r[constantCount + i] = values[i];
+    }
+    const Instruction *ip = instructions.data();
+    const Instruction *end = ip + instructions.size();
+#if defined(__GNUC__)
+    // Threaded dispatch, each handler jumps straight to the next one.
+    static void *handlers[] = {&&add, &&sub, &&mul, &&div, &&pow, &&powi, &&sqrt};
+#define DISPATCH() if (ip == end) goto done; goto *handlers[ip->opCode]
+#define NEXT() ip++; DISPATCH()
+    DISPATCH();
+    add: r[ip->dst] = r[ip->a] + r[ip->b]; NEXT();
+    sub: r[ip->dst] = r[ip->a] - r[ip->b]; NEXT();
+    mul: r[ip->dst] = r[ip->a] * r[ip->b]; NEXT();
+    div: r[ip->dst] = r[ip->a] / r[ip->b]; NEXT();
+    pow: r[ip->dst] = std::pow(r[ip->a], r[ip->b]); NEXT();
+    powi: r[ip->dst] = powi(r[ip->a], (std::int32_t) ip->b); NEXT();
+    sqrt: r[ip->dst] = std::sqrt(r[ip->a]); NEXT();
+    done:
+#undef NEXT
+#undef DISPATCH
+#else
+    for (; ip != end; ip++) {
+        switch (ip->opCode) {
+            case OPCODE_ADD:
+                r[ip->dst] = r[ip->a] + r[ip->b];
+                break;
+            case OPCODE_SUB:
+                r[ip->dst] = r[ip->a] - r[ip->b];
+                break;
+            case OPCODE_MUL:
+                r[ip->dst] = r[ip->a] * r[ip->b];
+                break;
+            case OPCODE_DIV:
+                r[ip->dst] = r[ip->a] / r[ip->b];
+                break;
+            case OPCODE_POW:
+                r[ip->dst] = std::pow(r[ip->a], r[ip->b]);
+                break;
+            case OPCODE_POWI:
+                r[ip->dst] = powi(r[ip->a], (std::int32_t) ip->b);
+                break;
+            case OPCODE_SQRT:
+                r[ip->dst] = std::sqrt(r[ip->a]);
+                break;
+        }
+    }
+#endif
+    return r[result];
+}
+
+double Program::evaluate(const std::unordered_map<std::string, double> &values) const {
+    std::vector<double> ordered;
+    ordered.reserve(variables.size());
+    for (const std::string &name : variables) {
+        auto value = values.find(name);
+        ordered.push_back(value == values.end() ? NAN : value->second);
+    }
+    return evaluate(ordered.data());
+}
+
+double Program::evaluate(const std::unordered_map<symbol_t, double> &values) const {
+    std::vector<double> ordered;
+    ordered.reserve(symbols.size());
+    for (symbol_t symbol : symbols) {
+        auto value = values.find(symbol);
+        ordered.push_back(value == values.end() ? NAN : value->second);
+    }
+    return evaluate(ordered.data());
+}
@@ -0,0 +1,151 @@
+#ifndef FLUXION_BYTECODE_H
+#define FLUXION_BYTECODE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Expression.h"
+#include "Schedule.h"
+
+#define PROGRAM_STACK_REGISTERS 64 // Programs with at most this many registers evaluate without allocating.
+
+enum OpCode : std::uint32_t {
+    OPCODE_ADD,
+    OPCODE_SUB,
+    OPCODE_MUL,
+    OPCODE_DIV,
+    OPCODE_POW,
+    OPCODE_POWI, // Power with the integer exponent stored in b.
+    OPCODE_SQRT, // Power of 0.5, b is unused.
+};
+
+/**
+ * @return base ^ exponent, by repeated squaring.
+ */
+inline double powi(double base, std::int32_t exponent) {
+    // Negated as unsigned, since -INT32_MIN does not fit.
+    unsigned n = exponent < 0 ? 0u - static_cast<unsigned>(exponent) : static_cast<unsigned>(exponent);
+    double result = 1;
+    for (; n != 0; n >>= 1) {
+        if (n & 1) {
+            result *= base;
+        }
+        base *= base;
+    }
+    return exponent < 0 ? 1 / result : result;
+}
+
+/**
+ * A single register instruction, dst = a op b.
+ */
+struct Instruction {
+    OpCode opCode;
+    std::uint32_t dst;
+    std::uint32_t a;
+    std::uint32_t b;
+};
+
+/**
+ * A simplified expression lowered to a linear register program.
+ * Operations are lowered in the order of its Schedule, operands first,
+ * so subtrees repeated in the expression are computed once and lowering
+ * needs no recursion, whatever the depth of the expression.
+ *
+ * The registers are laid out as the constant pool, followed by one
+ * register per variable, followed by temporaries. Constants are loaded
+ * once per evaluation and variables are copied from the bindings.
+ */
+class Program {
+private:
+    std::vector<Instruction> instructions;
+    std::vector<double> constants;
+    std::vector<std::string> variables; // Sorted names, variable i is bound to register constants.size() + i.
+    std::vector<symbol_t> symbols; // Symbol of each variable, in the same order.
+    std::uint32_t result; // Register holding the value after the program is ran.
+    std::uint32_t registerCount;
+    std::uint32_t temporaryCount;
+    /**
+     * State only needed while lowering.
+     */
+    struct Lowering {
+        std::unordered_map<Expression*, std::uint32_t> variableIndices;
+        std::unordered_map<Expression*, std::uint32_t, NodeHash> registers; // Register of each lowered operation.
+        std::unordered_set<Expression*, NodeHash> absorbed; // Lowered by the only operation using them, such as y in x - y.
+        std::unordered_map<std::uint64_t, std::uint32_t> constantIndices; // By bit pattern.
+    };
+    /**
+     * @return register holding a constant, a variable or an operation already lowered.
+     */
+    std::uint32_t lower(Expression *expression, Lowering &lowering);
+    /**
+     * Lower an operation whose operands are lowered, appending its instructions.
+     */
+    std::uint32_t lowerOperation(Operation *operation, Lowering &lowering);
+    /**
+     * Lower a sum, terms with a negative coefficient are subtracted, so x - y stays a subtraction.
+     */
+    std::uint32_t lowerSum(Operation *sum, Lowering &lowering);
+    /**
+     * Lower coefficient * factors, factors with a negative constant exponent are divided by,
+     * so x / y stays a division.
+     */
+    std::uint32_t lowerProduct(double coefficient, Expression *const *factors, std::size_t count, Lowering &lowering);
+    /**
+     * @return register holding base ^ exponent.
+     */
+    std::uint32_t lowerPower(std::uint32_t base, double exponent, Lowering &lowering);
+    /**
+     * Append dst = a op b, dst is a new temporary.
+     *
+     * @return the destination register.
+     */
+    std::uint32_t emit(OpCode opCode, std::uint32_t a, std::uint32_t b);
+    std::uint32_t constantRegister(double value, Lowering &lowering);
+    /**
+     * Map the temporaries written once each by lowering onto as few
+     * temporaries as possible, one is reused once its value is read for
+     * the last time.
+     */
+    void allocateTemporaries();
+public:
+    const std::vector<Instruction> &getInstructions() const;
+    const std::vector<double> &getConstants() const;
+    /**
+     * @return names of the variables, in the order values are expected.
+     */
+    const std::vector<std::string> &getVariables() const;
+    /**
+     * @return symbols of the variables, in the order values are expected.
+     */
+    const std::vector<symbol_t> &getSymbols() const;
+    std::uint32_t getResult() const;
+    std::uint32_t getRegisterCount() const;
+    /**
+     * @return the register of the first variable, also the number of constants.
+     */
+    std::uint32_t getVariableBase() const;
+    /**
+     * @return the register of the first temporary.
+     */
+    std::uint32_t getTemporaryBase() const;
+    /**
+     * Run the program.
+     *
+     * @param values Value of each variable, in the order of getVariables.
+     * @return value of the expression.
+     */
+    double evaluate(const double *values) const;
+    /**
+     * Run the program, finding variables by name, missing variables are NaN.
+     */
+    double evaluate(const std::unordered_map<std::string, double> &values) const;
+    /**
+     * Run the program, finding variables by symbol, missing variables are NaN.
+     */
+    double evaluate(const std::unordered_map<symbol_t, double> &values) const;
+    explicit Program(Expression *expression);
+};
+
+#endif //FLUXION_BYTECODE_H
@@ -0,0 +1,36 @@
+#include "ColumnKernels.h"
+
+void kernels::applyScalar(OperationType opType, const double *left, double leftScalar,
+                          const double *right, double rightScalar, double *output, std::size_t count) {
+    apply<ScalarLanes>(opType, left, leftScalar, right, rightScalar, output, count);
+}
+
+void kernels::applySse2(OperationType opType, const double *left, double leftScalar,
+                        const double *right, double rightScalar, double *output, std::size_t count) {
+#if defined(__SSE2__)
+    apply<Sse2Lanes>(opType, left, leftScalar, right, rightScalar, output, count);
+#else
+    apply<ScalarLanes>(opType, left, leftScalar, right, rightScalar, output, count);
+#endif
+}
+
+kernels::Kernel kernels::select() {
+#if defined(FLUXION_HAS_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return applyAvx2;
+    }
+#endif
+#if defined(__SSE2__)
+    return applySse2;
+#else
+    return applyScalar;
+#endif
+}
+
+const char *kernels::selectedName() {
+    Kernel kernel = select();
+    if (kernel == applyScalar) {
+        return "scalar";
+    }
+    return kernel == applySse2 ? "sse2" : "avx2";
+}
@@ -0,0 +1,194 @@
+#ifndef FLUXION_COLUMNKERNELS_H
+#define FLUXION_COLUMNKERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include "Expression.h"
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define KERNEL_MAX_INTEGER_EXPONENT 64 // Larger integer powers go through std::pow.
+
+/**
+ * Element wise kernels used by the columnar evaluator, the same kernels
+ * are compiled once per instruction set and the best one supported by
+ * the machine is chosen at runtime.
+ */
+namespace kernels {
+    /**
+     * Apply an operation element wise, an operand is either a column of
+     * count values or, if its pointer is null, a scalar repeated for every element.
+     */
+    typedef void (*Kernel)(OperationType opType, const double *left, double leftScalar,
+                           const double *right, double rightScalar, double *output, std::size_t count);
+
+    void applyScalar(OperationType opType, const double *left, double leftScalar,
+                     const double *right, double rightScalar, double *output, std::size_t count);
+    void applySse2(OperationType opType, const double *left, double leftScalar,
+                   const double *right, double rightScalar, double *output, std::size_t count);
+    void applyAvx2(OperationType opType, const double *left, double leftScalar,
+                   const double *right, double rightScalar, double *output, std::size_t count);
+    /**
+     * @return the widest kernel supported by the running processor.
+     */
+    Kernel select();
+    /**
+     * @return name of the instruction set of the selected kernel.
+     */
+    const char *selectedName();
+
+    struct ScalarLanes {
+        typedef double Vector;
+        static const std::size_t width = 1;
+        static inline Vector load(const double *p) {return *p;}
+        static inline Vector broadcast(double v) {return v;}
+        static inline void store(double *p, Vector v) {*p = v;}
+        static inline Vector add(Vector a, Vector b) {return a + b;}
+        static inline Vector sub(Vector a, Vector b) {return a - b;}
+        static inline Vector mul(Vector a, Vector b) {return a * b;}
+        static inline Vector div(Vector a, Vector b) {return a / b;}
+        static inline Vector sqrt(Vector a) {return std::sqrt(a);}
+    };
+
+#if defined(__SSE2__)
+    struct Sse2Lanes {
+        typedef __m128d Vector;
+        static const std::size_t width = 2;
+        static inline Vector load(const double *p) {return _mm_loadu_pd(p);}
+        static inline Vector broadcast(double v) {return _mm_set1_pd(v);}
+        static inline void store(double *p, Vector v) {_mm_storeu_pd(p, v);}
+        static inline Vector add(Vector a, Vector b) {return _mm_add_pd(a, b);}
+        static inline Vector sub(Vector a, Vector b) {return _mm_sub_pd(a, b);}
+        static inline Vector mul(Vector a, Vector b) {return _mm_mul_pd(a, b);}
+        static inline Vector div(Vector a, Vector b) {return _mm_div_pd(a, b);}
+        static inline Vector sqrt(Vector a) {return _mm_sqrt_pd(a);}
+    };
+#endif
+
+#if defined(__AVX2__)
+    struct Avx2Lanes {
+        typedef __m256d Vector;
+        static const std::size_t width = 4;
+        static inline Vector load(const double *p) {return _mm256_loadu_pd(p);}
+        static inline Vector broadcast(double v) {return _mm256_set1_pd(v);}
+        static inline void store(double *p, Vector v) {_mm256_storeu_pd(p, v);}
+        static inline Vector add(Vector a, Vector b) {return _mm256_add_pd(a, b);}
+        static inline Vector sub(Vector a, Vector b) {return _mm256_sub_pd(a, b);}
+        static inline Vector mul(Vector a, Vector b) {return _mm256_mul_pd(a, b);}
+        static inline Vector div(Vector a, Vector b) {return _mm256_div_pd(a, b);}
+        static inline Vector sqrt(Vector a) {return _mm256_sqrt_pd(a);}
+    };
+#endif
+
+    template <typename Lanes> struct AddOp {
+        static inline typename Lanes::Vector vector(typename Lanes::Vector a, typename Lanes::Vector b) {return Lanes::add(a, b);}
+        static inline double scalar(double a, double b) {return a + b;}
+    };
+    template <typename Lanes> struct SubOp {
+        static inline typename Lanes::Vector vector(typename Lanes::Vector a, typename Lanes::Vector b) {return Lanes::sub(a, b);}
+        static inline double scalar(double a, double b) {return a - b;}
+    };
+    template <typename Lanes> struct MulOp {
+        static inline typename Lanes::Vector vector(typename Lanes::Vector a, typename Lanes::Vector b) {return Lanes::mul(a, b);}
+        static inline double scalar(double a, double b) {return a * b;}
+    };
+    template <typename Lanes> struct DivOp {
+        static inline typename Lanes::Vector vector(typename Lanes::Vector a, typename Lanes::Vector b) {return Lanes::div(a, b);}
+        static inline double scalar(double a, double b) {return a / b;}
+    };
+
+    template <typename Lanes, typename Op>
+    inline void run(const double *left, double leftScalar, const double *right, double rightScalar,
+                    double *output, std::size_t count) {
+        std::size_t i = 0;
+        // Operand shapes are decided outside the loops, so each loop is a straight vector loop.
+        if (left != nullptr && right != nullptr) {
+            for (; i + Lanes::width <= count; i += Lanes::width) {
+                Lanes::store(output + i, Op::vector(Lanes::load(left + i), Lanes::load(right + i)));
+            }
+        } else if (left != nullptr) {
+            typename Lanes::Vector r = Lanes::broadcast(rightScalar);
+            for (; i + Lanes::width <= count; i += Lanes::width) {
+                Lanes::store(output + i, Op::vector(Lanes::load(left + i), r));
+            }
+        } else if (right != nullptr) {
+            typename Lanes::Vector l = Lanes::broadcast(leftScalar);
+            for (; i + Lanes::width <= count; i += Lanes::width) {
+                Lanes::store(output + i, Op::vector(l, Lanes::load(right + i)));
+            }
+        }
+        for (; i < count; i++) { // Remainder, or both operands are scalars.
+            output[i] = Op::scalar(left != nullptr ? left[i] : leftScalar, right != nullptr ? right[i] : rightScalar);
+        }
+    }
+
+    /**
+     * Raise a column to a constant integer power by repeated squaring.
+     */
+    template <typename Lanes>
+    inline void runIntegerPower(const double *base, long exponent, double *output, std::size_t count) {
+        unsigned long n = exponent < 0 ? -exponent : exponent;
+        typename Lanes::Vector one = Lanes::broadcast(1.0);
+        std::size_t i = 0;
+        for (; i + Lanes::width <= count; i += Lanes::width) {
+            typename Lanes::Vector x = Lanes::load(base + i);
+            typename Lanes::Vector result = one;
+            for (unsigned long e = n; e != 0; e >>= 1) {
+                if (e & 1) {
+                    result = Lanes::mul(result, x);
+                }
+                x = Lanes::mul(x, x);
+            }
+            Lanes::store(output + i, exponent < 0 ? Lanes::div(one, result) : result);
+        }
+        for (; i < count; i++) {
+            output[i] = std::pow(base[i], (double) exponent);
+        }
+    }
+
+    template <typename Lanes>
+    inline void apply(OperationType opType, const double *left, double leftScalar,
+                      const double *right, double rightScalar, double *output, std::size_t count) {
+        switch (opType) {
+            case OP_ADD:
+                run<Lanes, AddOp<Lanes>>(left, leftScalar, right, rightScalar, output, count);
+                break;
+            case OP_MIN:
+                run<Lanes, SubOp<Lanes>>(left, leftScalar, right, rightScalar, output, count);
+                break;
+            case OP_MUL:
+                run<Lanes, MulOp<Lanes>>(left, leftScalar, right, rightScalar, output, count);
+                break;
+            case OP_DIV:
+                run<Lanes, DivOp<Lanes>>(left, leftScalar, right, rightScalar, output, count);
+                break;
+            case OP_EXP:
+                if (left != nullptr && right == nullptr && rightScalar == std::floor(rightScalar)
+                    && std::fabs(rightScalar) <= KERNEL_MAX_INTEGER_EXPONENT) {
+                    runIntegerPower<Lanes>(left, (long) rightScalar, output, count);
+                } else if (left != nullptr && right == nullptr && rightScalar == 0.5) {
+                    std::size_t i = 0;
+                    for (; i + Lanes::width <= count; i += Lanes::width) {
+                        Lanes::store(output + i, Lanes::sqrt(Lanes::load(left + i)));
+                    }
+                    for (; i < count; i++) {
+                        output[i] = std::sqrt(left[i]);
+                    }
+                } else { // There is no vector pow, so general powers are computed one by one.
+                    for (std::size_t i = 0; i < count; i++) {
+                        output[i] = std::pow(left != nullptr ? left[i] : leftScalar, right != nullptr ? right[i] : rightScalar);
+                    }
+                }
+                break;
+            default:
+                for (std::size_t i = 0; i < count; i++) {
+                    output[i] = NAN;
+                }
+                break;
+        }
+    }
+}
+
+#endif //FLUXION_COLUMNKERNELS_H
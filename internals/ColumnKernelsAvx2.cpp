@@ -0,0 +1,12 @@
+#include "ColumnKernels.h"
+
+// This file is compiled with AVX2 enabled, it must only be called after checking the processor supports it.
+
+void kernels::applyAvx2(OperationType opType, const double *left, double leftScalar,
+                        const double *right, double rightScalar, double *output, std::size_t count) {
+#if defined(__AVX2__)
+    apply<Avx2Lanes>(opType, left, leftScalar, right, rightScalar, output, count);
+#else
+    applySse2(opType, left, leftScalar, right, rightScalar, output, count);
+#endif
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include "Columnar.h"
+
+ColumnEvaluator::ColumnEvaluator(Expression *expression) : program(expression), kernel(kernels::select()) {
+
+}
+
+const std::vector<std::string> &ColumnEvaluator::getVariables() const {
+    return program.getVariables();
+}
+
+void ColumnEvaluator::evaluate(const double *const *columns, double *output, std::size_t rows) const {
+    const std::vector<Instruction> &instructions = program.getInstructions();
+    const std::vector<double> &constants = program.getConstants();
+    std::uint32_t variableBase = program.getVariableBase();
+    std::uint32_t temporaryBase = program.getTemporaryBase();
+    std::uint32_t result = program.getResult();
+    if (instructions.empty()) { // There are no operations at all.
+        for (std::size_t row = 0; row < rows; row++) {
+            output[row] = result < variableBase ? constants[result] : columns[result - variableBase][row];
+        }
+        return;
+    }
+    std::vector<double> scratch((program.getRegisterCount() - temporaryBase) * COLUMN_BLOCK_SIZE);
+    for (std::size_t start = 0; start < rows; start += COLUMN_BLOCK_SIZE) {
+        std::size_t count = std::min((std::size_t) COLUMN_BLOCK_SIZE, rows - start);
+        // Constants are broadcast scalars, variables are read in place.
+        auto column = [&](std::uint32_t r) -> const double * {
+            if (r < variableBase) {
+                return nullptr;
+            } else if (r < temporaryBase) {
+                return columns[r - variableBase] + start;
+            }
+            return scratch.data() + (r - temporaryBase) * COLUMN_BLOCK_SIZE;
+        };
+        auto scalar = [&](std::uint32_t r) {
+            return r < variableBase ? constants[r] : 0.0;
+        };
+        for (std::size_t i = 0; i < instructions.size(); i++) {
+            const Instruction &instruction = instructions[i];
+            // The last instruction writes straight into the output column.
+            double *destination = i + 1 == instructions.size() ? output + start
+                    : scratch.data() + (instruction.dst - temporaryBase) * COLUMN_BLOCK_SIZE;
+            const double *a = column(instruction.a);
+            switch (instruction.opCode) {
+                case OPCODE_POWI:
+                    kernel(OP_EXP, a, scalar(instruction.a), nullptr, (double) (std::int32_t) instruction.b, destination, count);
+                    break;
+                case OPCODE_SQRT:
+                    kernel(OP_EXP, a, scalar(instruction.a), nullptr, 0.5, destination, count);
+                    break;
+                default: {
+                    static const OperationType opTypes[] = {OP_ADD, OP_MIN, OP_MUL, OP_DIV, OP_EXP};
+                    kernel(opTypes[instruction.opCode], a, scalar(instruction.a), column(instruction.b),
+                           scalar(instruction.b), destination, count);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool ColumnEvaluator::evaluate(const std::unordered_map<std::string, const double *> &columns, double *output, std::size_t rows) const {
+    const std::vector<std::string> &variables = program.getVariables();
+    std::vector<const double*> ordered;
+    ordered.reserve(variables.size());
+    for (const std::string &name : variables) {
+        auto column = columns.find(name);
+        if (column == columns.end()) {
+            return false;
+        }
+        ordered.push_back(column->second);
+    }
+    evaluate(ordered.data(), output, rows);
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef FLUXION_COLUMNAR_H
+#define FLUXION_COLUMNAR_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Expression.h"
+#include "Bytecode.h"
+#include "ColumnKernels.h"
+
+#define COLUMN_BLOCK_SIZE 512 // Rows evaluated at once, sized so temporaries stay in L1/L2.
+
+/**
+ * Evaluates an expression over columns of variable values. The expression
+ * is lowered once into a register program, whose instructions are then
+ * applied to whole blocks of rows with vectorised kernels, every
+ * temporary register becoming a column of a block.
+ */
+class ColumnEvaluator {
+private:
+    Program program;
+    kernels::Kernel kernel;
+public:
+    /**
+     * @return names of the variables, in the order columns are expected.
+     */
+    const std::vector<std::string> &getVariables() const;
+    /**
+     * Evaluate the expression for every row.
+     *
+     * @param columns One column per variable, in the order of getVariables.
+     * @param output Column to write the results to.
+     * @param rows Number of rows.
+     */
+    void evaluate(const double *const *columns, double *output, std::size_t rows) const;
+    /**
+     * Evaluate the expression for every row, finding the columns by variable name.
+     *
+     * @return false if a variable has no column.
+     */
+    bool evaluate(const std::unordered_map<std::string, const double*> &columns, double *output, std::size_t rows) const;
+    explicit ColumnEvaluator(Expression *expression);
+};
+
+#endif //FLUXION_COLUMNAR_H
@@ -1,58 +1,148 @@
+#include <algorithm>
 #include "Compiler.h"
+#include "Instrumentation.h"
 
-#include <utility>
+Compiler::Compiler(const std::vector<Token> &tokens) : root(nullptr), tokens(tokens), position(0), status(COMPILATION_SUCCESSFUL), deepest(0) {
 
-Compiler::Compiler(std::vector<Token*> tokens) : root(nullptr), status(COMPILATION_SUCCESSFUL) {
-    this->tokens = reverseVector(tokens); // We could make this work in reverse.
-    this->orderOfOperations = (OperationTuple*) malloc(PRECEDENCE_LEVEL_COUNT * sizeof(OperationTuple));
-    this->orderOfOperations[0] = {OP_ADD, OP_MIN};
-    this->orderOfOperations[1] = {OP_MUL, OP_DIV};
-    this->orderOfOperations[2] = {OP_EXP, OP_EXP};
 }
 
 Expression *Compiler::getRoot() {
     return this->root;
 }
 
-Expression *Compiler::compileBasicExpression(Token *token) {
+int Compiler::getPrecedence(OperationType opType) {
+    switch (opType) {
+        case OP_ADD:
+        case OP_MIN:
+            return 1;
+        case OP_MUL:
+        case OP_DIV:
+            return 2;
+        case OP_EXP:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+bool Compiler::isRightAssociative(OperationType opType) {
+    return opType == OP_EXP; // a ^ b ^ c = a ^ (b ^ c)
+}
+
+const Token *Compiler::peek() const {
+    return position < tokens.size() ? &tokens[position] : nullptr;
+}
+
+Expression *Compiler::fail() {
+    this->status = COMPILATION_FAILED;
+    return nullptr;
+}
+
+Expression *Compiler::compileBasicExpression(const Token *token) {
     switch (token->getTokenType()) {
         case TOKEN_CONSTANT:
-            return new Constant(dynamic_cast<ConstantToken*>(token)->getValue());
+            return Constant::create(token->getValue());
         case TOKEN_VARIABLE:
-            return new Variable(dynamic_cast<VariableToken*>(token)->getName());
+            return Variable::create(token->getSymbol());
         default:
             return nullptr;
     }
 }
 
-Expression *Compiler::compile(int tokenStartIndex, int tokenStopIndex, int precedenceLevel) {
-    if (tokenStartIndex + 1 == tokenStopIndex) { // Only a single token left, termination condition.
-        return compileBasicExpression(this->tokens[tokenStartIndex]);
-    } else if (precedenceLevel > PRECEDENCE_LEVEL_COUNT) { // We are looking for an operator that doesn't exist.
-        this->status = COMPILATION_FAILED; // Set the status to failed.
-        return nullptr; // return nullptr.
-    }
-    Token *token;
-    OperationType currentOpType;
-    for (int i = tokenStartIndex; i < tokenStopIndex; i++) {
-        token = tokens[i];
-        if (token->getTokenType() == TOKEN_OPERATOR) {
-            // If it is an operator check if it is in the precedence level we want.
-            // First, get its operation type.
-            currentOpType = dynamic_cast<OperatorToken*>(token)->getOperationType();
-            if (this->orderOfOperations[precedenceLevel].isOneOf(currentOpType)) {
-                // Left and right is reversed since we are working on a reverse list.
-                return new Operation(compile(i + 1, tokenStopIndex, 0), compile(tokenStartIndex, i, 0), currentOpType);
-            }
+int Compiler::getOperandPrecedence(const Pending &pending) {
+    switch (pending.type) {
+        case PENDING_NEGATION:
+            return PRECEDENCE_NEGATION;
+        case PENDING_PARENTHESIS:
+            return 0;
+        default:
+            break;
+    }
+    // Left associative operators only take tighter operators to their right, so a - b - c = (a - b) - c.
+    int precedence = getPrecedence(pending.opType);
+    return isRightAssociative(pending.opType) ? precedence : precedence + 1;
+}
+
+void Compiler::reduce() {
+    Pending pending = operators.back();
+    operators.pop_back();
+    Expression *right = operands.back();
+    operands.pop_back();
+    if (pending.type == PENDING_NEGATION) {
+        if (right->type == EXPRESSION_CONSTANT) {
+            operands.push_back(Constant::create(-((Constant*) right)->getNumber()));
+        } else {
+            operands.push_back(Operation::create(Constant::create(-1), right, OP_MUL));
         }
+        return;
     }
-    // If we couldn't find any operator with this precedence level in the current expression,
-    // Try compiling with the next precedence level.
-    return compile(tokenStartIndex, tokenStopIndex, precedenceLevel + 1);
+    Expression *left = operands.back();
+    operands.back() = Operation::create(left, right, pending.opType);
+}
 
+Expression *Compiler::compileExpression() {
+    operands.clear();
+    operators.clear();
+    bool expectOperand = true;
+    for (const Token *token = peek(); token != nullptr; token = peek()) {
+        deepest = std::max(deepest, operators.size());
+        TokenType tokenType = token->getTokenType();
+        if (expectOperand) {
+            if (tokenType == TOKEN_CONSTANT || tokenType == TOKEN_VARIABLE) {
+                operands.push_back(compileBasicExpression(token));
+                expectOperand = false;
+            } else if (tokenType == TOKEN_LEFT_PAREN) {
+                operators.push_back({PENDING_PARENTHESIS, OP_ERR});
+            } else if (tokenType == TOKEN_OPERATOR && token->getOperationType() == OP_MIN) {
+                operators.push_back({PENDING_NEGATION, OP_MIN});
+            } else {
+                return fail(); // Only - can be used as a prefix.
+            }
+            position++;
+            continue;
+        }
+        if (tokenType == TOKEN_OPERATOR) {
+            OperationType opType = token->getOperationType();
+            int precedence = getPrecedence(opType);
+            // Operators that bind tighter than this one have all their operands.
+            while (!operators.empty() && precedence < getOperandPrecedence(operators.back())) {
+                reduce();
+            }
+            operators.push_back({PENDING_BINARY, opType});
+            expectOperand = true;
+        } else if (tokenType == TOKEN_RIGHT_PAREN) {
+            while (!operators.empty() && operators.back().type != PENDING_PARENTHESIS) {
+                reduce();
+            }
+            if (operators.empty()) {
+                break; // An unmatched ), left as a trailing token.
+            }
+            operators.pop_back();
+        } else {
+            break; // Two operands in a row, the second one is a trailing token.
+        }
+        position++;
+    }
+    if (expectOperand) {
+        return fail(); // Expected an operand, but the input ended.
+    }
+    while (!operators.empty()) {
+        if (operators.back().type == PENDING_PARENTHESIS) {
+            return fail(); // Unbalanced parentheses.
+        }
+        reduce();
+    }
+    return operands.back();
 }
 
 CompilationStatus Compiler::compile() {
-    this->root = compile(0, tokens.size(), 0);
+    Instrumentation::Scope scope {PHASE_COMPILE};
+    this->position = 0;
+    this->deepest = 0;
+    this->root = compileExpression();
+    if (this->root != nullptr && this->position != tokens.size()) {
+        fail(); // Trailing tokens, such as an unmatched ) or two operands in a row.
+    }
+    Instrumentation::reportDepth(PHASE_COMPILE, this->deepest);
     return this->status;
 }
@@ -2,7 +2,8 @@
 #define FLUXION_COMPILER_H
 #include "Parser.h"
 #include "Expression.h"
-#define PRECEDENCE_LEVEL_COUNT 3
+
+#define PRECEDENCE_NEGATION 3 // Binds tighter than * and /, but looser than ^, so -a^2 = -(a^2).
 
 enum CompilationStatus {
     COMPILATION_SUCCESSFUL,
@@ -10,35 +11,74 @@ enum CompilationStatus {
 };
 
 /**
- * Represents a tuple of operations of same precedence.
+ * Compiles tokens into an expression tree in a single pass using operator
+ * precedence, every token is visited once. Operands and operators waiting
+ * for their right operand are kept on explicit stacks rather than the call
+ * stack, so the depth of nesting is only bounded by memory.
  */
-class OperationTuple {
+class Compiler {
 private:
-    OperationType op1;
-    OperationType op2;
-public:
-    OperationTuple(OperationType op1, OperationType op2) : op1(op1), op2(op2) {};
+    enum PendingType {
+        PENDING_BINARY,
+        PENDING_NEGATION,
+        PENDING_PARENTHESIS
+    };
     /**
-     * Check if the given type is one of the types inside the tuple.
-     * @param type Type to check for
-     * @return true if type is either op1 or op2.
+     * An operator waiting for its right operand, or an open parenthesis.
      */
-    inline bool isOneOf(OperationType type) {return type == op1 || type == op2;}
-};
-
-class Compiler {
-private:
+    struct Pending {
+        PendingType type;
+        OperationType opType;
+    };
     Expression *root;
-    std::vector<Token*> tokens;
+    const std::vector<Token> &tokens;
+    std::size_t position; // Index of the next token to compile.
     CompilationStatus status;
-    OperationTuple *orderOfOperations;
-    Expression *compileBasicExpression(Token *token);
-    Expression *compile(int tokenStartIndex, int tokenStopIndex, int precedenceLevel);
+    std::vector<Expression*> operands;
+    std::vector<Pending> operators;
+    std::size_t deepest; // Most operators pending at once.
+    /**
+     * @return the next token, or nullptr if all tokens are consumed.
+     */
+    const Token *peek() const;
+    /**
+     * Mark the compilation as failed.
+     *
+     * @return nullptr, so it can be returned directly.
+     */
+    Expression *fail();
+    Expression *compileBasicExpression(const Token *token);
+    /**
+     * @return lowest precedence an operator may have to be part of the
+     * operand of the pending operator.
+     */
+    static int getOperandPrecedence(const Pending &pending);
+    /**
+     * Apply the operator on top of the stack to the operands on top of theirs.
+     */
+    void reduce();
+    /**
+     * Compile every token that belongs to the expression, stopping at the
+     * first one that cannot continue it.
+     *
+     * @return the compiled expression or nullptr if compilation failed.
+     */
+    Expression *compileExpression();
 public:
+    /**
+     * @return precedence of the operator, higher binds tighter.
+     */
+    static int getPrecedence(OperationType opType);
+    /**
+     * @return true if a op b op c should be read as a op (b op c).
+     */
+    static bool isRightAssociative(OperationType opType);
     CompilationStatus compile();
     Expression *getRoot();
-    explicit Compiler(std::vector<Token*> tokens);
-
+    /**
+     * @param tokens Tokens to compile, they must outlive the compiler.
+     */
+    explicit Compiler(const std::vector<Token> &tokens);
 };
 
 #endif //FLUXION_COMPILER_H
@@ -0,0 +1,31 @@
+#include "Context.h"
+
+namespace {
+    thread_local Context *currentContext = nullptr;
+}
+
+Context::Context() : nodes(arena), simplified(arena), numberMode(NUMBER_MODE_EXACT), rewriting(true), ruleGeneration(0) {
+
+}
+
+void Context::reset() {
+    simplified.release();
+    nodes.clear(); // Tables must forget the nodes before their memory goes away.
+    arena.reset();
+}
+
+Context &Context::current() {
+    if (currentContext == nullptr) {
+        thread_local Context threadContext;
+        return threadContext;
+    }
+    return *currentContext;
+}
+
+Context::Scope::Scope(Context &context) : previous(currentContext) {
+    currentContext = &context;
+}
+
+Context::Scope::~Scope() {
+    currentContext = previous;
+}
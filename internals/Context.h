@@ -0,0 +1,49 @@
+#ifndef FLUXION_CONTEXT_H
+#define FLUXION_CONTEXT_H
+
+#include "Arena.h"
+#include "MemoTable.h"
+#include "NodeTable.h"
+
+/**
+ * Owns every token and expression created while interpreting,
+ * all of them live in a single arena and are released together.
+ *
+ * Each thread has a current context, which is the one expressions
+ * and tokens are created in.
+ */
+class Context {
+public:
+    Arena arena;
+    NodeTable nodes;
+    MemoTable simplified; // Memoised results of Operation::evaluate.
+    NumberMode numberMode; // How literals are read, kept across resets.
+    bool rewriting; // Whether rewrite rules are applied, they are not while compiling patterns.
+    std::uint64_t ruleGeneration; // Generation of the rules the memoised results were simplified with.
+    /**
+     * Release every token and expression created in this context.
+     */
+    void reset();
+    /**
+     * @return the current context of the calling thread, if none was
+     * entered, a context that lives as long as the thread is returned.
+     */
+    static Context &current();
+    /**
+     * Makes a context current for the lifetime of the scope.
+     */
+    class Scope {
+    private:
+        Context *previous;
+    public:
+        explicit Scope(Context &context);
+        Scope(const Scope&) = delete;
+        Scope &operator=(const Scope&) = delete;
+        ~Scope();
+    };
+    Context();
+    Context(const Context&) = delete;
+    Context &operator=(const Context&) = delete;
+};
+
+#endif //FLUXION_CONTEXT_H
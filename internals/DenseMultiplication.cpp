@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "DenseMultiplication.h"
+
+namespace {
+    /**
+     * Karatsuba on two operands of the same length n, output has 2n - 1 coefficients.
+     */
+    void karatsubaSquare(const double *a, const double *b, std::size_t n, double *output) {
+        if (n < DENSE_KARATSUBA_THRESHOLD) {
+            dense::schoolbook(a, n, b, n, output);
+            return;
+        }
+        std::size_t low = n / 2;
+        std::size_t high = n - low; // At least as long as the low half.
+        // a = a0 + a1 x^low, so ab = a0 b0 + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) x^low + a1 b1 x^2low.
+        karatsubaSquare(a, b, low, output);
+        output[2 * low - 1] = 0;
+        karatsubaSquare(a + low, b + low, high, output + 2 * low);
+        std::vector<double> sums(2 * high);
+        double *aSum = sums.data();
+        double *bSum = aSum + high;
+        for (std::size_t i = 0; i < high; i++) {
+            aSum[i] = a[low + i] + (i < low ? a[i] : 0);
+            bSum[i] = b[low + i] + (i < low ? b[i] : 0);
+        }
+        std::vector<double> middle(2 * high - 1);
+        karatsubaSquare(aSum, bSum, high, middle.data());
+        for (std::size_t i = 0; i < 2 * low - 1; i++) {
+            middle[i] -= output[i];
+        }
+        for (std::size_t i = 0; i < 2 * high - 1; i++) {
+            middle[i] -= output[2 * low + i];
+        }
+        for (std::size_t i = 0; i < 2 * high - 1; i++) {
+            output[low + i] += middle[i];
+        }
+    }
+
+    struct Modulus {
+        std::uint32_t prime;
+        std::uint32_t root; // Generator of the multiplicative group.
+    };
+
+    // Primes of the form c 2^k + 1, so they have roots of unity of every power of two up to 2^k.
+    const Modulus moduli[] = {{998244353, 3}, {167772161, 3}, {469762049, 3}};
+    const std::size_t NTT_MAX_LENGTH = std::size_t(1) << 23; // Smallest 2^k of the three primes.
+
+    inline std::uint32_t power(std::uint64_t base, std::uint64_t exponent, std::uint32_t prime) {
+        std::uint64_t result = 1;
+        base %= prime;
+        for (; exponent != 0; exponent >>= 1) {
+            if (exponent & 1) {
+                result = result * base % prime;
+            }
+            base = base * base % prime;
+        }
+        return (std::uint32_t) result;
+    }
+
+    /**
+     * Montgomery arithmetic modulo a prime below 2^30, values x are kept as x 2^32 so
+     * products are reduced with multiplications and shifts instead of divisions.
+     */
+    class Montgomery {
+    private:
+        std::uint32_t prime;
+        std::uint32_t negativeInverse; // -1 / prime modulo 2^32.
+        std::uint32_t rSquared; // 2^64 modulo prime.
+    public:
+        explicit Montgomery(std::uint32_t prime) : prime(prime) {
+            std::uint32_t inverse = prime; // Newton's iteration, each step doubles the correct low bits.
+            for (int i = 0; i < 4; i++) {
+                inverse *= 2 - prime * inverse;
+            }
+            this->negativeInverse = 0u - inverse;
+            std::uint64_t r = (std::uint64_t(1) << 32) % prime;
+            this->rSquared = (std::uint32_t) (r * r % prime);
+        }
+
+        /**
+         * @return value / 2^32 modulo the prime, for a value below prime 2^32.
+         */
+        inline std::uint32_t reduce(std::uint64_t value) const {
+            std::uint32_t m = (std::uint32_t) value * this->negativeInverse;
+            auto result = (std::uint32_t) ((value + (std::uint64_t) m * this->prime) >> 32);
+            return result >= this->prime ? result - this->prime : result;
+        }
+
+        inline std::uint32_t multiply(std::uint32_t a, std::uint32_t b) const {
+            return this->reduce((std::uint64_t) a * b);
+        }
+
+        inline std::uint32_t toMontgomery(std::uint32_t value) const {
+            return this->multiply(value, this->rSquared);
+        }
+    };
+
+    /**
+     * In place transform of a power of two length, in Montgomery form.
+     *
+     * @param roots For every level of half length h, the h first powers of its root of unity from index h on,
+     * in Montgomery form.
+     */
+    void transform(std::vector<std::uint32_t> &values, const std::vector<std::uint32_t> &roots,
+                   const Montgomery &montgomery, std::uint32_t prime) {
+        std::size_t n = values.size();
+        for (std::size_t i = 1, j = 0; i < n; i++) {
+            std::size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(values[i], values[j]);
+            }
+        }
+        for (std::size_t length = 2; length <= n; length <<= 1) {
+            std::size_t half = length / 2;
+            const std::uint32_t *levelRoots = roots.data() + half;
+            for (std::size_t start = 0; start < n; start += length) {
+                for (std::size_t i = 0; i < half; i++) {
+                    std::uint32_t u = values[start + i];
+                    std::uint32_t v = montgomery.multiply(values[start + i + half], levelRoots[i]);
+                    values[start + i] = u + v >= prime ? u + v - prime : u + v;
+                    values[start + i + half] = u >= v ? u - v : u + prime - v;
+                }
+            }
+        }
+    }
+
+    /**
+     * @return the product modulo the prime, as a cyclic convolution of length size.
+     */
+    std::vector<std::uint32_t> convolve(const std::int64_t *a, std::size_t n, const std::int64_t *b, std::size_t m,
+                                        std::size_t size, const Modulus &modulus) {
+        std::uint32_t prime = modulus.prime;
+        Montgomery montgomery {prime};
+        auto reduce = [&](std::int64_t value) {
+            std::int64_t residue = value % (std::int64_t) prime;
+            return montgomery.toMontgomery((std::uint32_t) (residue < 0 ? residue + prime : residue));
+        };
+        std::vector<std::uint32_t> x(size, 0);
+        std::vector<std::uint32_t> y(size, 0);
+        for (std::size_t i = 0; i < n; i++) {
+            x[i] = reduce(a[i]);
+        }
+        for (std::size_t i = 0; i < m; i++) {
+            y[i] = reduce(b[i]);
+        }
+        std::uint32_t root = power(modulus.root, (prime - 1) / size, prime);
+        auto powers = [&](std::uint32_t step) {
+            std::vector<std::uint32_t> roots(std::max<std::size_t>(size, 2));
+            roots[size / 2] = montgomery.toMontgomery(1);
+            step = montgomery.toMontgomery(step);
+            for (std::size_t i = size / 2 + 1; i < size; i++) {
+                roots[i] = montgomery.multiply(roots[i - 1], step);
+            }
+            // The root of a level is the square of the root of the next one.
+            for (std::size_t half = size / 4; half >= 1; half /= 2) {
+                for (std::size_t i = 0; i < half; i++) {
+                    roots[half + i] = roots[2 * half + 2 * i];
+                }
+            }
+            return roots;
+        };
+        std::vector<std::uint32_t> roots = powers(root);
+        transform(x, roots, montgomery, prime);
+        transform(y, roots, montgomery, prime);
+        for (std::size_t i = 0; i < size; i++) {
+            x[i] = montgomery.multiply(x[i], y[i]);
+        }
+        transform(x, powers(power(root, prime - 2, prime)), montgomery, prime);
+        // Reducing once more by the inverse of the size divides and leaves Montgomery form at once.
+        std::uint32_t scale = power(size, prime - 2, prime);
+        for (std::uint32_t &value : x) {
+            value = montgomery.multiply(value, scale);
+        }
+        return x;
+    }
+
+    /**
+     * @return the largest absolute coefficient.
+     */
+    double largestMagnitude(const std::int64_t *values, std::size_t count) {
+        double largest = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            largest = std::max(largest, std::fabs((double) values[i]));
+        }
+        return largest;
+    }
+}
+
+void dense::schoolbook(const double *a, std::size_t n, const double *b, std::size_t m, double *output) {
+    std::fill(output, output + n + m - 1, 0.0);
+    for (std::size_t i = 0; i < n; i++) {
+        double coefficient = a[i];
+        for (std::size_t j = 0; j < m; j++) {
+            output[i + j] += coefficient * b[j];
+        }
+    }
+}
+
+void dense::karatsuba(const double *a, std::size_t n, const double *b, std::size_t m, double *output) {
+    if (n < m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    if (m < DENSE_KARATSUBA_THRESHOLD) {
+        schoolbook(a, n, b, m, output);
+        return;
+    }
+    // The longer operand is cut into pieces as long as the shorter one, so every product is balanced.
+    std::fill(output, output + n + m - 1, 0.0);
+    std::vector<double> piece(m);
+    std::vector<double> product(2 * m - 1);
+    for (std::size_t offset = 0; offset < n; offset += m) {
+        std::size_t length = std::min(m, n - offset);
+        std::copy(a + offset, a + offset + length, piece.begin());
+        std::fill(piece.begin() + length, piece.end(), 0.0);
+        karatsubaSquare(piece.data(), b, m, product.data());
+        std::size_t used = std::min(product.size(), n + m - 1 - offset);
+        for (std::size_t i = 0; i < used; i++) {
+            output[offset + i] += product[i];
+        }
+    }
+}
+
+bool dense::ntt(const std::int64_t *a, std::size_t n, const std::int64_t *b, std::size_t m, WideInteger *output) {
+#ifdef __SIZEOF_INT128__
+    double largestA = largestMagnitude(a, n);
+    double largestB = largestMagnitude(b, m);
+    // Coefficients of the product are rebuilt modulo the product of as few primes as they need,
+    // signed values need a bit less than half of it, about 2^28, 2^56 or 2^85.
+    double bound = largestA * largestB * (double) std::min(n, m);
+    if (bound >= 3.8e25) {
+        return false;
+    }
+    int primes = bound < 4.9e8 ? 1 : bound < 8.3e16 ? 2 : 3;
+    std::size_t size = 1;
+    while (size < n + m - 1) {
+        size <<= 1;
+    }
+    if (size > NTT_MAX_LENGTH) {
+        return false;
+    }
+    std::vector<std::uint32_t> residues[3];
+    for (int i = 0; i < primes; i++) {
+        residues[i] = convolve(a, n, b, m, size, moduli[i]);
+    }
+    // Garner's algorithm, x = r0 + p0 (k1 + p1 k2).
+    const std::uint64_t p0 = moduli[0].prime;
+    const std::uint64_t p1 = moduli[1].prime;
+    const std::uint64_t p2 = moduli[2].prime;
+    const std::uint64_t inverseP0ModP1 = power(p0, p1 - 2, (std::uint32_t) p1);
+    const std::uint64_t inverseP0P1ModP2 = power(p0 * p1 % p2, p2 - 2, (std::uint32_t) p2);
+    const unsigned __int128 product = (unsigned __int128) p0 * (primes > 1 ? p1 : 1) * (primes > 2 ? p2 : 1);
+    for (std::size_t i = 0; i < n + m - 1; i++) {
+        std::uint64_t r0 = residues[0][i];
+        std::uint64_t k1 = 0;
+        std::uint64_t k2 = 0;
+        if (primes > 1) {
+            std::uint64_t r1 = residues[1][i];
+            k1 = (r1 + p1 - r0 % p1) % p1 * inverseP0ModP1 % p1;
+        }
+        if (primes > 2) {
+            std::uint64_t r2 = residues[2][i];
+            std::uint64_t partial = (r0 + p0 * k1) % p2; // r0 + p0 k1 modulo p2.
+            k2 = (r2 + p2 - partial) % p2 * inverseP0P1ModP2 % p2;
+        }
+        unsigned __int128 value = r0 + (unsigned __int128) p0 * (k1 + (unsigned __int128) p1 * k2);
+        __int128 coefficient = value > product / 2 ? -(__int128) (product - value) : (__int128) value;
+        output[i] = {(std::int64_t) (coefficient >> 64), (std::uint64_t) coefficient};
+    }
+    return true;
+#else
+    (void) a, (void) n, (void) b, (void) m, (void) output;
+    return false;
+#endif
+}
+
+void dense::multiply(const double *a, std::size_t n, const double *b, std::size_t m, double *output) {
+    if (std::min(n, m) >= DENSE_KARATSUBA_THRESHOLD) {
+        karatsuba(a, n, b, m, output);
+    } else {
+        schoolbook(a, n, b, m, output);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef FLUXION_DENSEMULTIPLICATION_H
+#define FLUXION_DENSEMULTIPLICATION_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define DENSE_KARATSUBA_THRESHOLD 48 // Shorter operands are multiplied directly.
+#define DENSE_NTT_THRESHOLD 8192 // Integer operands at least this long are transformed rather than multiplied as doubles.
+
+/**
+ * Multiplication of dense univariate polynomials, given as their
+ * coefficients from the constant term up. The product of polynomials
+ * with n and m coefficients has n + m - 1 coefficients.
+ */
+namespace dense {
+    /**
+     * An exact integer coefficient of a product, high 2^64 + low.
+     */
+    struct WideInteger {
+        std::int64_t high;
+        std::uint64_t low;
+    };
+    /**
+     * Multiply every coefficient by every other, O(nm).
+     */
+    void schoolbook(const double *a, std::size_t n, const double *b, std::size_t m, double *output);
+    /**
+     * Split both operands in halves and multiply with three half sized products
+     * rather than four, O(n^1.58).
+     */
+    void karatsuba(const double *a, std::size_t n, const double *b, std::size_t m, double *output);
+    /**
+     * Multiply integers with number theoretic transforms modulo three primes,
+     * which is exact and O(n log n), the product is rebuilt by the chinese
+     * remainder theorem from as few of the primes as its coefficients need.
+     *
+     * @return false if the product could overflow what the primes can
+     * represent, about 3.8e25, output is left untouched.
+     */
+    bool ntt(const std::int64_t *a, std::size_t n, const std::int64_t *b, std::size_t m, WideInteger *output);
+    /**
+     * Multiply with the fastest method on doubles for the sizes.
+     */
+    void multiply(const double *a, std::size_t n, const double *b, std::size_t m, double *output);
+}
+
+#endif //FLUXION_DENSEMULTIPLICATION_H
@@ -0,0 +1,556 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include "EGraph.h"
+
+namespace {
+    const std::uint64_t UNKNOWN_COST = std::numeric_limits<std::uint64_t>::max(); // No term of the e-class was costed yet.
+    const std::uint32_t NO_INDEX = std::numeric_limits<std::uint32_t>::max();
+
+    /**
+     * A way to write a term of a sum as a factor times a remainder.
+     */
+    struct Factoring {
+        std::uint32_t factor; // E-class of the factor.
+        std::uint32_t term; // Position of the term in the sum.
+        std::uint32_t product; // E-node of the product the factor is an operand of.
+        std::uint32_t position; // Of the factor in the product, past its operands if the term is the factor itself.
+    };
+
+    /**
+     * Cost of the term of an e-node whose operands are costed.
+     */
+    struct Candidate {
+        std::uint64_t cost;
+        std::uint32_t unsimplified;
+        hash_t hash;
+        std::uint32_t node;
+        bool operator>(const Candidate &other) const {
+            return cost != other.cost ? cost > other.cost
+                : unsimplified != other.unsimplified ? unsimplified > other.unsimplified
+                : hash != other.hash ? hash > other.hash : node > other.node;
+        }
+    };
+}
+
+bool EGraph::ENode::operator==(const ENode &other) const {
+    return opType == other.opType && leaf == other.leaf && children == other.children;
+}
+
+std::size_t EGraph::ENodeHash::operator()(const ENode &node) const {
+    hash_t hash = node.leaf != nullptr ? node.leaf->_hash : hashValue((std::uint64_t) node.opType);
+    for (std::uint32_t child : node.children) {
+        hash = hashCombine(hash, child);
+    }
+    return (std::size_t) hash;
+}
+
+// The time limit is clamped, so huge limits meaning none do not overflow the clock.
+EGraph::EGraph(std::size_t maxNodes, std::size_t maxIterations, std::uint64_t maxMicroseconds)
+        : maxNodes(maxNodes), maxIterations(maxIterations),
+          deadline(std::chrono::steady_clock::now() + std::chrono::microseconds(std::min(maxMicroseconds, EGRAPH_LONGEST_MICROSECONDS))),
+          expired(false) {
+
+}
+
+std::uint32_t EGraph::find(std::uint32_t eclass) {
+    while (parents[eclass] != eclass) {
+        parents[eclass] = parents[parents[eclass]];
+        eclass = parents[eclass];
+    }
+    return eclass;
+}
+
+bool EGraph::merge(std::uint32_t a, std::uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) {
+        return false;
+    }
+    // The older e-class is kept, so e-classes costed this round stay costed.
+    parents[std::max(a, b)] = std::min(a, b);
+    return true;
+}
+
+void EGraph::canonicalize(ENode &node) {
+    for (std::uint32_t &child : node.children) {
+        child = find(child);
+    }
+    if (Operation::isCommutative(node.opType)) {
+        std::sort(node.children.begin(), node.children.end());
+    }
+}
+
+std::uint32_t EGraph::addNode(ENode node, bool simplified) {
+    canonicalize(node);
+    auto found = memo.find(node);
+    if (found != memo.end()) {
+        this->simplified[found->second] = this->simplified[found->second] || simplified;
+        return find(classes[found->second]);
+    }
+    auto eclass = (std::uint32_t) parents.size();
+    auto index = (std::uint32_t) nodes.size();
+    parents.push_back(eclass);
+    members.emplace_back(1, index);
+    classes.push_back(eclass);
+    live.push_back(true);
+    this->simplified.push_back(simplified);
+    memo.emplace(node, index);
+    nodes.push_back(std::move(node));
+    return eclass;
+}
+
+std::uint32_t EGraph::addOperation(OperationType opType, std::vector<std::uint32_t> children) {
+    if (children.size() == 1) {
+        return find(children[0]); // A sum or a product of a single term is the term.
+    }
+    return addNode(ENode {opType, nullptr, std::move(children)}, false);
+}
+
+std::uint32_t EGraph::add(Expression *expression, bool simplified) {
+    std::unordered_map<Expression*, std::uint32_t> added;
+    std::vector<std::pair<Expression*, bool>> pending {{expression, false}}; // True once the operands were added.
+    std::size_t steps = 0;
+    while (!pending.empty()) {
+        if (++steps % EGRAPH_CLOCK_INTERVAL == 0 && isExpired()) {
+            return EGRAPH_NO_CLASS;
+        }
+        std::pair<Expression*, bool> top = pending.back();
+        pending.pop_back();
+        if (added.count(top.first) != 0) {
+            continue;
+        }
+        if (top.first->type != EXPRESSION_OPERATION) {
+            added.emplace(top.first, addNode(ENode {OP_ERR, top.first, {}}, simplified));
+            continue;
+        }
+        auto operation = (Operation*) top.first;
+        if (!top.second) {
+            pending.emplace_back(top.first, true);
+            for (std::uint32_t i = 0; i < operation->getOperandCount(); i++) {
+                pending.emplace_back(operation->getOperand(i), false);
+            }
+            continue;
+        }
+        std::vector<std::uint32_t> children;
+        for (std::uint32_t i = 0; i < operation->getOperandCount(); i++) {
+            children.push_back(added[operation->getOperand(i)]);
+        }
+        added.emplace(top.first, addNode(ENode {operation->getOperationType(), nullptr, std::move(children)}, simplified));
+    }
+    return find(added[expression]);
+}
+
+void EGraph::rebuild() {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        memo.clear();
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> congruent;
+        for (std::size_t i = 0; i < nodes.size(); i++) {
+            if (i % EGRAPH_CLOCK_INTERVAL == 0 && isExpired()) {
+                return;
+            }
+            if (!live[i]) {
+                continue;
+            }
+            canonicalize(nodes[i]);
+            std::uint32_t eclass = find(classes[i]);
+            auto inserted = memo.emplace(nodes[i], (std::uint32_t) i);
+            if (!inserted.second) {
+                std::uint32_t kept = inserted.first->second;
+                std::uint32_t other = find(classes[kept]);
+                if (other == eclass) {
+                    live[i] = false;
+                    simplified[kept] = simplified[kept] || simplified[i];
+                } else {
+                    congruent.emplace_back(eclass, other); // The same operation over equal operands.
+                }
+            }
+        }
+        for (const std::pair<std::uint32_t, std::uint32_t> &pair : congruent) {
+            merged |= merge(pair.first, pair.second);
+        }
+    }
+    for (std::vector<std::uint32_t> &nodesOfClass : members) {
+        nodesOfClass.clear();
+    }
+    for (std::uint32_t i = 0; i < nodes.size(); i++) {
+        if (live[i]) {
+            members[find(classes[i])].push_back(i);
+        }
+    }
+}
+
+void EGraph::computeCosts() {
+    costs.assign(parents.size(), UNKNOWN_COST);
+    unsimplified.assign(parents.size(), 0);
+    hashes.assign(parents.size(), 0);
+    best.assign(parents.size(), 0);
+    terms.assign(parents.size(), nullptr);
+    // An operation costs more than each of its operands, so the cheapest candidate left is the cheapest term of its e-class.
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    std::vector<std::vector<std::uint32_t>> users(parents.size()); // E-nodes with an operand in each e-class, once per operand.
+    std::vector<std::uint32_t> waiting(nodes.size(), 0); // Operands of each e-node not costed yet.
+    for (std::uint32_t i = 0; i < nodes.size(); i++) {
+        if (!live[i]) {
+            continue;
+        }
+        const ENode &node = nodes[i];
+        if (node.leaf != nullptr) {
+            // Variables cost more than constants, so 2 * a is cheaper than a + a.
+            std::uint64_t cost = node.leaf->type == EXPRESSION_VARIABLE ? 2 : 1;
+            candidates.push(Candidate {cost, simplified[i] ? 0U : 1U, node.leaf->_hash, i});
+            continue;
+        }
+        waiting[i] = (std::uint32_t) node.children.size();
+        for (std::uint32_t child : node.children) {
+            users[find(child)].push_back(i);
+        }
+    }
+    std::vector<hash_t> childHashes;
+    std::size_t steps = 0;
+    while (!candidates.empty()) {
+        if (++steps % EGRAPH_CLOCK_INTERVAL == 0 && isExpired()) {
+            return;
+        }
+        Candidate candidate = candidates.top();
+        candidates.pop();
+        std::uint32_t eclass = find(classes[candidate.node]);
+        if (costs[eclass] != UNKNOWN_COST) {
+            continue;
+        }
+        costs[eclass] = candidate.cost;
+        unsimplified[eclass] = candidate.unsimplified;
+        hashes[eclass] = candidate.hash;
+        best[eclass] = candidate.node;
+        for (std::uint32_t user : users[eclass]) {
+            if (--waiting[user] != 0) {
+                continue;
+            }
+            const ENode &node = nodes[user];
+            std::uint64_t cost = 1;
+            std::uint32_t rough = simplified[user] ? 0 : 1;
+            childHashes.clear();
+            for (std::size_t k = 0; k < node.children.size(); k++) {
+                std::uint32_t child = find(node.children[k]);
+                cost += costs[child];
+                rough += unsimplified[child];
+                if (k > 0 && Operation::isCommutative(node.opType) && child == find(node.children[k - 1])) {
+                    cost += EGRAPH_REPEAT_COST;
+                }
+                childHashes.push_back(hashes[child]);
+            }
+            if (Operation::isCommutative(node.opType)) {
+                std::sort(childHashes.begin(), childHashes.end()); // So the order of the e-classes does not matter.
+            }
+            hash_t hash = hashValue((std::uint64_t) node.opType);
+            for (hash_t childHash : childHashes) {
+                hash = hashCombine(hash, childHash);
+            }
+            candidates.push(Candidate {cost, rough, hash, user});
+        }
+    }
+}
+
+Expression *EGraph::build(std::uint32_t eclass) {
+    eclass = find(eclass);
+    // An operand of the cheapest term costs less than the term, unless e-classes were merged since
+    // they were costed, which can make the term refer to itself.
+    std::vector<std::pair<std::uint32_t, bool>> pending {{eclass, false}}; // True once the operands were built.
+    std::vector<Expression*> operands;
+    while (!pending.empty()) {
+        std::pair<std::uint32_t, bool> top = pending.back();
+        pending.pop_back();
+        if (terms[top.first] != nullptr) {
+            continue;
+        }
+        const ENode &node = nodes[best[top.first]];
+        if (node.leaf != nullptr) {
+            terms[top.first] = node.leaf;
+            continue;
+        }
+        if (!top.second) {
+            pending.emplace_back(top.first, true);
+            for (std::uint32_t child : node.children) {
+                std::uint32_t operand = find(child);
+                if (!isCosted(operand) || costs[operand] >= costs[top.first]) {
+                    return nullptr;
+                }
+                pending.emplace_back(operand, false);
+            }
+            continue;
+        }
+        operands.clear();
+        for (std::uint32_t child : node.children) {
+            operands.push_back(terms[find(child)]);
+        }
+        terms[top.first] = Operation::create(node.opType, operands.data(), operands.size());
+    }
+    return terms[eclass];
+}
+
+Expression *EGraph::extract(std::uint32_t eclass) {
+    if (costs.size() != parents.size()) {
+        rebuild();
+        computeCosts();
+    }
+    return build(eclass);
+}
+
+bool EGraph::refersTo(const ENode &node, std::uint32_t eclass) {
+    for (std::uint32_t child : node.children) {
+        if (find(child) == eclass) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EGraph::isCosted(std::uint32_t eclass) const {
+    return eclass < costs.size() && costs[eclass] != UNKNOWN_COST;
+}
+
+bool EGraph::isConstant(std::uint32_t eclass) const {
+    return isCosted(eclass) && nodes[best[eclass]].leaf != nullptr && nodes[best[eclass]].leaf->type == EXPRESSION_CONSTANT;
+}
+
+bool EGraph::isInfinite(std::uint32_t eclass) const {
+    if (eclass >= members.size()) {
+        return false;
+    }
+    for (std::uint32_t member : members[eclass]) {
+        Expression *leaf = nodes[member].leaf;
+        if (leaf != nullptr && leaf->type == EXPRESSION_CONSTANT && !std::isfinite(((Constant*) leaf)->getValue())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EGraph::simplifyNode(std::uint32_t node) {
+    std::vector<Expression*> operands;
+    for (std::uint32_t child : nodes[node].children) {
+        child = find(child);
+        if (!isCosted(child)) {
+            return false;
+        }
+        operands.push_back(build(child));
+        if (operands.back() == nullptr) {
+            return false;
+        }
+    }
+    Expression *simplified = Operation::create(nodes[node].opType, operands.data(), operands.size())->evaluate();
+    std::uint32_t eclass = add(simplified, true);
+    return eclass != EGRAPH_NO_CLASS && merge(classes[node], eclass);
+}
+
+bool EGraph::flatten(std::uint32_t node) {
+    // (a + b) + c = a + b + c, likewise for *.
+    const ENode flattened = nodes[node];
+    std::uint32_t eclass = find(classes[node]);
+    bool merged = false;
+    for (std::size_t k = 0; k < flattened.children.size(); k++) {
+        std::uint32_t child = find(flattened.children[k]);
+        if (child == eclass || child >= members.size()) {
+            continue;
+        }
+        for (std::size_t j = 0; j < members[child].size(); j++) {
+            const ENode &inner = nodes[members[child][j]];
+            if (inner.opType != flattened.opType || refersTo(inner, child)) {
+                continue;
+            }
+            std::vector<std::uint32_t> children = inner.children;
+            for (std::size_t other = 0; other < flattened.children.size(); other++) {
+                if (other != k) {
+                    children.push_back(flattened.children[other]);
+                }
+            }
+            merged |= merge(eclass, addOperation(flattened.opType, std::move(children)));
+            break;
+        }
+    }
+    return merged;
+}
+
+bool EGraph::distribute(std::uint32_t node) {
+    // a * (b + c) = a * b + a * c.
+    const ENode product = nodes[node];
+    std::uint32_t eclass = find(classes[node]);
+    for (std::uint32_t child : product.children) {
+        if (isInfinite(find(child))) {
+            return false; // inf * (z - 1) is not inf * z - inf, which is nan for z = 1.
+        }
+    }
+    bool merged = false;
+    for (std::size_t k = 0; k < product.children.size(); k++) {
+        std::uint32_t child = find(product.children[k]);
+        if (child == eclass || child >= members.size()) {
+            continue;
+        }
+        for (std::size_t j = 0; j < members[child].size(); j++) {
+            if (nodes[members[child][j]].opType != OP_ADD || refersTo(nodes[members[child][j]], child)) {
+                continue;
+            }
+            const std::vector<std::uint32_t> sum = nodes[members[child][j]].children;
+            std::vector<std::uint32_t> terms;
+            for (std::uint32_t term : sum) {
+                std::vector<std::uint32_t> factors {term};
+                for (std::size_t other = 0; other < product.children.size(); other++) {
+                    if (other != k) {
+                        factors.push_back(product.children[other]);
+                    }
+                }
+                terms.push_back(addOperation(OP_MUL, std::move(factors)));
+            }
+            merged |= merge(eclass, addOperation(OP_ADD, std::move(terms)));
+            break;
+        }
+    }
+    return merged;
+}
+
+bool EGraph::factor(std::uint32_t node) {
+    // a * b + a * c + d = a * (b + c) + d, a term that is the factor itself is a times 1. Only the
+    // cheapest form of each term is factored, and not by constants, or the ways to factor multiply.
+    const ENode sum = nodes[node];
+    std::uint32_t eclass = find(classes[node]);
+    std::vector<Factoring> factorings;
+    for (std::uint32_t k = 0; k < sum.children.size(); k++) {
+        std::uint32_t child = find(sum.children[k]);
+        if (!isCosted(child) || isConstant(child)) {
+            continue;
+        }
+        factorings.push_back({child, k, 0, NO_INDEX});
+        std::uint32_t product = best[child];
+        if (child == eclass || nodes[product].opType != OP_MUL) {
+            continue;
+        }
+        for (std::uint32_t position = 0; position < nodes[product].children.size(); position++) {
+            std::uint32_t factor = find(nodes[product].children[position]);
+            if (!isConstant(factor)) {
+                factorings.push_back({factor, k, product, position});
+            }
+        }
+    }
+    std::sort(factorings.begin(), factorings.end(), [](const Factoring &a, const Factoring &b) {
+        return a.factor != b.factor ? a.factor < b.factor : a.term < b.term;
+    });
+    bool merged = false;
+    std::uint32_t one = NO_INDEX;
+    for (std::size_t first = 0; first < factorings.size();) {
+        std::size_t last = first;
+        std::vector<std::uint32_t> remainders;
+        std::vector<bool> used(sum.children.size(), false);
+        for (; last < factorings.size() && factorings[last].factor == factorings[first].factor; last++) {
+            const Factoring &factoring = factorings[last];
+            if (used[factoring.term]) {
+                continue; // A term is factored a single way.
+            }
+            used[factoring.term] = true;
+            if (factoring.position == NO_INDEX) {
+                if (one == NO_INDEX) {
+                    one = add(Constant::create(1.0), true);
+                }
+                remainders.push_back(one);
+            } else {
+                std::vector<std::uint32_t> rest = nodes[factoring.product].children;
+                rest.erase(rest.begin() + factoring.position);
+                remainders.push_back(addOperation(OP_MUL, std::move(rest)));
+            }
+        }
+        if (remainders.size() > 1) {
+            std::vector<std::uint32_t> terms {addOperation(OP_MUL, {factorings[first].factor, addOperation(OP_ADD, remainders)})};
+            for (std::uint32_t k = 0; k < sum.children.size(); k++) {
+                if (!used[k]) {
+                    terms.push_back(sum.children[k]);
+                }
+            }
+            merged |= merge(eclass, addOperation(OP_ADD, std::move(terms)));
+        }
+        first = last;
+    }
+    return merged;
+}
+
+bool EGraph::unrollPower(std::uint32_t node) {
+    // x ^ 3 = x * x * x, which can then be distributed when x is a sum.
+    std::uint32_t base = nodes[node].children[0];
+    std::uint32_t exponent = find(nodes[node].children[1]);
+    if (exponent >= members.size()) {
+        return false;
+    }
+    for (std::uint32_t member : members[exponent]) {
+        Expression *leaf = nodes[member].leaf;
+        if (leaf == nullptr || leaf->type != EXPRESSION_CONSTANT || !((Constant*) leaf)->getNumber().isInteger()) {
+            continue;
+        }
+        double power = ((Constant*) leaf)->getValue();
+        if (power < 2 || power > EGRAPH_MAX_UNROLLED_POWER) {
+            continue;
+        }
+        return merge(classes[node], addOperation(OP_MUL, std::vector<std::uint32_t>((std::size_t) power, base)));
+    }
+    return false;
+}
+
+bool EGraph::rewrite(std::uint32_t node) {
+    std::size_t count = nodes.size();
+    bool merged = simplifyNode(node);
+    switch (nodes[node].opType) {
+        case OP_ADD:
+            merged |= flatten(node);
+            merged |= factor(node);
+            break;
+        case OP_MUL:
+            merged |= flatten(node);
+            merged |= distribute(node);
+            break;
+        case OP_EXP:
+            merged |= unrollPower(node);
+            break;
+        default:
+            break;
+    }
+    return merged || nodes.size() != count;
+}
+
+SaturationStatus EGraph::saturate() {
+    rebuild();
+    SaturationStatus status = SATURATION_ITERATION_LIMIT;
+    for (std::size_t iteration = 0; iteration < maxIterations && status == SATURATION_ITERATION_LIMIT && !expired; iteration++) {
+        computeCosts();
+        bool changed = false;
+        // E-nodes added by this round are rewritten by the next one.
+        std::uint32_t count = (std::uint32_t) nodes.size();
+        for (std::uint32_t i = 0; i < count && !expired; i++) {
+            if (!live[i] || nodes[i].leaf != nullptr) {
+                continue;
+            }
+            changed |= rewrite(i);
+            if (nodes.size() >= maxNodes) {
+                status = SATURATION_NODE_LIMIT;
+                break;
+            }
+            isExpired();
+        }
+        rebuild();
+        if (!changed && status == SATURATION_ITERATION_LIMIT) {
+            status = SATURATION_REACHED;
+        }
+    }
+    if (!expired) {
+        computeCosts();
+    }
+    return expired ? SATURATION_TIME_LIMIT : status;
+}
+
+bool EGraph::isExpired() {
+    expired = expired || std::chrono::steady_clock::now() > deadline;
+    return expired;
+}
+
+std::size_t EGraph::getNodeCount() const {
+    return nodes.size();
+}
@@ -0,0 +1,161 @@
+#ifndef FLUXION_EGRAPH_H
+#define FLUXION_EGRAPH_H
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Expression.h"
+
+#define EGRAPH_MAX_NODES 20000 // Default limit of e-nodes.
+#define EGRAPH_MAX_ITERATIONS 16 // Default limit of rounds of rewriting.
+#define EGRAPH_MAX_MICROSECONDS 50000 // Default limit of wall time spent saturating.
+#define EGRAPH_LONGEST_MICROSECONDS (std::uint64_t(1) << 50) // About 35 years, longer time limits would overflow the clock.
+#define EGRAPH_MAX_UNROLLED_POWER 4 // Highest integer power also written as a product, so it can be distributed.
+#define EGRAPH_REPEAT_COST (1U << 20) // Extra cost of a repeated operand of + or *, which simplified terms never have.
+#define EGRAPH_CLOCK_INTERVAL 256 // Steps of long loops between looks at the clock.
+#define EGRAPH_NO_CLASS UINT32_MAX // Returned by add once the time limit is reached.
+
+enum SaturationStatus {
+    SATURATION_REACHED, // No rewrite adds anything new.
+    SATURATION_NODE_LIMIT,
+    SATURATION_ITERATION_LIMIT,
+    SATURATION_TIME_LIMIT
+};
+
+/**
+ * An e-graph, a set of e-classes of expressions known to be equal. Each
+ * e-class holds e-nodes, an operation over e-classes or a constant or a
+ * variable, which are hash-consed, so an e-node is in a single e-class.
+ * Merging two e-classes can make operations over them equal, such
+ * e-classes are merged as well when the graph is rebuilt, which is
+ * congruence closure.
+ *
+ * Saturating applies every rewrite to every e-node in rounds, only adding
+ * equalities, so the result does not depend on the order of the rewrites
+ * or on the shape the expression was written in. The rewrites are the
+ * greedy simplifier applied to each e-node, flattening, distributing and
+ * factoring + and *, and writing small integer powers as products. The
+ * cheapest term of an e-class is then extracted, terms cost their number
+ * of nodes with variables counting twice, and simplified terms are
+ * preferred at equal cost. Limits on e-nodes and rounds bound saturating
+ * on expressions whose rewrites never run out, the cheapest term found so
+ * far is extracted then. The time limit counts from the creation of the
+ * graph and bounds adding, rebuilding and costing as well, once it is
+ * reached the graph stops and no term can be extracted.
+ */
+class EGraph {
+private:
+    struct ENode {
+        OperationType opType; // OP_ERR for a constant or a variable.
+        Expression *leaf; // The constant or variable, nullptr for an operation.
+        std::vector<std::uint32_t> children; // E-classes of the operands, sorted for + and *.
+        bool operator==(const ENode &other) const;
+    };
+    struct ENodeHash {
+        std::size_t operator()(const ENode &node) const;
+    };
+    std::vector<ENode> nodes;
+    std::vector<std::uint32_t> classes; // E-class of each e-node when it was added, find gives the current one.
+    std::vector<bool> live; // False for e-nodes found identical to another one when rebuilding.
+    std::vector<bool> simplified; // True for e-nodes of simplified expressions.
+    std::vector<std::uint32_t> parents; // Union-find forest of the e-classes.
+    std::vector<std::vector<std::uint32_t>> members; // Live e-nodes of each e-class, as of the last rebuild.
+    std::unordered_map<ENode, std::uint32_t, ENodeHash> memo; // Index of each e-node.
+    std::vector<std::uint64_t> costs; // Of the cheapest term of each e-class.
+    std::vector<std::uint32_t> unsimplified; // E-nodes of the cheapest term not from a simplified expression, fewer is cheaper at equal cost.
+    std::vector<hash_t> hashes; // Of the cheapest term, orders the terms equal otherwise.
+    std::vector<std::uint32_t> best; // E-node of the cheapest term.
+    std::vector<Expression*> terms; // Built cheapest terms, nullptr until needed.
+    std::size_t maxNodes;
+    std::size_t maxIterations;
+    std::chrono::steady_clock::time_point deadline;
+    bool expired;
+    std::uint32_t find(std::uint32_t eclass);
+    void canonicalize(ENode &node);
+    /**
+     * @return e-class of the e-node, added to a new one if it is not in the graph.
+     */
+    std::uint32_t addNode(ENode node, bool simplified);
+    std::uint32_t addOperation(OperationType opType, std::vector<std::uint32_t> children);
+    /**
+     * Restore congruence after merging, and list the members of each e-class again.
+     */
+    void rebuild();
+    /**
+     * Find the cheapest term of every e-class, in a single pass from the
+     * cheapest e-classes up, each e-node being costed once its operands are.
+     */
+    void computeCosts();
+    /**
+     * @return the cheapest term of an e-class costed by the last computeCosts,
+     * or nullptr if e-classes merged since make it refer to itself.
+     */
+    Expression *build(std::uint32_t eclass);
+    /**
+     * @return true if an operand of the e-node is in the e-class, such as x * 1 in the e-class of x.
+     * Flattening or distributing such e-nodes would add a new one every round.
+     */
+    bool refersTo(const ENode &node, std::uint32_t eclass);
+    /**
+     * @return true if the e-class was costed by the last computeCosts, those added since were not.
+     */
+    bool isCosted(std::uint32_t eclass) const;
+    /**
+     * @return true if the cheapest term of a costed e-class is a constant.
+     */
+    bool isConstant(std::uint32_t eclass) const;
+    /**
+     * @return true if an e-class holds an infinite or nan constant, such products are not distributed.
+     */
+    bool isInfinite(std::uint32_t eclass) const;
+    /**
+     * Apply every rewrite to an e-node.
+     *
+     * @return true if anything was added to the graph or merged.
+     */
+    bool rewrite(std::uint32_t node);
+    bool simplifyNode(std::uint32_t node);
+    bool flatten(std::uint32_t node);
+    bool distribute(std::uint32_t node);
+    bool factor(std::uint32_t node);
+    bool unrollPower(std::uint32_t node);
+public:
+    /**
+     * Add an expression and its subexpressions.
+     *
+     * @param simplified Whether the expression is simplified, such terms are
+     * preferred to others of the same cost when extracting.
+     * @return its e-class, or EGRAPH_NO_CLASS if the time limit was reached.
+     */
+    std::uint32_t add(Expression *expression, bool simplified);
+    /**
+     * Record that two e-classes are equal.
+     *
+     * @return true if they were different.
+     */
+    bool merge(std::uint32_t a, std::uint32_t b);
+    /**
+     * Rewrite until nothing new is found or a limit is reached.
+     *
+     * @return SATURATION_TIME_LIMIT if the time limit was reached, nothing can be extracted then.
+     */
+    SaturationStatus saturate();
+    /**
+     * @return true once the time limit is reached, this is remembered.
+     */
+    bool isExpired();
+    /**
+     * @return the cheapest term of an e-class, created in the current context.
+     */
+    Expression *extract(std::uint32_t eclass);
+    /**
+     * @return number of e-nodes, including those found identical to another one.
+     */
+    std::size_t getNodeCount() const;
+    EGraph(std::size_t maxNodes, std::size_t maxIterations, std::uint64_t maxMicroseconds);
+    EGraph(const EGraph&) = delete;
+    EGraph &operator=(const EGraph&) = delete;
+};
+
+#endif //FLUXION_EGRAPH_H
@@ -1,217 +1,865 @@
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <vector>
 #include "Expression.h"
+#include "Compiler.h"
+#include "Context.h"
+#include "SimplificationCache.h"
+#include "Instrumentation.h"
+#include "OutputSink.h"
+#include "RuleSet.h"
+
+#define SIMPLIFY_LINEAR_GROUPING 8 // Up to this many terms are grouped by scanning rather than hashing.
+#define SIMPLIFY_MAX_DISTRIBUTED_EXPONENT 1024 // Larger integer exponents are left as they are.
+#define PRECEDENCE_ATOM 5 // Numbers and variables, which are never parenthesised.
 
 Expression * Expression::evaluate() {
     return this;
 }
 
 bool Expression::operator==(const Expression &other) const {
-    return this->_hash == other._hash;
+    return this == &other;
 }
 
-std::string Expression::getString() {
-    return std::string();
+Constant::Constant(const Number &number) : number(number), value(number.toDouble()) {
+    this->type = EXPRESSION_CONSTANT;
+    this->size = 1;
+    this->_hash = number.hash();
 }
 
-Constant::Constant(double value) : value(value){
-    this->type = EXPRESSION_CONSTANT;
-    this->_hash = hashValue(value);
+Constant *Constant::create(const Number &number) {
+    return Context::current().nodes.constant(number);
+}
+
+Constant *Constant::create(double value) {
+    return Context::current().nodes.constant(Number::fromDouble(value));
+}
+
+const Number &Constant::getNumber() const {
+    return this->number;
 }
 
 double Constant::getValue() {
     return this->value;
 }
 
-std::string Constant::getString() {
-    return typing::prettyPrintNumber(this->value);
+Variable::Variable(symbol_t symbol) : symbol(symbol), name(&SymbolTable::global().getName(symbol)) {
+    this->type = EXPRESSION_VARIABLE;
+    this->size = 1;
+    this->_hash = hashValue((std::uint64_t) symbol);
+}
+
+Variable *Variable::create(const std::string &name) {
+    return create(StringSlice {name.data(), name.size()});
 }
 
-Variable::Variable(const std::string& name) : name(name) {
-    this->type = EXPRESSION_VARIABLE;
-    this->_hash = hashValue(name);
+Variable *Variable::create(StringSlice name) {
+    return Context::current().nodes.variable(SymbolTable::global().intern(name));
 }
 
-std::string Variable::getVariableName() {
-    return this->name;
+Variable *Variable::create(symbol_t symbol) {
+    return Context::current().nodes.variable(symbol);
 }
 
-std::string Variable::getString() {
-    return this->name;
+symbol_t Variable::getSymbol() const {
+    return this->symbol;
 }
 
-Operation::Operation(Expression *left, Expression *right, OperationType opType) : left(left), right(right), opType(opType) {
+const std::string &Variable::getVariableName() {
+    return *this->name;
+}
+
+Operation::Operation(OperationType opType, Expression **operands, std::uint32_t operandCount)
+    : opType(opType), operandCount(operandCount), operands(operands) {
     this->type = EXPRESSION_OPERATION;
-    // We use a Merkle-Tree like structure for the hashes of operations.
-    if (opType == OP_MUL || opType == OP_ADD) {
-        // Since * and + do not distinguish between position of their arguments, we eliminate the positioning thusly.
-        this->_hash = hashValue(((left->_hash > right->_hash) ? left->_hash + right->_hash : right->_hash + left->_hash) + hashValue(this->opType));
-        // We did this by concatenating bigger one to smaller one rather than preferring left or right.
-    } else { // But -, / and ^ does care about which side which argument is, therefore we don't lose that information.
-        this->_hash = hashValue(left->_hash + right->_hash + hashValue(this->opType));
-        // We prefer adding right to left here.
+    std::uint64_t total = 1;
+    for (std::uint32_t i = 0; i < operandCount; i++) {
+        total += operands[i]->size;
     }
+    this->size = total > UINT32_MAX ? UINT32_MAX : (std::uint32_t) total;
+    this->_hash = computeHash(opType, operands, operandCount);
 }
 
-bool Operation::isOperationFactorable(Operation *leftOp, Operation *rightOp) {
-    return (this->opType != OP_EXP // Since exponentiation isn't distributive.
-            &&(*leftOp->left == *rightOp->left
-            || *leftOp->left == *rightOp->right
-            || *leftOp->right == *rightOp->right
-            || *leftOp->right == *rightOp->left));
+Operation *Operation::create(Expression *left, Expression *right, OperationType opType) {
+    Expression *operands[] = {left, right};
+    return create(opType, operands, 2);
 }
 
-Constant * Operation::reduceConstantExpr(Expression *leftEvaluated, Expression *rightEvaluated) {
-    double newValue = 0;
-    auto *leftC = (Constant*) leftEvaluated; // Casting them.
-    auto *rightC = (Constant*) rightEvaluated; // Casting them.
-    switch (this->opType) {
-        case OP_ADD:
-            newValue = leftC->getValue() + rightC->getValue();
-            break;
-        case OP_MIN:
-            newValue = leftC->getValue() - rightC->getValue();
-            break;
-        case  OP_DIV:
-            newValue = leftC->getValue() / rightC->getValue();
-            break;
-        case OP_MUL:
-            newValue = leftC->getValue() * rightC->getValue();
-            break;
-        case OP_EXP:
-            newValue = pow(leftC->getValue(), rightC->getValue());
-            break;
-        default:
-            newValue = NAN;
-            break;
+Operation *Operation::create(OperationType opType, Expression *const *operands, std::size_t count) {
+    if (!isCommutative(opType)) {
+        return Context::current().nodes.operation(opType, operands, count);
+    }
+    if (count == 2) {
+        Expression *sorted[] = {operands[0], operands[1]};
+        if (compare(sorted[1], sorted[0]) < 0) {
+            std::swap(sorted[0], sorted[1]);
+        }
+        return Context::current().nodes.operation(opType, sorted, 2);
     }
-    auto *newConstant = new Constant(newValue);
-    return newConstant;
+    std::vector<Expression*> sorted(operands, operands + count);
+    std::sort(sorted.begin(), sorted.end(), [](Expression *a, Expression *b) {
+        return compare(a, b) < 0;
+    });
+    return Context::current().nodes.operation(opType, sorted.data(), count);
 }
 
-Expression *Operation::reduceVariableExpr(Variable *leftVar, Variable *rightVar) {
-    switch(this->opType) {
-        case OP_ADD:
-            return new Operation(new Constant(2), new Variable(leftVar->getVariableName()), OP_MUL);
-        case OP_MIN:
-            return new Constant(0);
-        case OP_DIV:
-            return new Constant(1);
-        case OP_MUL:
-            return new Operation(new Variable(leftVar->getVariableName()), new Constant(2), OP_EXP);
-        default:
-            return this;
+hash_t Operation::computeHash(OperationType opType, Expression *const *operands, std::size_t count) {
+    // We use a Merkle-Tree like structure for the hashes of operations, operands of + and *
+    // are sorted before hashing, so the order they were written in does not matter.
+    hash_t hash = hashValue((std::uint64_t) opType);
+    for (std::size_t i = 0; i < count; i++) {
+        hash = hashCombine(hash, operands[i]->_hash);
     }
+    return hash;
 }
 
-Expression *Operation::reduceIdenticalOperationExpr(Operation *leftVar, Operation *rightVar) {
-    switch (this->opType) {
-        case OP_ADD:
-            return new Operation(new Constant(2), leftVar, OP_MUL);
-        case OP_MIN:
-            return new Constant(0);
-        case OP_DIV:
-            return new Constant(1);
-        case OP_MUL:
-            return new Operation(leftVar, new Constant(2), OP_EXP);
-        case OP_EXP:
-            return new Operation(leftVar, rightVar, OP_EXP); // This cannot be reduced further.
-            break;
+bool Operation::isCommutative(OperationType opType) {
+    return opType == OP_MUL || opType == OP_ADD;
+}
+
+OperationType Operation::getOperationType() const {
+    return this->opType;
+}
+
+std::uint32_t Operation::getOperandCount() const {
+    return this->operandCount;
+}
+
+Expression *const *Operation::getOperands() const {
+    return this->operands;
+}
+
+namespace {
+    /**
+     * Compare two distinct nodes by everything but their operands.
+     *
+     * @param byOperands Set to true if both are operations of the same type, so their operands decide.
+     */
+    inline int compareNodes(Expression *a, Expression *b, bool &byOperands) {
+        byOperands = false;
+        if (a->type != b->type) {
+            return a->type < b->type ? -1 : 1;
+        }
+        switch (a->type) {
+            case EXPRESSION_CONSTANT:
+                return Number::compare(((Constant*) a)->getNumber(), ((Constant*) b)->getNumber());
+            case EXPRESSION_VARIABLE:
+                return ((Variable*) a)->getVariableName().compare(((Variable*) b)->getVariableName());
+            default:
+                break;
+        }
+        auto left = (Operation*) a;
+        auto right = (Operation*) b;
+        if (left->getOperationType() != right->getOperationType()) {
+            return left->getOperationType() < right->getOperationType() ? -1 : 1;
+        }
+        byOperands = true;
+        return 0;
+    }
+
+    /**
+     * Two operations of the same type being compared, operand by operand.
+     */
+    struct Comparison {
+        Operation *left;
+        Operation *right;
+        std::uint32_t next; // Index of the next operands to compare.
+    };
+
+    thread_local std::vector<Comparison> comparisons; // Reused by every comparison of the thread.
+
+    /**
+     * Compare two distinct operations of the same type by their operands. Operands that are
+     * operations of the same type themselves are compared on an explicit stack, so deep trees
+     * do not recurse.
+     */
+    int compareOperands(Operation *a, Operation *b) {
+        std::vector<Comparison> &pending = comparisons;
+        pending.clear();
+        pending.push_back({a, b, 0});
+        while (true) {
+            Comparison &comparison = pending.back();
+            Operation *left = comparison.left;
+            Operation *right = comparison.right;
+            if (comparison.next == std::min(left->getOperandCount(), right->getOperandCount())) {
+                // Distinct nodes always differ somewhere, the shorter one comes first if they agree up to its end.
+                return left->getOperandCount() < right->getOperandCount() ? -1 : 1;
+            }
+            Expression *x = left->getOperand(comparison.next);
+            Expression *y = right->getOperand(comparison.next);
+            comparison.next++;
+            if (x == y) {
+                continue;
+            }
+            bool byOperands;
+            int order = compareNodes(x, y, byOperands);
+            if (byOperands) {
+                pending.push_back({(Operation*) x, (Operation*) y, 0});
+            } else if (order != 0) {
+                return order;
+            }
+        }
+    }
+}
+
+int Expression::compare(Expression *a, Expression *b) {
+    if (a == b) {
+        return 0;
     }
+    bool byOperands;
+    int order = compareNodes(a, b, byOperands);
+    return byOperands ? compareOperands((Operation*) a, (Operation*) b) : order;
 }
 
-Operation *Operation::reduceFactorableOperationExpr(Operation *leftOp, Operation *rightOp) {
-    // Determine the different ones and the same ones.
-    Expression* differentLeft;
-    Expression* differentRight;
-    Expression* same;
-    same = (*leftOp->left == *rightOp->left || *leftOp->left == *rightOp->right) ? leftOp->left : leftOp->right;
-    differentLeft = (*same == *leftOp->left) ? leftOp->right : leftOp->left;
-    differentRight = (*same == *rightOp->left) ? rightOp->right : rightOp->left;
-    // Build the multiplicand
-    auto *multiplicand = new Operation(differentLeft, differentRight, this->opType);
-    // We should also evaluate the multiplicand since it may reduce further, in case grandchildren have a
-    // Reducible relationship, ie 5x + 3x = (5 + 3)x = 8x or similar.
-    Expression *multiplicandEvaluated = multiplicand->evaluate();
-    delete multiplicand; // TODO: Check if this causes a memory error.
-    // If the current operation is multiplication or division, than
-    // the multiplier also changes.
-    if (this->opType == OP_MUL) {
-        same = new Operation(same, new Constant(2), OP_EXP);
-    } else if (this->opType == OP_DIV) {
-        same = new Constant(1);
-    }
-    // Now we can construct the new multiplication operation
-    return new Operation(multiplicandEvaluated, same, OP_MUL);
-
-}
-
-void Operation::freeEvaluationPointers(Expression *leftEvaluated, Expression *rightEvaluated) {
-    if (leftEvaluated->type != left->type) {
-        delete leftEvaluated;
-    }
-    if (rightEvaluated->type != right->type) {
-        delete rightEvaluated;
-    }
-}
-
-Expression * Operation::evaluate() {
-    Expression *leftEvaluated = this->left->evaluate();
-    Expression *rightEvaluated = this->right->evaluate();
-    Expression *newExpression = nullptr;
-    // Only time an operation is reduced is when both sides
-    // Evaluate to a numerical constant.
-    if (leftEvaluated->type == rightEvaluated->type) { // If both are of the same type, they can be reduced.
-        if (leftEvaluated->type == EXPRESSION_CONSTANT) {
-            newExpression = reduceConstantExpr(leftEvaluated, rightEvaluated);
-        } else if (leftEvaluated->type == EXPRESSION_VARIABLE)
-        { // Variables, may also be reduced
-            auto leftVar = (Variable *) leftEvaluated;
-            auto rightVar = (Variable *) rightEvaluated;
-            if (leftVar->getVariableName() == rightVar->getVariableName() && this->opType != OP_EXP) { // Here, reduction occurs in these conds.
-                newExpression = reduceVariableExpr(leftVar, rightVar);
-            }
-        } else if (leftEvaluated->type == EXPRESSION_OPERATION) {
-            auto leftOp = (Operation *) leftEvaluated;
-            auto rightOp = (Operation *) rightEvaluated;
-            if (leftEvaluated == rightEvaluated) {
-                return reduceIdenticalOperationExpr(leftOp, rightOp);
-                // We do not want to free the evaluation pointers.
-            } else if (isOperationFactorable(leftOp, rightOp)) {
-                return reduceFactorableOperationExpr(leftOp, rightOp);
-                // Likewise, left and right pointers must be intact here.
+namespace {
+    /**
+     * A term of a sum, weight * expression, or a factor of a product, expression ^ weight.
+     */
+    struct Part {
+        Expression *expression;
+        Number weight;
+    };
+
+    inline bool isOperation(Expression *expression, OperationType opType) {
+        return expression->type == EXPRESSION_OPERATION && ((Operation*) expression)->getOperationType() == opType;
+    }
+
+    inline bool isInteger(const Number &value) {
+        return value.isInteger() && std::fabs(value.toDouble()) <= SIMPLIFY_MAX_DISTRIBUTED_EXPONENT;
+    }
+
+    /**
+     * Merge parts with the same expression by adding their weights, in a
+     * single pass. Expressions are hash-consed, so the node is the key.
+     */
+    void group(std::vector<Part> &parts) {
+        std::size_t kept = 0;
+        if (parts.size() <= SIMPLIFY_LINEAR_GROUPING) {
+            // Scanning a handful of parts is cheaper than hashing them.
+            for (const Part &part : parts) {
+                std::size_t i = 0;
+                while (i < kept && parts[i].expression != part.expression) {
+                    i++;
+                }
+                if (i == kept) {
+                    parts[kept++] = part;
+                } else {
+                    parts[i].weight = parts[i].weight + part.weight;
+                }
+            }
+        } else {
+            // Open addressing on the structural hash, slots hold the index of the group plus one.
+            std::size_t mask = 1;
+            while (mask < parts.size() * 2) {
+                mask <<= 1;
+            }
+            std::vector<std::uint32_t> slots(mask--, 0);
+            for (const Part &part : parts) {
+                std::size_t i = part.expression->_hash & mask;
+                while (slots[i] != 0 && parts[slots[i] - 1].expression != part.expression) {
+                    i = (i + 1) & mask;
+                }
+                if (slots[i] == 0) {
+                    parts[kept] = part;
+                    slots[i] = (std::uint32_t) ++kept;
+                } else {
+                    parts[slots[i] - 1].weight = parts[slots[i] - 1].weight + part.weight;
+                }
+            }
+        }
+        parts.resize(kept);
+    }
+
+    /**
+     * Add a simplified expression as a term of a sum, its constant coefficient
+     * becomes the weight, so 3x and 4x are both terms of x.
+     */
+    void addTerm(Expression *term, const Number &weight, std::vector<Part> &terms, Number &constant) {
+        if (term->type == EXPRESSION_CONSTANT) {
+            constant = constant + weight * ((Constant*) term)->getNumber();
+        } else if (isOperation(term, OP_ADD)) {
+            auto sum = (Operation*) term;
+            for (std::uint32_t i = 0; i < sum->getOperandCount(); i++) {
+                addTerm(sum->getOperand(i), weight, terms, constant);
+            }
+        } else if (isOperation(term, OP_MUL) && ((Operation*) term)->getOperand(0)->type == EXPRESSION_CONSTANT) {
+            // The coefficient is the first factor, since constants are sorted first.
+            auto product = (Operation*) term;
+            const Number &coefficient = ((Constant*) product->getOperand(0))->getNumber();
+            Expression *rest = product->getOperandCount() == 2 ? product->getOperand(1)
+                : Operation::create(OP_MUL, product->getOperands() + 1, product->getOperandCount() - 1);
+            // A negated sum is written -1 * (a + b), its terms are combined with the others.
+            addTerm(rest, weight * coefficient, terms, constant);
+        } else {
+            terms.push_back({term, weight});
+        }
+    }
+
+    /**
+     * Add a simplified expression as a factor of a product, with the given
+     * exponent, its own constant exponent is folded into the weight. A
+     * constant whose power is irrational, such as 2 ^ (1/2), stays a factor.
+     */
+    void addFactor(Expression *factor, const Number &exponent, std::vector<Part> &factors, Number &coefficient) {
+        if (factor->type == EXPRESSION_CONSTANT) {
+            Number value;
+            if (Number::power(((Constant*) factor)->getNumber(), exponent, value)) {
+                coefficient = coefficient * value;
+            } else {
+                factors.push_back({factor, exponent});
+            }
+        } else if (isOperation(factor, OP_MUL) && isInteger(exponent)) {
+            // (ab)^n = a^n b^n only holds for integer n.
+            auto product = (Operation*) factor;
+            for (std::uint32_t i = 0; i < product->getOperandCount(); i++) {
+                addFactor(product->getOperand(i), exponent, factors, coefficient);
+            }
+        } else if (isOperation(factor, OP_EXP) && ((Operation*) factor)->getOperand(1)->type == EXPRESSION_CONSTANT
+                   && isInteger(exponent)) {
+            auto power = (Operation*) factor;
+            factors.push_back({power->getOperand(0), exponent * ((Constant*) power->getOperand(1))->getNumber()});
+        } else {
+            factors.push_back({factor, exponent});
+        }
+    }
+
+    Expression *buildSum(std::vector<Part> &terms, const Number &constant) {
+        group(terms);
+        std::vector<Expression*> operands;
+        operands.reserve(terms.size() + 1);
+        for (const Part &term : terms) {
+            if (term.weight.isZero()) {
+                continue; // Cancelled out.
+            }
+            if (term.weight.isOne() && isOperation(term.expression, OP_ADD)) {
+                // Keep the sum flat.
+                auto sum = (Operation*) term.expression;
+                operands.insert(operands.end(), sum->getOperands(), sum->getOperands() + sum->getOperandCount());
+            } else if (term.weight.isOne()) {
+                operands.push_back(term.expression);
+            } else if (isOperation(term.expression, OP_MUL)) {
+                // Put the coefficient back in front of the other factors, keeping the product flat.
+                auto product = (Operation*) term.expression;
+                std::vector<Expression*> factors {Constant::create(term.weight)};
+                factors.insert(factors.end(), product->getOperands(), product->getOperands() + product->getOperandCount());
+                operands.push_back(Operation::create(OP_MUL, factors.data(), factors.size()));
+            } else {
+                operands.push_back(Operation::create(Constant::create(term.weight), term.expression, OP_MUL));
+            }
+        }
+        if (!constant.isZero() || operands.empty()) {
+            operands.push_back(Constant::create(constant));
+        }
+        if (operands.size() == 1) {
+            return operands[0];
+        }
+        return Operation::create(OP_ADD, operands.data(), operands.size());
+    }
+
+    Expression *buildProduct(std::vector<Part> &factors, Number coefficient) {
+        if (coefficient.isZero()) {
+            return Constant::create(0);
+        }
+        group(factors);
+        // Irrational powers of a constant may have combined into a rational one, 2 ^ (1/2) * 2 ^ (1/2) = 2.
+        for (Part &factor : factors) {
+            Number power;
+            if (factor.expression->type == EXPRESSION_CONSTANT
+                && Number::power(((Constant*) factor.expression)->getNumber(), factor.weight, power)) {
+                coefficient = coefficient * power;
+                factor.weight = Number::integer(0);
+            }
+        }
+        std::vector<Expression*> operands;
+        operands.reserve(factors.size() + 1);
+        if (!coefficient.isOne()) {
+            operands.push_back(Constant::create(coefficient));
+        }
+        for (const Part &factor : factors) {
+            if (factor.weight.isZero()) {
+                continue; // x / x = 1.
+            }
+            if (factor.weight.isOne()) {
+                operands.push_back(factor.expression);
             } else {
-                return new Operation(leftEvaluated, rightEvaluated, this->opType);
+                operands.push_back(Operation::create(factor.expression, Constant::create(factor.weight), OP_EXP));
+            }
+        }
+        if (operands.empty()) {
+            return Constant::create(coefficient);
+        }
+        if (operands.size() == 1) {
+            return operands[0];
+        }
+        return Operation::create(OP_MUL, operands.data(), operands.size());
+    }
+}
+
+Expression *Operation::simplifySum() {
+    std::vector<Part> terms;
+    Number constant = Number::integer(0);
+    // Walk the chain of + and - without recursion, only the terms are simplified on their own,
+    // so a long sum is collected once rather than once per operator.
+    std::vector<Part> pending {{this, Number::integer(1)}};
+    while (!pending.empty()) {
+        Part part = pending.back();
+        pending.pop_back();
+        if (isOperation(part.expression, OP_ADD)) {
+            auto sum = (Operation*) part.expression;
+            for (std::uint32_t i = sum->getOperandCount(); i-- > 0;) {
+                pending.push_back({sum->getOperand(i), part.weight});
+            }
+        } else if (isOperation(part.expression, OP_MIN)) {
+            auto difference = (Operation*) part.expression;
+            pending.push_back({difference->getOperand(1), -part.weight});
+            pending.push_back({difference->getOperand(0), part.weight});
+        } else {
+            addTerm(part.expression->evaluate(), part.weight, terms, constant);
+        }
+    }
+    return buildSum(terms, constant);
+}
+
+Expression *Operation::simplifyProduct() {
+    std::vector<Part> factors;
+    Number coefficient = Number::integer(1);
+    std::vector<Part> pending {{this, Number::integer(1)}};
+    while (!pending.empty()) {
+        Part part = pending.back();
+        pending.pop_back();
+        if (isOperation(part.expression, OP_MUL)) {
+            auto product = (Operation*) part.expression;
+            for (std::uint32_t i = product->getOperandCount(); i-- > 0;) {
+                pending.push_back({product->getOperand(i), part.weight});
             }
+        } else if (isOperation(part.expression, OP_DIV)) {
+            auto quotient = (Operation*) part.expression;
+            pending.push_back({quotient->getOperand(1), -part.weight});
+            pending.push_back({quotient->getOperand(0), part.weight});
+        } else {
+            addFactor(part.expression->evaluate(), part.weight, factors, coefficient);
+        }
+    }
+    return buildProduct(factors, coefficient);
+}
+
+Expression *Operation::simplifyPower() {
+    Expression *base = this->operands[0]->evaluate();
+    Expression *exponent = this->operands[1]->evaluate();
+    if (base->type != EXPRESSION_CONSTANT && exponent->type == EXPRESSION_CONSTANT) {
+        const Number &value = ((Constant*) exponent)->getNumber();
+        if (!value.isZero() && !value.isOne() && isInteger(value)) {
+            // Integer powers of products and powers are distributed, so they combine with other factors.
+            std::vector<Part> factors;
+            Number coefficient = Number::integer(1);
+            addFactor(base, value, factors, coefficient);
+            return buildProduct(factors, coefficient);
         }
-        freeEvaluationPointers(leftEvaluated, rightEvaluated);
-    } else {// Otherwise,  Return type will still be a operation, but one of the left or right sides might have reduced.
-        newExpression = new Operation(leftEvaluated, rightEvaluated, this->opType);
     }
-    return newExpression;
+    // Powers of constants, 1 ^ x, x ^ 0 and x ^ 1 are reduced by the rules.
+    return Operation::create(base, exponent, OP_EXP);
 }
 
-std::string Operation::getString() {
-    std::string operatorString;
+namespace {
+    /**
+     * An operation waiting to be simplified, once the operations it depends on are.
+     */
+    struct Visit {
+        Operation *operation;
+        bool expanded; // Its dependencies were pushed.
+    };
+
+    thread_local std::vector<Visit> visits; // Shared by nested calls, each one works above the visits of its caller.
+    thread_local std::vector<Operation*> chain; // Inner nodes of the chain being walked.
+
+    /**
+     * Push the operations the simplification of an operation evaluates, that is the
+     * terms of a chain of + and -, the factors of a chain of * and /, or both operands
+     * of ^. The chains themselves are walked the way simplifying them walks them, so
+     * their inner nodes are not simplified on their own.
+     */
+    void pushDependencies(Operation *operation, std::vector<Visit> &pending) {
+        OperationType opType = operation->getOperationType();
+        if (opType == OP_EXP) {
+            for (std::uint32_t i = operation->getOperandCount(); i-- > 0;) {
+                if (operation->getOperand(i)->type == EXPRESSION_OPERATION) {
+                    pending.push_back({(Operation*) operation->getOperand(i), false});
+                }
+            }
+            return;
+        }
+        bool sum = opType == OP_ADD || opType == OP_MIN;
+        if (!sum && opType != OP_MUL && opType != OP_DIV) {
+            return;
+        }
+        std::vector<Operation*> &links = chain;
+        links.assign(1, operation);
+        while (!links.empty()) {
+            Operation *link = links.back();
+            links.pop_back();
+            for (std::uint32_t i = link->getOperandCount(); i-- > 0;) {
+                Expression *operand = link->getOperand(i);
+                if (operand->type != EXPRESSION_OPERATION) {
+                    continue;
+                }
+                OperationType operandType = ((Operation*) operand)->getOperationType();
+                if (sum ? operandType == OP_ADD || operandType == OP_MIN : operandType == OP_MUL || operandType == OP_DIV) {
+                    links.push_back((Operation*) operand);
+                } else {
+                    pending.push_back({(Operation*) operand, false});
+                }
+            }
+        }
+    }
+}
+
+Expression *Operation::evaluate() {
+    Instrumentation::Scope scope {PHASE_EVALUATE};
+    Context &context = Context::current();
+    if (context.rewriting && context.ruleGeneration != RuleSet::global().getGeneration()) {
+        // Memoised results were simplified with other rules.
+        context.simplified.clear();
+        context.ruleGeneration = RuleSet::global().getGeneration();
+    }
+    // Shared subtrees are simplified once per context.
+    MemoTable &simplified = context.simplified;
+    Expression *known = simplified.find(this);
+    if (known != nullptr) {
+        return known;
+    }
+    std::vector<Visit> &pending = visits;
+    std::size_t base = pending.size();
+    // Only whole expressions simplified by an outermost call are cached, looking up flattens
+    // the expression, which would make caching every subtree quadratic in its depth.
+    SimplificationCache &cache = SimplificationCache::global();
+    bool cached = context.rewriting && base == 0 && cache.accepts(this); // Cached results have the rules applied.
+    Expression *last = cached ? cache.lookup(this) : nullptr; // The root is simplified last.
+    if (last != nullptr) {
+        simplified.set(this, last);
+        simplified.emplace(last, last);
+        return last;
+    }
+    // Dependencies are simplified before the operations using them, from an explicit stack rather
+    // than by recursion, so the native stack stays flat at any depth and simplifying an operation
+    // only finds its operands memoised.
+    std::size_t deepest = 0;
+    pending.push_back({this, false});
+    while (pending.size() > base) {
+        deepest = std::max(deepest, pending.size() - base);
+        Visit &visit = pending.back();
+        Operation *operation = visit.operation;
+        if (simplified.find(operation) != nullptr) {
+            pending.pop_back(); // Shared with an operation simplified in the meantime.
+            continue;
+        }
+        if (!visit.expanded) {
+            visit.expanded = true;
+            pushDependencies(operation, pending);
+            continue;
+        }
+        pending.pop_back();
+        Expression *result = operation->simplify();
+        simplified.set(operation, result);
+        simplified.emplace(result, result); // Simplified expressions are already as simple as they get.
+        last = result;
+    }
+    if (cached) {
+        cache.insert(this, last);
+    }
+    Instrumentation::reportDepth(PHASE_EVALUATE, deepest);
+    return last;
+}
+
+Expression *Operation::simplify() {
+    Expression *result;
     switch (this->opType) {
         case OP_ADD:
-            operatorString = "+";
-            break;
         case OP_MIN:
-            operatorString = "-";
-            break;
-        case OP_DIV:
-            operatorString = "/";
+            result = simplifySum();
             break;
         case OP_MUL:
-            operatorString = "*";
+        case OP_DIV:
+            result = simplifyProduct();
             break;
         case OP_EXP:
-            operatorString = "^";
-            break;
-        case OP_ERR:
-            operatorString = "!";
+            result = simplifyPower();
             break;
+        default:
+            return this;
+    }
+    return Context::current().rewriting ? RuleSet::global().rewrite(result) : result;
+}
+
+namespace {
+    enum PieceType {
+        PIECE_EXPRESSION,
+        PIECE_TEXT,
+        PIECE_NUMBER
+    };
+
+    /**
+     * Part of the printed form of an expression, still to be printed.
+     */
+    struct Piece {
+        PieceType type;
+        union {
+            Expression *expression;
+            const char *text;
+            Number number;
+        };
+    };
+
+    thread_local std::vector<Piece> unprinted; // Shared by nested calls, the next piece to print is last.
+    thread_local std::vector<Piece> sequence; // Pieces of a single operation, in order.
+    thread_local std::vector<std::uint8_t> termOrder; // Pass in which each term of a sum is printed.
+
+    inline void pushExpression(Expression *expression, std::vector<Piece> &pieces) {
+        Piece piece {PIECE_EXPRESSION, {}};
+        piece.expression = expression;
+        pieces.push_back(piece);
+    }
+
+    inline void pushText(const char *text, std::vector<Piece> &pieces) {
+        Piece piece {PIECE_TEXT, {}};
+        piece.text = text;
+        pieces.push_back(piece);
+    }
+
+    inline void pushNumber(const Number &number, std::vector<Piece> &pieces) {
+        Piece piece {PIECE_NUMBER, {}};
+        piece.number = number;
+        pieces.push_back(piece);
+    }
+
+    /**
+     * @return precedence of the printed expression, as the compiler would read it back.
+     */
+    int precedenceOf(Expression *expression) {
+        switch (expression->type) {
+            case EXPRESSION_CONSTANT: {
+                // Negative numbers read as a negation, so -2 ^ x needs parentheses, and quotients as a
+                // division, so (1/3) ^ x does.
+                const Number &number = ((Constant*) expression)->getNumber();
+                if (number.isPrintedAsQuotient()) {
+                    return Compiler::getPrecedence(OP_DIV);
+                }
+                return number.sign() < 0 ? PRECEDENCE_NEGATION : PRECEDENCE_ATOM;
+            }
+            case EXPRESSION_VARIABLE:
+                return PRECEDENCE_ATOM;
+            default:
+                return Compiler::getPrecedence(((Operation*) expression)->getOperationType());
+        }
     }
-    return "(" + left->getString() + " " + operatorString + " " + right->getString() + ")";
-}
\ No newline at end of file
+
+    /**
+     * Print an operand, in parentheses only if it binds looser than its place needs.
+     *
+     * @param precedence Lowest precedence the operand may have without parentheses.
+     */
+    void pushOperand(Expression *operand, int precedence, std::vector<Piece> &pieces) {
+        if (precedenceOf(operand) >= precedence) {
+            pushExpression(operand, pieces);
+            return;
+        }
+        pushText("(", pieces);
+        pushExpression(operand, pieces);
+        pushText(")", pieces);
+    }
+
+    /**
+     * @return true for a factor with a negative constant exponent, which is printed as a divisor.
+     */
+    bool isDivisor(Expression *factor) {
+        return isOperation(factor, OP_EXP) && ((Operation*) factor)->getOperand(1)->type == EXPRESSION_CONSTANT
+            && ((Constant*) ((Operation*) factor)->getOperand(1))->getNumber().sign() < 0;
+    }
+
+    /**
+     * Print a product, factors with a negative constant exponent are printed
+     * as divisors, so x * y ^ -1 is printed as x / y.
+     *
+     * @param coefficient Printed first, unless it is 1, a coefficient of -1 is printed as a minus.
+     */
+    void pushProduct(const Number &coefficient, Expression *const *factors, std::size_t count, std::vector<Piece> &pieces) {
+        // Products are associative, so factors that are products themselves need no parentheses.
+        int precedence = Compiler::getPrecedence(OP_MUL);
+        Expression *leading = nullptr;
+        for (std::size_t i = 0; i < count && leading == nullptr; i++) {
+            leading = isDivisor(factors[i]) ? nullptr : factors[i];
+        }
+        bool first = true;
+        if (coefficient.sign() < 0 && (-coefficient).isOne() && leading != nullptr && leading->type != EXPRESSION_CONSTANT) {
+            pushText("-", pieces);
+        } else if (!coefficient.isOne() || leading == nullptr) {
+            pushNumber(coefficient, pieces);
+            first = false;
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            if (!isDivisor(factors[i])) {
+                if (!first) {
+                    pushText(" * ", pieces);
+                }
+                pushOperand(factors[i], precedence, pieces);
+                first = false;
+            }
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            if (isDivisor(factors[i])) {
+                auto power = (Operation*) factors[i];
+                Number exponent = -((Constant*) power->getOperand(1))->getNumber();
+                pushText(" / ", pieces);
+                if (exponent.isOne()) {
+                    pushOperand(power->getOperand(0), precedence + 1, pieces);
+                } else {
+                    pushOperand(power->getOperand(0), Compiler::getPrecedence(OP_EXP) + 1, pieces);
+                    pushText(exponent.isPrintedAsQuotient() ? " ^ (" : " ^ ", pieces);
+                    pushNumber(exponent, pieces);
+                    if (exponent.isPrintedAsQuotient()) {
+                        pushText(")", pieces);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @return the coefficient of a term of a sum, 1 if it has none.
+     */
+    Number coefficientOf(Expression *term) {
+        if (term->type == EXPRESSION_CONSTANT) {
+            return ((Constant*) term)->getNumber();
+        }
+        if (isOperation(term, OP_MUL) && ((Operation*) term)->getOperand(0)->type == EXPRESSION_CONSTANT) {
+            return ((Constant*) ((Operation*) term)->getOperand(0))->getNumber();
+        }
+        return Number::integer(1);
+    }
+
+    /**
+     * Print a term of a sum, negative terms are subtracted rather than added.
+     */
+    void pushTerm(Expression *term, bool first, std::vector<Piece> &pieces) {
+        if (coefficientOf(term).sign() >= 0) {
+            if (!first) {
+                pushText(" + ", pieces);
+            }
+            // Sums are associative, so terms that are sums themselves need no parentheses.
+            pushOperand(term, Compiler::getPrecedence(OP_ADD), pieces);
+            return;
+        }
+        pushText(first ? "-" : " - ", pieces);
+        if (term->type == EXPRESSION_CONSTANT) {
+            pushNumber(-((Constant*) term)->getNumber(), pieces);
+            return;
+        }
+        auto product = (Operation*) term;
+        pushProduct(-coefficientOf(term), product->getOperands() + 1, product->getOperandCount() - 1, pieces);
+    }
+
+    /**
+     * Print an operation, in terms of its operands.
+     */
+    void pushOperation(Operation *operation, std::vector<Piece> &pieces) {
+        std::uint32_t count = operation->getOperandCount();
+        Expression *const *operands = operation->getOperands();
+        OperationType opType = operation->getOperationType();
+        const char *operatorString;
+        switch (opType) {
+            case OP_ADD: {
+                // Added terms go before subtracted ones and constants last, so it reads x - y + 1 - 2.
+                // Terms are classified once, so long sums are not read from memory on every pass.
+                std::vector<std::uint8_t> &order = termOrder;
+                order.resize(count);
+                for (std::uint32_t i = 0; i < count; i++) {
+                    order[i] = (std::uint8_t) ((coefficientOf(operands[i]).sign() < 0 ? 2 : 0) + (operands[i]->type == EXPRESSION_CONSTANT ? 1 : 0));
+                }
+                bool first = true;
+                for (std::uint8_t pass = 0; pass < 4; pass++) {
+                    for (std::uint32_t i = 0; i < count; i++) {
+                        if (order[i] == pass) {
+                            pushTerm(operands[i], first, pieces);
+                            first = false;
+                        }
+                    }
+                }
+                return;
+            }
+            case OP_MUL:
+                if (operands[0]->type == EXPRESSION_CONSTANT) {
+                    pushProduct(((Constant*) operands[0])->getNumber(), operands + 1, count - 1, pieces);
+                } else {
+                    pushProduct(Number::integer(1), operands, count, pieces);
+                }
+                return;
+            case OP_MIN:
+                operatorString = " - ";
+                break;
+            case OP_DIV:
+                operatorString = " / ";
+                break;
+            case OP_EXP:
+                operatorString = " ^ ";
+                break;
+            default:
+                operatorString = " ! ";
+                break;
+        }
+        // Left associative operators need a tighter operand on their right, so a - (b - c) keeps
+        // its parentheses, and right associative ones on their left, so (a ^ b) ^ c keeps them.
+        int precedence = Compiler::getPrecedence(opType);
+        bool rightAssociative = Compiler::isRightAssociative(opType);
+        pushOperand(operands[0], rightAssociative ? precedence + 1 : precedence, pieces);
+        pushText(operatorString, pieces);
+        if (operands[1]->type == EXPRESSION_CONSTANT && !((Constant*) operands[1])->getNumber().isPrintedAsQuotient()) {
+            pushExpression(operands[1], pieces); // Nothing after a number can split it, so x ^ -1 reads back as it is.
+        } else {
+            pushOperand(operands[1], rightAssociative ? precedence : precedence + 1, pieces);
+        }
+    }
+}
+
+void Expression::write(OutputSink &sink) {
+    Instrumentation::Scope scope {PHASE_GET_STRING};
+    // Operations are expanded into pieces on an explicit stack rather than printed by recursion,
+    // and every piece goes straight to the sink, so deep trees are printed in linear time.
+    std::vector<Piece> &pending = unprinted;
+    std::vector<Piece> &operationPieces = sequence;
+    std::size_t base = pending.size();
+    std::size_t deepest = 0;
+    pushExpression(this, pending);
+    while (pending.size() > base) {
+        deepest = std::max(deepest, pending.size() - base);
+        Piece piece = pending.back();
+        pending.pop_back();
+        switch (piece.type) {
+            case PIECE_TEXT:
+                sink.write(piece.text);
+                break;
+            case PIECE_NUMBER:
+                piece.number.write(sink);
+                break;
+            case PIECE_EXPRESSION:
+                if (piece.expression->type == EXPRESSION_CONSTANT) {
+                    ((Constant*) piece.expression)->getNumber().write(sink);
+                } else if (piece.expression->type == EXPRESSION_VARIABLE) {
+                    const std::string &name = ((Variable*) piece.expression)->getVariableName();
+                    sink.write(name.data(), name.size());
+                } else {
+                    operationPieces.clear();
+                    pushOperation((Operation*) piece.expression, operationPieces);
+                    pending.insert(pending.end(), operationPieces.rbegin(), operationPieces.rend());
+                }
+                break;
+        }
+    }
+    Instrumentation::reportDepth(PHASE_GET_STRING, deepest);
+}
+
+std::string Expression::getString() {
+    std::string result;
+    StringSink sink {result};
+    this->write(sink);
+    return result;
+}
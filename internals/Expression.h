@@ -2,8 +2,12 @@
 #define FLUXION_EXPRESSION_H
 #include <string>
 #include <cmath>
+#include "Number.h"
+#include "SymbolTable.h"
 #include "util.h"
 
+class OutputSink;
+
 enum ExpressionType {
     EXPRESSION_CONSTANT,
     EXPRESSION_VARIABLE,
@@ -21,110 +25,145 @@ enum OperationType {
 
 /**
  * Represents a general symbol
+ *
+ * Expressions are immutable and hash-consed, they are only created
+ * through the create functions of the subclasses, which return the
+ * existing node if a structurally identical one was already created.
  */
 class Expression {
 public:
-    std::string _hash;
+    hash_t _hash; // Structural hash, identical subtrees have identical hashes.
     ExpressionType type;
+    std::uint32_t size; // Number of nodes in the tree, counting shared nodes each time, saturates.
 
     virtual Expression *evaluate();
+    /**
+     * Since expressions are hash-consed, two expressions are
+     * structurally equal if and only if they are the same node.
+     */
     bool operator== (const Expression& other) const;
-    virtual std::string getString();
+    /**
+     * Print the expression, with parentheses only where precedence needs
+     * them, so it reads back as the same expression. Operations are printed
+     * from an explicit stack and text goes straight to the sink, so any
+     * depth is fine and the only allocations are made by the sink.
+     */
+    void write(OutputSink &sink);
+    /**
+     * @return the printed expression.
+     */
+    std::string getString();
+    /**
+     * Total order of expressions, constants come first ordered by value,
+     * then variables by name, then operations compared operand by operand.
+     *
+     * @return negative if a comes first, 0 if they are the same node, positive otherwise.
+     */
+    static int compare(Expression *a, Expression *b);
 };
 
 
 /**
- * This represents constants, a number literal.
+ * This represents constants, a number literal. Constants are exact
+ * rationals unless they come from a double.
  */
 class Constant : public Expression {
-    double value; // If it has numerical value, if not NaN.
+    friend class Arena;
+    Number number;
+    double value; // The closest double, for numerical evaluation.
+    explicit Constant(const Number &number);
 public:
-    explicit Constant(double value);
+    static Constant *create(const Number &number);
+    /**
+     * @return value as a constant, exact if it is an integer.
+     */
+    static Constant *create(double value);
+    const Number &getNumber() const;
     double getValue();
-    std::string getString() override;
 };
 
 
 /**
- * Represents a symbolic variable.
+ * Represents a symbolic variable, named by an interned symbol.
  */
 class Variable : public Expression {
-    std::string name;
+    friend class Arena;
+    symbol_t symbol;
+    const std::string *name; // Owned by the symbol table.
+    explicit Variable(symbol_t symbol);
 public:
-    explicit Variable(const std::string& name);
-    std::string getVariableName();
-    std::string getString() override;
+    static Variable *create(const std::string& name);
+    static Variable *create(StringSlice name);
+    static Variable *create(symbol_t symbol);
+    symbol_t getSymbol() const;
+    const std::string& getVariableName();
 };
 
 /**
  * Represents an operation.
+ *
+ * Addition and multiplication take any number of operands, kept
+ * sorted by Expression::compare, so a + b and b + a are the same node
+ * and simplified sums and products are flat. The other operations
+ * always have two operands.
  */
 class Operation : public Expression {
 private:
     OperationType opType;
+    std::uint32_t operandCount;
+    Expression **operands; // Allocated from the same arena as the operation.
     /**
-     * If the subnodes of left and right is ordered in a
-     * specific way, such that the left and right are Operation
-     * Expressions, and they have a child that evaluate to the
-     * same Expression, an Operation Expression can be Factored
-     * into another Operation Expression.
-     *
-     * @return true if two grandchildren from different parents
-     * evaluate to the same.
+     * Simplify a chain of + and -, every term is collected in a single
+     * pass and like terms are combined, so 3x + y - x = 2x + y.
      */
-    bool isOperationFactorable(Operation *leftOp, Operation *rightOp);
+    Expression *simplifySum();
     /**
-     * If both left and right evaluations return constants, the
-     * operation can be reduced.
-     *
-     * @param leftEvaluated Evaluated expression on the left.
-     * @param rightEvaluated Evaluated expression on the right.
-     * @return A constant expression.
+     * Simplify a chain of * and /, repeated factors are combined into
+     * powers and constants are multiplied, so 2x * y / x = 2y.
      */
-    Constant *reduceConstantExpr(Expression *leftEvaluated, Expression *rightEvaluated);
+    Expression *simplifyProduct();
     /**
-     * If both left and right evaluates to variables of the same type,
-     * the expression may be reduced to constants (a/a = 1, a-a = 0) or Operation
-     * Expression (a + a = 2 * a), (a*a = a^2) or itself (a^a = a^a).
-     *
-     * @param leftVar Left variable expression.
-     * @param rightVar Right variable expression.
-     * @return (possibly) reduced expression.
+     * Simplify the operands of ^, distributing integer powers over products.
      */
-    Expression *reduceVariableExpr(Variable *leftVar, Variable *rightVar);
+    Expression *simplifyPower();
     /**
-     * If both left and right operations are identical than the expresion may be
-     * reduced further trivially. ie: (a - b) - (a -b) can be reduced to 0.
+     * Simplify the operation, without consulting any cache, then apply
+     * the rewrite rules to the result.
      *
-     * @param leftOp Left operation
-     * @param rightOp right operation
-     * @return new expression.
+     * @return the simplified expression.
      */
-    Expression *reduceIdenticalOperationExpr(Operation *leftOp, Operation *rightOp);
+    Expression *simplify();
+    Operation(OperationType opType, Expression **operands, std::uint32_t operandCount);
+    friend class Arena;
+public:
+    static Operation *create(Expression *left, Expression *right, OperationType opType);
     /**
-     * If both sides of the operation are operations and if they share a common denominator,
-     * than they can be factored in, for instance 3(a - b) + 4(a - b) can easily be turned to
-     * 7(a - b) or 4a * 3a = 12 * a ^ 2.
-     *
-     * @param leftOp Left operation
-     * @param rightOp
-     * @return
+     * Create an operation over two or more operands, only + and * may
+     * have more than two. Operands of + and * are sorted, so their order
+     * does not matter.
      */
-    Operation *reduceFactorableOperationExpr(Operation *leftOp, Operation *rightOp);
+    static Operation *create(OperationType opType, Expression *const *operands, std::size_t count);
     /**
-     * If evaluated expression pointers are *created* during evaluation
-     * and not actually references to the existing objects, free them.
+     * Compute the structural hash an operation with given operands
+     * would have, without creating it, the operands must be in order.
+     */
+    static hash_t computeHash(OperationType opType, Expression *const *operands, std::size_t count);
+    /**
+     * @return true if the order of the arguments does not matter.
+     */
+    static bool isCommutative(OperationType opType);
+    OperationType getOperationType() const;
+    std::uint32_t getOperandCount() const;
+    Expression *const *getOperands() const;
+    inline Expression *getOperand(std::size_t index) const {return operands[index];}
+    /**
+     * Simplify the operation, results are memoised per context and
+     * shared across calls through the simplification cache. Operands
+     * are simplified from an explicit stack, so any depth is fine.
      *
-     * @param leftEvaluated Left evaluated.
-     * @param rightEvaluated Right Evaluated.
+     * @return the simplified expression.
      */
-    void freeEvaluationPointers(Expression *leftEvaluated, Expression *rightEvaluated);
-public:
-    Operation(Expression *left, Expression *right, OperationType opType);
     Expression *evaluate() override;
-    Expression *left;
-    Expression *right;
-    std::string getString() override;
 };
 
 #endif //FLUXION_EXPRESSION_H
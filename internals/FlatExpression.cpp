@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstring>
+#include "FlatExpression.h"
+
+#define FLAT_UNRECORDED UINT32_MAX // Index of nodes not recorded yet.
+#define FLAT_MAX_RESERVED 4096 // Most nodes reserved up front, larger expressions grow their arrays.
+
+namespace {
+    /**
+     * Index of every recorded node, open addressing by the hash of the node.
+     */
+    class NodeIndices {
+    private:
+        std::vector<Expression*> nodes; // Size is always a power of two.
+        std::vector<std::uint32_t> indices;
+        std::size_t count;
+        std::size_t probe(Expression *node) const {
+            std::size_t mask = nodes.size() - 1;
+            std::size_t i = node->_hash & mask;
+            while (nodes[i] != nullptr && nodes[i] != node) {
+                i = (i + 1) & mask;
+            }
+            return i;
+        }
+    public:
+        std::uint32_t find(Expression *node) const {
+            std::size_t i = probe(node);
+            return nodes[i] == nullptr ? FLAT_UNRECORDED : indices[i];
+        }
+        void insert(Expression *node, std::uint32_t index) {
+            // Keep the load factor under a half, so probe sequences stay short.
+            if (++count * 2 > nodes.size()) {
+                std::vector<Expression*> oldNodes(nodes.size() * 2, nullptr);
+                std::vector<std::uint32_t> oldIndices(indices.size() * 2);
+                oldNodes.swap(nodes);
+                oldIndices.swap(indices);
+                for (std::size_t i = 0; i < oldNodes.size(); i++) {
+                    if (oldNodes[i] != nullptr) {
+                        std::size_t slot = probe(oldNodes[i]);
+                        nodes[slot] = oldNodes[i];
+                        indices[slot] = oldIndices[i];
+                    }
+                }
+            }
+            std::size_t slot = probe(node);
+            nodes[slot] = node;
+            indices[slot] = index;
+        }
+        NodeIndices() : nodes(32, nullptr), indices(32), count(0) {
+
+        }
+    };
+
+    struct Recording {
+        std::vector<std::uint8_t> &codes;
+        std::vector<std::uint32_t> &payloads;
+        std::vector<std::uint32_t> &counts;
+        std::vector<std::uint32_t> &operands;
+        std::vector<NumberRecord> &constants;
+        std::vector<std::uint32_t> &limbs;
+        NodeIndices indices;
+    };
+
+    /**
+     * Record a node whose operands are all recorded, if it is an operation.
+     */
+    void recordNode(Expression *expression, Recording &recording) {
+        NodeIndices &indices = recording.indices;
+        std::uint8_t code;
+        std::uint32_t payload;
+        std::uint32_t count = 0;
+        switch (expression->type) {
+            case EXPRESSION_CONSTANT:
+                code = FLAT_CONSTANT;
+                payload = (std::uint32_t) recording.constants.size();
+                recording.constants.push_back(((Constant*) expression)->getNumber().record(recording.limbs));
+                break;
+            case EXPRESSION_VARIABLE:
+                code = FLAT_VARIABLE;
+                payload = ((Variable*) expression)->getSymbol(); // Symbols are process wide, like flat expressions.
+                break;
+            default: {
+                auto operation = (Operation*) expression;
+                code = (std::uint8_t) operation->getOperationType();
+                payload = (std::uint32_t) recording.operands.size();
+                count = operation->getOperandCount();
+                for (std::uint32_t i = 0; i < count; i++) {
+                    recording.operands.push_back(indices.find(operation->getOperand(i)));
+                }
+                break;
+            }
+        }
+        indices.insert(expression, (std::uint32_t) recording.codes.size());
+        recording.codes.push_back(code);
+        recording.payloads.push_back(payload);
+        recording.counts.push_back(count);
+    }
+
+    /**
+     * Record every node of the tree after its operands, depth first, with an explicit stack.
+     */
+    void record(Expression *root, Recording &recording) {
+        struct Visit {
+            Expression *expression;
+            bool expanded; // Its operands were pushed.
+        };
+        std::vector<Visit> visits {{root, false}};
+        while (!visits.empty()) {
+            Visit &visit = visits.back();
+            Expression *expression = visit.expression;
+            if (visit.expanded) {
+                visits.pop_back();
+                recordNode(expression, recording);
+            } else if (recording.indices.find(expression) != FLAT_UNRECORDED) {
+                visits.pop_back(); // Shared, already recorded.
+            } else if (expression->type == EXPRESSION_OPERATION) {
+                visit.expanded = true;
+                auto operation = (Operation*) expression;
+                for (std::uint32_t i = operation->getOperandCount(); i-- > 0;) {
+                    visits.push_back({operation->getOperand(i), false});
+                }
+            } else {
+                visits.pop_back();
+                recordNode(expression, recording);
+            }
+        }
+    }
+}
+
+FlatExpression::FlatExpression(Expression *expression) {
+    // Shared nodes are counted once per use by size, so this is an upper bound of the nodes recorded.
+    std::size_t expected = std::min((std::size_t) expression->size, (std::size_t) FLAT_MAX_RESERVED);
+    codes.reserve(expected);
+    payloads.reserve(expected);
+    counts.reserve(expected);
+    operands.reserve(expected);
+    Recording recording {codes, payloads, counts, operands, constants, limbs, {}};
+    record(expression, recording);
+}
+
+Expression *FlatExpression::toExpression() const {
+    std::vector<Expression*> created;
+    std::vector<Expression*> children;
+    created.reserve(codes.size());
+    Number number;
+    for (std::size_t node = 0; node < codes.size(); node++) {
+        std::uint32_t payload = payloads[node];
+        switch (codes[node]) {
+            case FLAT_CONSTANT:
+                Number::restore(constants[payload], limbs.data(), limbs.size(), number); // Recorded here, so well formed.
+                created.push_back(Constant::create(number));
+                break;
+            case FLAT_VARIABLE:
+                created.push_back(Variable::create((symbol_t) payload));
+                break;
+            default:
+                children.clear();
+                for (std::uint32_t i = 0; i < counts[node]; i++) {
+                    children.push_back(created[operands[payload + i]]);
+                }
+                created.push_back(Operation::create((OperationType) codes[node], children.data(), children.size()));
+                break;
+        }
+    }
+    return created.back();
+}
+
+std::size_t FlatExpression::bytes() const {
+    return sizeof(FlatExpression) + codes.size() * (sizeof(std::uint8_t) + 2 * sizeof(std::uint32_t))
+        + operands.size() * sizeof(std::uint32_t) + constants.size() * sizeof(NumberRecord)
+        + limbs.size() * sizeof(std::uint32_t);
+}
+
+bool FlatExpression::operator==(const FlatExpression &other) const {
+    // Constants are compared bit by bit, so NaN matches itself.
+    return codes == other.codes && payloads == other.payloads && counts == other.counts && operands == other.operands
+        && limbs == other.limbs && constants.size() == other.constants.size()
+        && (constants.empty() || std::memcmp(constants.data(), other.constants.data(), constants.size() * sizeof(NumberRecord)) == 0);
+}
@@ -0,0 +1,49 @@
+#ifndef FLUXION_FLATEXPRESSION_H
+#define FLUXION_FLATEXPRESSION_H
+
+#include <cstdint>
+#include <vector>
+#include "Expression.h"
+
+#define FLAT_CONSTANT 0xfe // Code of constant nodes, operations use their OperationType.
+#define FLAT_VARIABLE 0xff // Code of variable nodes.
+
+/**
+ * Storage of an expression held by the simplification cache, as parallel
+ * arrays rather than as linked nodes. Node i is described by codes[i],
+ * payloads[i] and counts[i]. The payload is the index of a constant in
+ * the constant pool, the symbol of a variable, or where the operands of
+ * an operation start in the operand array, which holds 32-bit node
+ * indices. Operands always come before the operations using them and
+ * shared subtrees are stored once.
+ *
+ * A binary operation takes 17 bytes, about a quarter of an Operation with
+ * its operand array and node table slot, so more entries fit the cache.
+ * Flat expressions own their constants and refer to no context, so they
+ * outlive the session they were made in, toExpression restores them as
+ * hash-consed nodes.
+ */
+class FlatExpression {
+private:
+    std::vector<std::uint8_t> codes;
+    std::vector<std::uint32_t> payloads;
+    std::vector<std::uint32_t> counts; // Number of operands.
+    std::vector<std::uint32_t> operands; // Node indices of the operands of every operation.
+    std::vector<NumberRecord> constants;
+    std::vector<std::uint32_t> limbs; // Limbs of big constants.
+public:
+    /**
+     * Create the expression in the current context.
+     *
+     * @return the root of the created expression.
+     */
+    Expression *toExpression() const;
+    /**
+     * @return approximate memory used by the expression.
+     */
+    std::size_t bytes() const;
+    bool operator==(const FlatExpression &other) const;
+    explicit FlatExpression(Expression *expression);
+};
+
+#endif //FLUXION_FLATEXPRESSION_H
@@ -0,0 +1,388 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include "Image.h"
+#include "Context.h"
+
+#if defined(FLUXION_MMAP_SUPPORTED)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    /**
+     * Offsets of the sections of an image, in bytes from its start.
+     */
+    struct ImageLayout {
+        std::uint64_t constants;
+        std::uint64_t limbs;
+        std::uint64_t nodes;
+        std::uint64_t operands;
+        std::uint64_t roots;
+        std::uint64_t names;
+        std::uint64_t characters;
+        std::uint64_t size; // Of the whole image, padded to the alignment.
+    };
+
+    inline std::uint64_t align(std::uint64_t offset) {
+        return (offset + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+    }
+
+    ImageLayout layoutOf(const ImageHeader &header) {
+        ImageLayout layout {};
+        layout.constants = align(sizeof(ImageHeader));
+        layout.limbs = align(layout.constants + (std::uint64_t) header.constantCount * sizeof(NumberRecord));
+        layout.nodes = align(layout.limbs + (std::uint64_t) header.limbCount * sizeof(std::uint32_t));
+        layout.operands = align(layout.nodes + (std::uint64_t) header.nodeCount * sizeof(ImageNode));
+        layout.roots = align(layout.operands + (std::uint64_t) header.operandCount * sizeof(std::uint32_t));
+        layout.names = align(layout.roots + (std::uint64_t) header.rootCount * sizeof(std::uint32_t));
+        layout.characters = align(layout.names + (std::uint64_t) header.nameCount * sizeof(ImageName));
+        layout.size = align(layout.characters + header.characterCount);
+        return layout;
+    }
+
+    template <typename T>
+    void place(std::string &image, std::uint64_t offset, const std::vector<T> &values) {
+        if (!values.empty()) {
+            std::memcpy(&image[offset], values.data(), values.size() * sizeof(T));
+        }
+    }
+}
+
+ImageWriter::ImageWriter(std::uint32_t flags) : flags(flags) {
+
+}
+
+std::uint32_t ImageWriter::addNode(Expression *expression) {
+    ImageNode node {(std::uint8_t) expression->type, (std::uint8_t) OP_ERR, 0, 0, 0};
+    switch (expression->type) {
+        case EXPRESSION_CONSTANT: {
+            // Limbs are recorded aside first, so equal numbers share a key wherever their limbs would go.
+            std::vector<std::uint32_t> numberLimbs;
+            NumberRecord record = ((Constant*) expression)->getNumber().record(numberLimbs);
+            std::string key((const char*) &record, sizeof(record));
+            key.append((const char*) numberLimbs.data(), numberLimbs.size() * sizeof(std::uint32_t));
+            auto inserted = constantIndices.emplace(std::move(key), (std::uint32_t) constants.size());
+            if (inserted.second) {
+                if (record.kind == NUMBER_BIG) {
+                    record.first = limbs.size();
+                    limbs.insert(limbs.end(), numberLimbs.begin(), numberLimbs.end());
+                }
+                constants.push_back(record);
+            }
+            node.index = inserted.first->second;
+            break;
+        }
+        case EXPRESSION_VARIABLE: {
+            auto variable = (Variable*) expression;
+            auto inserted = nameIndices.emplace(variable->getSymbol(), (std::uint32_t) names.size());
+            if (inserted.second) {
+                const std::string &name = variable->getVariableName();
+                names.push_back({(std::uint32_t) characters.size(), (std::uint32_t) name.size()});
+                characters += name;
+            }
+            node.index = inserted.first->second;
+            break;
+        }
+        case EXPRESSION_OPERATION: {
+            auto operation = (Operation*) expression;
+            node.opType = (std::uint8_t) operation->getOperationType();
+            node.index = (std::uint32_t) operands.size();
+            node.count = operation->getOperandCount();
+            for (std::uint32_t i = 0; i < node.count; i++) {
+                operands.push_back(indices[operation->getOperand(i)]);
+            }
+            break;
+        }
+    }
+    nodes.push_back(node);
+    return (std::uint32_t) nodes.size() - 1;
+}
+
+std::uint32_t ImageWriter::add(Expression *expression) {
+    // Nodes are recorded after their operands, depth first, with an explicit stack.
+    struct Visit {
+        Expression *expression;
+        bool expanded; // Its operands were pushed.
+    };
+    std::vector<Visit> visits {{expression, false}};
+    while (!visits.empty()) {
+        Visit &visit = visits.back();
+        Expression *current = visit.expression;
+        if (indices.count(current) != 0) {
+            visits.pop_back(); // Shared, already recorded.
+        } else if (current->type == EXPRESSION_OPERATION && !visit.expanded) {
+            visit.expanded = true;
+            auto operation = (Operation*) current;
+            for (std::uint32_t i = operation->getOperandCount(); i-- > 0;) {
+                visits.push_back({operation->getOperand(i), false});
+            }
+        } else {
+            visits.pop_back();
+            indices[current] = addNode(current);
+        }
+    }
+    roots.push_back(indices[expression]);
+    return (std::uint32_t) roots.size() - 1;
+}
+
+std::string ImageWriter::serialize() const {
+    ImageHeader header {IMAGE_MAGIC, IMAGE_VERSION, flags, (std::uint32_t) roots.size(), (std::uint32_t) nodes.size(),
+                        (std::uint32_t) operands.size(), (std::uint32_t) constants.size(), (std::uint32_t) names.size(),
+                        (std::uint32_t) limbs.size(), 0, characters.size(), 0};
+    ImageLayout layout = layoutOf(header);
+    header.size = layout.size;
+    std::string image(layout.size, '\0'); // Padding is zeroed, so saving the same expressions gives the same bytes.
+    std::memcpy(&image[0], &header, sizeof(header));
+    place(image, layout.constants, constants);
+    place(image, layout.limbs, limbs);
+    place(image, layout.nodes, nodes);
+    place(image, layout.operands, operands);
+    place(image, layout.roots, roots);
+    place(image, layout.names, names);
+    std::memcpy(&image[layout.characters], characters.data(), characters.size());
+    return image;
+}
+
+ImageStatus ImageWriter::save(const char *path) const {
+    std::string image = serialize();
+    std::ofstream file {path, std::ios::binary | std::ios::trunc};
+    file.write(image.data(), (std::streamsize) image.size());
+    file.close();
+    return file ? IMAGE_SUCCESSFUL : IMAGE_UNREADABLE;
+}
+
+Image::Image() : mapping(nullptr), mappingSize(0), header(nullptr), constants(nullptr), limbs(nullptr), nodes(nullptr),
+                 operands(nullptr), roots(nullptr), names(nullptr), characters(nullptr) {
+
+}
+
+Image::~Image() {
+    unmap();
+}
+
+void Image::unmap() {
+#if defined(FLUXION_MMAP_SUPPORTED)
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+    }
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+}
+
+void Image::close() {
+    unmap();
+    contents.clear();
+    contents.shrink_to_fit();
+    header = nullptr;
+}
+
+ImageStatus Image::open(const char *path) {
+    close();
+    const void *data;
+    std::size_t size;
+#if defined(FLUXION_MMAP_SUPPORTED)
+    int descriptor = ::open(path, O_RDONLY);
+    if (descriptor < 0) {
+        return IMAGE_UNREADABLE;
+    }
+    struct stat information {};
+    if (fstat(descriptor, &information) != 0) {
+        ::close(descriptor);
+        return IMAGE_UNREADABLE;
+    }
+    size = (std::size_t) information.st_size;
+    if (size < sizeof(ImageHeader)) {
+        ::close(descriptor);
+        return IMAGE_MALFORMED;
+    }
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor); // The mapping keeps the file alive.
+    if (mapped == MAP_FAILED) {
+        return IMAGE_UNREADABLE;
+    }
+    this->mapping = mapped;
+    this->mappingSize = size;
+    data = mapped;
+#else
+    std::ifstream file {path, std::ios::binary};
+    if (!file) {
+        return IMAGE_UNREADABLE;
+    }
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data = contents.data();
+    size = contents.size();
+#endif
+    ImageStatus status = attach(data, size);
+    if (status != IMAGE_SUCCESSFUL) {
+        close();
+    }
+    return status;
+}
+
+ImageStatus Image::view(const void *data, std::size_t size) {
+    close();
+    return attach(data, size);
+}
+
+ImageStatus Image::attach(const void *data, std::size_t size) {
+    if (size < sizeof(ImageHeader) || (std::uintptr_t) data % IMAGE_ALIGNMENT != 0) {
+        return IMAGE_MALFORMED;
+    }
+    auto candidate = (const ImageHeader*) data;
+    if (candidate->magic != IMAGE_MAGIC) {
+        return IMAGE_MALFORMED;
+    }
+    if (candidate->version != IMAGE_VERSION) {
+        return IMAGE_UNSUPPORTED_VERSION;
+    }
+    // Checked before computing the layout, so the offsets cannot overflow.
+    if (candidate->size != size || candidate->characterCount > size) {
+        return IMAGE_MALFORMED;
+    }
+    ImageLayout layout = layoutOf(*candidate);
+    if (layout.size != size) {
+        return IMAGE_MALFORMED;
+    }
+    auto bytes = (const char*) data;
+    header = candidate;
+    constants = (const NumberRecord*) (bytes + layout.constants);
+    limbs = (const std::uint32_t*) (bytes + layout.limbs);
+    nodes = (const ImageNode*) (bytes + layout.nodes);
+    operands = (const std::uint32_t*) (bytes + layout.operands);
+    roots = (const std::uint32_t*) (bytes + layout.roots);
+    names = (const ImageName*) (bytes + layout.names);
+    characters = bytes + layout.characters;
+    return IMAGE_SUCCESSFUL;
+}
+
+std::uint32_t Image::getRootCount() const {
+    return header != nullptr ? header->rootCount : 0;
+}
+
+bool Image::isSimplified() const {
+    return header != nullptr && (header->flags & IMAGE_FLAG_SIMPLIFIED) != 0;
+}
+
+template <typename Lookup>
+Expression *Image::restoreNode(std::uint32_t index, Lookup restored, std::vector<Expression*> &children) const {
+    const ImageNode &node = nodes[index];
+    switch (node.type) {
+        case EXPRESSION_CONSTANT: {
+            Number number;
+            if (node.index >= header->constantCount || !Number::restore(constants[node.index], limbs, header->limbCount, number)) {
+                return nullptr;
+            }
+            return Constant::create(number);
+        }
+        case EXPRESSION_VARIABLE: {
+            if (node.index >= header->nameCount) {
+                return nullptr;
+            }
+            const ImageName &name = names[node.index];
+            if ((std::uint64_t) name.offset + name.length > header->characterCount) {
+                return nullptr;
+            }
+            return Variable::create(StringSlice {characters + name.offset, name.length});
+        }
+        case EXPRESSION_OPERATION: {
+            auto opType = (OperationType) node.opType;
+            if (node.opType >= OP_ERR || node.count < 2 || (node.count > 2 && !Operation::isCommutative(opType))
+                || (std::uint64_t) node.index + node.count > header->operandCount) {
+                return nullptr;
+            }
+            children.clear();
+            for (std::uint32_t i = 0; i < node.count; i++) {
+                std::uint32_t operand = operands[node.index + i];
+                Expression *child = operand < index ? restored(operand) : nullptr; // Operands come first, so there are no cycles.
+                if (child == nullptr) {
+                    return nullptr;
+                }
+                children.push_back(child);
+            }
+            Expression *operation = Operation::create(opType, children.data(), children.size());
+            if (isSimplified()) {
+                Context::current().simplified.emplace(operation, operation);
+            }
+            return operation;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+Expression *Image::restore(std::uint32_t root) const {
+    if (root >= getRootCount() || roots[root] >= header->nodeCount) {
+        return nullptr;
+    }
+    // Only the nodes of this root are restored, depth first with an explicit stack.
+    struct Visit {
+        std::uint32_t node;
+        bool expanded; // Its operands were pushed.
+    };
+    std::unordered_map<std::uint32_t, Expression*> restored;
+    auto lookup = [&restored](std::uint32_t index) {
+        auto found = restored.find(index);
+        return found != restored.end() ? found->second : nullptr;
+    };
+    std::vector<Expression*> children;
+    std::vector<Visit> visits {{roots[root], false}};
+    while (!visits.empty()) {
+        Visit visit = visits.back();
+        const ImageNode &node = nodes[visit.node];
+        if (restored.count(visit.node) != 0) {
+            visits.pop_back(); // Shared, already restored.
+        } else if (node.type == EXPRESSION_OPERATION && !visit.expanded) {
+            if ((std::uint64_t) node.index + node.count > header->operandCount) {
+                return nullptr;
+            }
+            visits.back().expanded = true;
+            for (std::uint32_t i = node.count; i-- > 0;) {
+                std::uint32_t operand = operands[node.index + i];
+                if (operand >= visit.node) {
+                    return nullptr;
+                }
+                visits.push_back({operand, false});
+            }
+        } else {
+            visits.pop_back();
+            Expression *expression = restoreNode(visit.node, lookup, children);
+            if (expression == nullptr) {
+                return nullptr;
+            }
+            restored[visit.node] = expression;
+        }
+    }
+    return restored[roots[root]];
+}
+
+bool Image::restoreAll(std::vector<Expression*> &expressions) const {
+    expressions.clear();
+    if (header == nullptr) {
+        return false;
+    }
+    std::vector<Expression*> restored(header->nodeCount);
+    std::vector<Expression*> children;
+    auto lookup = [&restored](std::uint32_t index) {
+        return restored[index];
+    };
+    for (std::uint32_t i = 0; i < header->nodeCount; i++) {
+        restored[i] = restoreNode(i, lookup, children);
+        if (restored[i] == nullptr) {
+            return false;
+        }
+    }
+    expressions.reserve(header->rootCount);
+    for (std::uint32_t i = 0; i < header->rootCount; i++) {
+        if (roots[i] >= header->nodeCount) {
+            expressions.clear();
+            return false;
+        }
+        expressions.push_back(restored[roots[i]]);
+    }
+    return true;
+}
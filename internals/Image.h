@@ -0,0 +1,165 @@
+#ifndef FLUXION_IMAGE_H
+#define FLUXION_IMAGE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Expression.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FLUXION_MMAP_SUPPORTED 1
+#endif
+
+#define IMAGE_MAGIC 0x58554c46 // "FLUX" in a little endian file, so images from big endian machines are rejected.
+#define IMAGE_VERSION 2 // Bumped on any change to the layout, older images are rejected.
+#define IMAGE_ALIGNMENT 8 // Every section starts at a multiple of this from the start of the image.
+#define IMAGE_FLAG_SIMPLIFIED 1 // The roots are simplified, they are not simplified again when restored.
+
+enum ImageStatus {
+    IMAGE_SUCCESSFUL,
+    IMAGE_UNREADABLE, // The file could not be opened, mapped or written.
+    IMAGE_MALFORMED, // Not an image, or truncated.
+    IMAGE_UNSUPPORTED_VERSION
+};
+
+/**
+ * Start of an image, followed by its sections in this order: constants,
+ * limbs of big constants, nodes, operands, roots, names and the
+ * characters of the names.
+ */
+struct ImageHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint32_t rootCount;
+    std::uint32_t nodeCount;
+    std::uint32_t operandCount;
+    std::uint32_t constantCount;
+    std::uint32_t nameCount;
+    std::uint32_t limbCount;
+    std::uint32_t reserved;
+    std::uint64_t characterCount;
+    std::uint64_t size; // Of the whole image, in bytes.
+};
+
+/**
+ * A node of an image, operands always come before the operations using them.
+ */
+struct ImageNode {
+    std::uint8_t type; // ExpressionType
+    std::uint8_t opType; // OperationType, for operations.
+    std::uint16_t reserved;
+    std::uint32_t index; // Constant or name index for leaves, index of the first operand for operations.
+    std::uint32_t count; // Number of operands.
+};
+
+/**
+ * A name of an image, each name is stored once.
+ */
+struct ImageName {
+    std::uint32_t offset; // In the characters section.
+    std::uint32_t length;
+};
+
+/**
+ * Collects expressions to save as an image. Shared subexpressions,
+ * constants and names are stored once, even across expressions.
+ */
+class ImageWriter {
+private:
+    std::vector<ImageNode> nodes;
+    std::vector<std::uint32_t> operands;
+    std::vector<std::uint32_t> roots;
+    std::vector<NumberRecord> constants;
+    std::vector<std::uint32_t> limbs;
+    std::vector<ImageName> names;
+    std::string characters;
+    std::unordered_map<Expression*, std::uint32_t> indices; // Node of each recorded expression.
+    std::unordered_map<std::string, std::uint32_t> constantIndices; // By the bytes of the number.
+    std::unordered_map<symbol_t, std::uint32_t> nameIndices;
+    std::uint32_t flags;
+    std::uint32_t addNode(Expression *expression);
+public:
+    /**
+     * Record an expression and every node of it that is not recorded yet.
+     *
+     * @return index of the expression among the roots of the image.
+     */
+    std::uint32_t add(Expression *expression);
+    /**
+     * @return the whole image.
+     */
+    std::string serialize() const;
+    ImageStatus save(const char *path) const;
+    /**
+     * @param flags IMAGE_FLAG_ values describing the roots.
+     */
+    explicit ImageWriter(std::uint32_t flags);
+};
+
+/**
+ * A read only view of an image, either mapped from a file or in memory
+ * owned by the caller. Opening an image only checks its header and the
+ * bounds of its sections, nodes are read straight from the image when
+ * they are restored, and checked then.
+ */
+class Image {
+private:
+    void *mapping; // Mapped file, or nullptr.
+    std::size_t mappingSize;
+    std::string contents; // The file, when it cannot be mapped.
+    const ImageHeader *header;
+    const NumberRecord *constants;
+    const std::uint32_t *limbs;
+    const ImageNode *nodes;
+    const std::uint32_t *operands;
+    const std::uint32_t *roots;
+    const ImageName *names;
+    const char *characters;
+    void unmap();
+    /**
+     * Check the header and the bounds of every section, and point them into the image.
+     */
+    ImageStatus attach(const void *data, std::size_t size);
+    /**
+     * Create the node in the current context, its operands must be restored.
+     *
+     * @param restored Restored expression of every node before it that is needed.
+     * @return the expression, or nullptr if the node is malformed.
+     */
+    template <typename Lookup>
+    Expression *restoreNode(std::uint32_t index, Lookup restored, std::vector<Expression*> &children) const;
+public:
+    /**
+     * Map an image file, it stays mapped until the image is closed or destroyed.
+     */
+    ImageStatus open(const char *path);
+    /**
+     * View an image in memory, which must be aligned to IMAGE_ALIGNMENT
+     * and outlive the image.
+     */
+    ImageStatus view(const void *data, std::size_t size);
+    void close();
+    std::uint32_t getRootCount() const;
+    bool isSimplified() const;
+    /**
+     * Create a root in the current context, reading only its own nodes.
+     *
+     * @return the expression, or nullptr if the image is malformed.
+     */
+    Expression *restore(std::uint32_t root) const;
+    /**
+     * Create every root in the current context, in one pass over the nodes.
+     *
+     * @param expressions Set to the expression of each root, in order.
+     * @return false if the image is malformed.
+     */
+    bool restoreAll(std::vector<Expression*> &expressions) const;
+    Image();
+    Image(const Image&) = delete;
+    Image &operator=(const Image&) = delete;
+    ~Image();
+};
+
+#endif //FLUXION_IMAGE_H
@@ -0,0 +1,72 @@
+#include <chrono>
+#include "Instrumentation.h"
+
+std::atomic<bool> Instrumentation::enabled {false};
+std::atomic<std::uint64_t> Instrumentation::calls[PHASE_COUNT] {};
+std::atomic<std::uint64_t> Instrumentation::nanoseconds[PHASE_COUNT] {};
+std::atomic<std::uint64_t> Instrumentation::depths[PHASE_COUNT] {};
+std::atomic<std::uint64_t> Instrumentation::counters[COUNTER_COUNT] {};
+
+namespace {
+    struct PhaseState {
+        std::uint64_t depth;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    thread_local PhaseState phaseStates[PHASE_COUNT] {};
+}
+
+void Instrumentation::enter(InstrumentedPhase phase) {
+    PhaseState &state = phaseStates[phase];
+    if (state.depth++ == 0) {
+        state.start = std::chrono::steady_clock::now();
+    }
+}
+
+void Instrumentation::leave(InstrumentedPhase phase) {
+    PhaseState &state = phaseStates[phase];
+    if (--state.depth == 0) {
+        auto elapsed = std::chrono::steady_clock::now() - state.start;
+        nanoseconds[phase].fetch_add((std::uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                     std::memory_order_relaxed);
+        calls[phase].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Instrumentation::raiseDepth(InstrumentedPhase phase, std::uint64_t depth) {
+    std::uint64_t deepest = depths[phase].load(std::memory_order_relaxed);
+    while (depth > deepest && !depths[phase].compare_exchange_weak(deepest, depth, std::memory_order_relaxed)) {
+
+    }
+}
+
+void Instrumentation::setEnabled(bool value) {
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+std::uint64_t Instrumentation::getCalls(InstrumentedPhase phase) {
+    return calls[phase].load(std::memory_order_relaxed);
+}
+
+std::uint64_t Instrumentation::getNanoseconds(InstrumentedPhase phase) {
+    return nanoseconds[phase].load(std::memory_order_relaxed);
+}
+
+std::uint64_t Instrumentation::getDepth(InstrumentedPhase phase) {
+    return depths[phase].load(std::memory_order_relaxed);
+}
+
+std::uint64_t Instrumentation::getCount(InstrumentedCounter counter) {
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+void Instrumentation::reset() {
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        calls[phase].store(0, std::memory_order_relaxed);
+        nanoseconds[phase].store(0, std::memory_order_relaxed);
+        depths[phase].store(0, std::memory_order_relaxed);
+    }
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        counters[counter].store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef FLUXION_INSTRUMENTATION_H
+#define FLUXION_INSTRUMENTATION_H
+
+#include <atomic>
+#include <cstdint>
+
+enum InstrumentedPhase {
+    PHASE_PARSE,
+    PHASE_COMPILE,
+    PHASE_EVALUATE,
+    PHASE_GET_STRING,
+    PHASE_COUNT
+};
+
+enum InstrumentedCounter {
+    COUNTER_NODES, // Expressions created, hash consed duplicates are not counted.
+    COUNTER_TOKENS,
+    COUNTER_BYTES, // Bytes handed out by arenas.
+    COUNTER_COUNT
+};
+
+/**
+ * Process wide counters of where interpreting spends its time and memory.
+ * Always compiled in but disabled by default, when disabled every probe
+ * costs a single relaxed load.
+ */
+class Instrumentation {
+private:
+    static std::atomic<bool> enabled;
+    static std::atomic<std::uint64_t> calls[PHASE_COUNT];
+    static std::atomic<std::uint64_t> nanoseconds[PHASE_COUNT];
+    static std::atomic<std::uint64_t> depths[PHASE_COUNT];
+    static std::atomic<std::uint64_t> counters[COUNTER_COUNT];
+    static void enter(InstrumentedPhase phase);
+    static void leave(InstrumentedPhase phase);
+    static void raiseDepth(InstrumentedPhase phase, std::uint64_t depth);
+public:
+    static inline bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    static void setEnabled(bool value);
+    static inline void count(InstrumentedCounter counter, std::uint64_t amount) {
+        if (isEnabled()) {
+            counters[counter].fetch_add(amount, std::memory_order_relaxed);
+        }
+    }
+    /**
+     * Record how deep a phase nested, phases run on explicit stacks, so
+     * they report the high-water mark of their stack once done.
+     */
+    static inline void reportDepth(InstrumentedPhase phase, std::uint64_t depth) {
+        if (isEnabled()) {
+            raiseDepth(phase, depth);
+        }
+    }
+    /**
+     * @return outermost calls of the phase, nested calls are part of their caller.
+     */
+    static std::uint64_t getCalls(InstrumentedPhase phase);
+    static std::uint64_t getNanoseconds(InstrumentedPhase phase);
+    /**
+     * @return deepest nesting reported by the phase.
+     */
+    static std::uint64_t getDepth(InstrumentedPhase phase);
+    static std::uint64_t getCount(InstrumentedCounter counter);
+    static void reset();
+    /**
+     * Accounts the lifetime of the scope to a phase, only the outermost
+     * scope of a phase on a thread is timed.
+     */
+    class Scope {
+    private:
+        InstrumentedPhase phase;
+        bool active; // Decided once, so toggling during a call cannot unbalance the depth.
+    public:
+        explicit inline Scope(InstrumentedPhase phase) : phase(phase), active(isEnabled()) {
+            if (active) {
+                enter(phase);
+            }
+        }
+        inline ~Scope() {
+            if (active) {
+                leave(phase);
+            }
+        }
+        Scope(const Scope&) = delete;
+        Scope &operator=(const Scope&) = delete;
+    };
+};
+
+#endif //FLUXION_INSTRUMENTATION_H
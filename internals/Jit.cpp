@@ -0,0 +1,266 @@
+#include <cmath>
+#include <cstring>
+#include "Jit.h"
+
+#if defined(FLUXION_JIT_SUPPORTED)
+#include <sys/mman.h>
+#endif
+
+namespace {
+    // Opcodes of the SSE2 scalar double instructions, all are prefixed by F2 0F.
+    const std::uint8_t MOVSD_LOAD = 0x10;
+    const std::uint8_t MOVSD_STORE = 0x11;
+    const std::uint8_t SQRTSD = 0x51;
+    const std::uint8_t ADDSD = 0x58;
+    const std::uint8_t MULSD = 0x59;
+    const std::uint8_t SUBSD = 0x5c;
+    const std::uint8_t DIVSD = 0x5e;
+
+    /**
+     * Appends x86-64 instructions, registers of the program are
+     * addressed in memory: constants relative to rip, variables relative
+     * to rbx which holds the argument, and temporaries relative to rsp.
+     */
+    class Assembler {
+    private:
+        const Program &program;
+        struct Fixup {
+            std::size_t position; // Where the 32 bit displacement is.
+            std::size_t constant; // Index in the pool.
+        };
+        std::vector<Fixup> fixups;
+    public:
+        std::vector<std::uint8_t> code;
+        std::vector<double> pool; // Program constants followed by the ones the assembler needs.
+
+        explicit Assembler(const Program &program) : program(program), pool(program.getConstants()) {}
+
+        void byte(std::uint8_t b) {
+            code.push_back(b);
+        }
+
+        void int32(std::int32_t value) {
+            for (int i = 0; i < 4; i++) {
+                byte((std::uint8_t) ((std::uint32_t) value >> (8 * i)));
+            }
+        }
+
+        std::size_t constant(double value) {
+            for (std::size_t i = 0; i < pool.size(); i++) {
+                if (std::memcmp(&pool[i], &value, sizeof(value)) == 0) {
+                    return i;
+                }
+            }
+            pool.push_back(value);
+            return pool.size() - 1;
+        }
+
+        /**
+         * Emit the ModRM (and SIB, displacement) bytes addressing a pool constant.
+         */
+        void constantOperand(std::uint8_t xmm, std::size_t index) {
+            byte((std::uint8_t) (0x05 | (xmm << 3))); // [rip + disp32]
+            fixups.push_back({code.size(), index});
+            int32(0);
+        }
+
+        /**
+         * Emit the ModRM (and SIB, displacement) bytes addressing a program register.
+         */
+        void registerOperand(std::uint8_t xmm, std::uint32_t r) {
+            if (r < program.getVariableBase()) {
+                constantOperand(xmm, r);
+            } else if (r < program.getTemporaryBase()) {
+                byte((std::uint8_t) (0x83 | (xmm << 3))); // [rbx + disp32]
+                int32((std::int32_t) (8 * (r - program.getVariableBase())));
+            } else {
+                byte((std::uint8_t) (0x84 | (xmm << 3))); // [rsp + disp32]
+                byte(0x24);
+                int32((std::int32_t) (8 * (r - program.getTemporaryBase())));
+            }
+        }
+
+        /**
+         * Emit an SSE2 scalar instruction, xmm op= program register.
+         */
+        void sse(std::uint8_t opcode, std::uint8_t xmm, std::uint32_t r) {
+            byte(0xf2);
+            byte(0x0f);
+            byte(opcode);
+            registerOperand(xmm, r);
+        }
+
+        void sseConstant(std::uint8_t opcode, std::uint8_t xmm, double value) {
+            byte(0xf2);
+            byte(0x0f);
+            byte(opcode);
+            constantOperand(xmm, constant(value));
+        }
+
+        /**
+         * Emit an SSE2 scalar instruction between two xmm registers, dst op= src.
+         */
+        void sseRegisters(std::uint8_t opcode, std::uint8_t dst, std::uint8_t src) {
+            byte(0xf2);
+            byte(0x0f);
+            byte(opcode);
+            byte((std::uint8_t) (0xc0 | (dst << 3) | src));
+        }
+
+        /**
+         * Emit xmm0 = xmm0 ^ exponent by repeated squaring, using xmm1.
+         */
+        void integerPower(std::int32_t exponent) {
+            unsigned n = exponent < 0 ? -exponent : exponent;
+            if (n == 0) {
+                sseConstant(MOVSD_LOAD, 0, 1.0);
+                return;
+            }
+            bool hasResult = false;
+            for (; n != 0; n >>= 1) {
+                if (n & 1) {
+                    if (hasResult) {
+                        sseRegisters(MULSD, 1, 0);
+                    } else {
+                        sseRegisters(MOVSD_LOAD, 1, 0); // movsd xmm1, xmm0
+                        hasResult = true;
+                    }
+                }
+                if (n > 1) {
+                    sseRegisters(MULSD, 0, 0);
+                }
+            }
+            if (exponent < 0) {
+                sseConstant(MOVSD_LOAD, 0, 1.0);
+                sseRegisters(DIVSD, 0, 1);
+            } else {
+                sseRegisters(MOVSD_LOAD, 0, 1);
+            }
+        }
+
+        void callPow() {
+            double (*target)(double, double) = &std::pow;
+            byte(0x48); // mov rax, imm64
+            byte(0xb8);
+            auto address = reinterpret_cast<std::uint64_t>(target);
+            for (int i = 0; i < 8; i++) {
+                byte((std::uint8_t) (address >> (8 * i)));
+            }
+            byte(0xff); // call rax
+            byte(0xd0);
+        }
+
+        /**
+         * Place the pool after the code and resolve the rip relative displacements.
+         */
+        void finish() {
+            while (code.size() % sizeof(double) != 0) {
+                byte(0xcc); // int3 padding, never executed.
+            }
+            std::size_t poolStart = code.size();
+            for (const Fixup &fixup : fixups) {
+                auto displacement = (std::int32_t) (poolStart + 8 * fixup.constant - (fixup.position + 4));
+                std::memcpy(&code[fixup.position], &displacement, sizeof(displacement));
+            }
+            if (!pool.empty()) {
+                code.resize(poolStart + pool.size() * sizeof(double));
+                std::memcpy(&code[poolStart], pool.data(), pool.size() * sizeof(double));
+            }
+        }
+    };
+}
+
+NativeCode::NativeCode(Expression *expression) : program(expression), memory(nullptr), size(0), function(nullptr) {
+#if defined(FLUXION_JIT_SUPPORTED)
+    std::vector<std::uint8_t> generated = generate();
+    void *mapping = mmap(nullptr, generated.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return; // Evaluate with the bytecode instead.
+    }
+    std::memcpy(mapping, generated.data(), generated.size());
+    // Never writable and executable at the same time.
+    if (mprotect(mapping, generated.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(mapping, generated.size());
+        return;
+    }
+    this->memory = mapping;
+    this->size = generated.size();
+    this->function = reinterpret_cast<NativeFunction>(mapping);
+#endif
+}
+
+NativeCode::~NativeCode() {
+#if defined(FLUXION_JIT_SUPPORTED)
+    if (memory != nullptr) {
+        munmap(memory, size);
+    }
+#endif
+}
+
+bool NativeCode::isSupported() {
+#if defined(FLUXION_JIT_SUPPORTED)
+    return true;
+#else
+    return false;
+#endif
+}
+
+NativeFunction NativeCode::getFunction() const {
+    return this->function;
+}
+
+const std::vector<std::string> &NativeCode::getVariables() const {
+    return program.getVariables();
+}
+
+std::vector<std::uint8_t> NativeCode::generate() const {
+    Assembler assembler {program};
+    std::uint32_t temporaries = program.getRegisterCount() - program.getTemporaryBase();
+    // After pushing rbx the stack is 16 byte aligned, keep it so for calls to pow.
+    auto frame = (std::int32_t) ((temporaries * 8 + 15) & ~15U);
+    assembler.byte(0x53); // push rbx
+    assembler.byte(0x48); // mov rbx, rdi
+    assembler.byte(0x89);
+    assembler.byte(0xfb);
+    assembler.byte(0x48); // sub rsp, frame
+    assembler.byte(0x81);
+    assembler.byte(0xec);
+    assembler.int32(frame);
+    for (const Instruction &instruction : program.getInstructions()) {
+        assembler.sse(MOVSD_LOAD, 0, instruction.a);
+        switch (instruction.opCode) {
+            case OPCODE_ADD:
+                assembler.sse(ADDSD, 0, instruction.b);
+                break;
+            case OPCODE_SUB:
+                assembler.sse(SUBSD, 0, instruction.b);
+                break;
+            case OPCODE_MUL:
+                assembler.sse(MULSD, 0, instruction.b);
+                break;
+            case OPCODE_DIV:
+                assembler.sse(DIVSD, 0, instruction.b);
+                break;
+            case OPCODE_POW:
+                assembler.sse(MOVSD_LOAD, 1, instruction.b);
+                assembler.callPow();
+                break;
+            case OPCODE_POWI:
+                assembler.integerPower((std::int32_t) instruction.b);
+                break;
+            case OPCODE_SQRT:
+                assembler.sseRegisters(SQRTSD, 0, 0);
+                break;
+        }
+        assembler.sse(MOVSD_STORE, 0, instruction.dst);
+    }
+    assembler.sse(MOVSD_LOAD, 0, program.getResult());
+    assembler.byte(0x48); // add rsp, frame
+    assembler.byte(0x81);
+    assembler.byte(0xc4);
+    assembler.int32(frame);
+    assembler.byte(0x5b); // pop rbx
+    assembler.byte(0xc3); // ret
+    assembler.finish();
+    return assembler.code;
+}
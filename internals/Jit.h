@@ -0,0 +1,66 @@
+#ifndef FLUXION_JIT_H
+#define FLUXION_JIT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Expression.h"
+#include "Bytecode.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define FLUXION_JIT_SUPPORTED 1
+#endif
+
+/**
+ * Signature of generated code, takes the value of each variable in the
+ * order of Program::getVariables and returns the value of the expression.
+ */
+typedef double (*NativeFunction)(const double *values);
+
+/**
+ * Compiles a simplified expression into x86-64 machine code, on other
+ * architectures the bytecode interpreter is used instead.
+ *
+ * The generated function uses SSE2 scalar instructions, keeps the
+ * temporaries of the program in its stack frame, reads variables
+ * straight from its argument and constants from a pool placed after
+ * the code. Powers other than small integers and 0.5 call std::pow.
+ */
+class NativeCode {
+private:
+    Program program;
+    void *memory; // Executable mapping holding code followed by constants.
+    std::size_t size;
+    NativeFunction function;
+    /**
+     * Generate machine code for the program.
+     *
+     * @return the code and constants, ready to be copied to executable memory.
+     */
+    std::vector<std::uint8_t> generate() const;
+public:
+    /**
+     * @return true if native code can be generated on this machine.
+     */
+    static bool isSupported();
+    /**
+     * @return the generated function, or nullptr if native code is not supported.
+     */
+    NativeFunction getFunction() const;
+    /**
+     * @return names of the variables, in the order values are expected.
+     */
+    const std::vector<std::string> &getVariables() const;
+    /**
+     * Evaluate with the native code if there is one, otherwise with the bytecode.
+     */
+    inline double evaluate(const double *values) const {
+        return function != nullptr ? function(values) : program.evaluate(values);
+    }
+    explicit NativeCode(Expression *expression);
+    NativeCode(const NativeCode&) = delete;
+    NativeCode &operator=(const NativeCode&) = delete;
+    ~NativeCode();
+};
+
+#endif //FLUXION_JIT_H
@@ -0,0 +1,64 @@
+#include <algorithm>
+#include "MemoTable.h"
+
+#define MEMO_TABLE_INITIAL_SIZE 64
+
+MemoTable::MemoTable(Arena &arena) : arena(arena), slots(nullptr), capacity(0), count(0) {
+
+}
+
+std::size_t MemoTable::probe(Expression *key) const {
+    std::size_t mask = capacity - 1;
+    std::size_t i = key->_hash & mask;
+    while (slots[i].key != nullptr && slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void MemoTable::grow() {
+    Slot *old = slots;
+    std::size_t oldCapacity = capacity;
+    capacity = capacity == 0 ? MEMO_TABLE_INITIAL_SIZE : capacity * 2;
+    slots = static_cast<Slot*>(arena.allocate(capacity * sizeof(Slot), alignof(Slot)));
+    std::fill(slots, slots + capacity, Slot {nullptr, nullptr});
+    for (std::size_t i = 0; i < oldCapacity; i++) {
+        if (old[i].key != nullptr) {
+            slots[probe(old[i].key)] = old[i];
+        }
+    }
+}
+
+Expression *MemoTable::find(Expression *key) const {
+    return count == 0 ? nullptr : slots[probe(key)].value;
+}
+
+void MemoTable::set(Expression *key, Expression *value) {
+    // Keep the load factor under a half, so probe sequences stay short.
+    if ((count + 1) * 2 > capacity) {
+        grow();
+    }
+    Slot &slot = slots[probe(key)];
+    if (slot.key == nullptr) {
+        slot.key = key;
+        count++;
+    }
+    slot.value = value;
+}
+
+void MemoTable::emplace(Expression *key, Expression *value) {
+    if (find(key) == nullptr) {
+        set(key, value);
+    }
+}
+
+void MemoTable::clear() {
+    std::fill(slots, slots + capacity, Slot {nullptr, nullptr});
+    count = 0;
+}
+
+void MemoTable::release() {
+    slots = nullptr;
+    capacity = 0;
+    count = 0;
+}
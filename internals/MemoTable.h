@@ -0,0 +1,55 @@
+#ifndef FLUXION_MEMOTABLE_H
+#define FLUXION_MEMOTABLE_H
+
+#include <cstddef>
+#include "Arena.h"
+#include "Expression.h"
+
+/**
+ * Map from expressions to the expressions they simplify to, open
+ * addressing over slots allocated from the arena given to the table, so
+ * memoising a node costs no heap allocation. Slots left behind when the
+ * table grows are freed with the arena.
+ */
+class MemoTable {
+private:
+    struct Slot {
+        Expression *key;
+        Expression *value;
+    };
+    Arena &arena;
+    Slot *slots; // Size is always a power of two, nullptr until the first insertion.
+    std::size_t capacity;
+    std::size_t count;
+    /**
+     * @return index of the slot holding the key, or of the empty slot it should be inserted to.
+     */
+    std::size_t probe(Expression *key) const;
+    void grow();
+public:
+    /**
+     * @return the expression memoised for the key, or nullptr.
+     */
+    Expression *find(Expression *key) const;
+    /**
+     * Memoise a value for the key, replacing the one it had.
+     */
+    void set(Expression *key, Expression *value);
+    /**
+     * Memoise a value for the key, unless it already has one.
+     */
+    void emplace(Expression *key, Expression *value);
+    /**
+     * Forget every entry, keeping the slots.
+     */
+    void clear();
+    /**
+     * Forget every entry and the slots, this must be done before the arena is released.
+     */
+    void release();
+    explicit MemoTable(Arena &arena);
+    MemoTable(const MemoTable&) = delete;
+    MemoTable &operator=(const MemoTable&) = delete;
+};
+
+#endif //FLUXION_MEMOTABLE_H
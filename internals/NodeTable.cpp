@@ -0,0 +1,84 @@
+#include <algorithm>
+#include "NodeTable.h"
+#include "Instrumentation.h"
+
+#define NODE_TABLE_INITIAL_SIZE 64
+
+NodeTable::NodeTable(Arena &arena) : arena(arena), slots(NODE_TABLE_INITIAL_SIZE, nullptr), count(0) {
+
+}
+
+std::size_t NodeTable::size() const {
+    return this->count;
+}
+
+void NodeTable::clear() {
+    std::fill(slots.begin(), slots.end(), nullptr);
+    this->count = 0;
+}
+
+void NodeTable::grow() {
+    std::vector<Expression*> old(slots.size() * 2, nullptr);
+    old.swap(slots);
+    std::size_t mask = slots.size() - 1;
+    for (Expression *node : old) {
+        if (node != nullptr) {
+            std::size_t i = node->_hash & mask;
+            while (slots[i] != nullptr) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = node;
+        }
+    }
+}
+
+Expression *NodeTable::insert(std::size_t slot, Expression *node) {
+    slots[slot] = node;
+    Instrumentation::count(COUNTER_NODES, 1);
+    // Keep the load factor under a half, so probe sequences stay short.
+    if (++count * 2 > slots.size()) {
+        grow();
+    }
+    return node;
+}
+
+Constant *NodeTable::constant(const Number &number) {
+    hash_t hash = number.hash();
+    std::size_t slot = probe(hash, [&number](Expression *node) {
+        return node->type == EXPRESSION_CONSTANT && number.identical(((Constant*) node)->getNumber());
+    });
+    if (slots[slot] != nullptr) {
+        return (Constant*) slots[slot];
+    }
+    return (Constant*) insert(slot, arena.make<Constant>(number));
+}
+
+Variable *NodeTable::variable(symbol_t symbol) {
+    hash_t hash = hashValue((std::uint64_t) symbol);
+    std::size_t slot = probe(hash, [symbol](Expression *node) {
+        return node->type == EXPRESSION_VARIABLE && ((Variable*) node)->getSymbol() == symbol;
+    });
+    if (slots[slot] != nullptr) {
+        return (Variable*) slots[slot];
+    }
+    return (Variable*) insert(slot, arena.make<Variable>(symbol));
+}
+
+Operation *NodeTable::operation(OperationType opType, Expression *const *operands, std::size_t count) {
+    hash_t hash = Operation::computeHash(opType, operands, count);
+    std::size_t slot = probe(hash, [=](Expression *node) {
+        if (node->type != EXPRESSION_OPERATION) {
+            return false;
+        }
+        auto op = (Operation*) node;
+        // Operands of + and * are already sorted, so a + b and b + a match.
+        return op->getOperationType() == opType && op->getOperandCount() == count
+            && std::equal(operands, operands + count, op->getOperands());
+    });
+    if (slots[slot] != nullptr) {
+        return (Operation*) slots[slot];
+    }
+    auto copy = static_cast<Expression**>(arena.allocate(count * sizeof(Expression*), alignof(Expression*)));
+    std::copy(operands, operands + count, copy);
+    return (Operation*) insert(slot, arena.make<Operation>(opType, copy, (std::uint32_t) count));
+}
\ No newline at end of file
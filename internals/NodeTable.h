@@ -0,0 +1,63 @@
+#ifndef FLUXION_NODETABLE_H
+#define FLUXION_NODETABLE_H
+
+#include <vector>
+#include "Arena.h"
+#include "Expression.h"
+
+/**
+ * Hash-consing table for expressions, every node is created through
+ * this table so that structurally identical subtrees are represented
+ * by a single shared node. Nodes are allocated from the arena given
+ * to the table, and are freed with it.
+ */
+class NodeTable {
+private:
+    Arena &arena;
+    std::vector<Expression*> slots; // Open addressing, size is always a power of two.
+    std::size_t count;
+    /**
+     * Find the slot the node with the given hash is in, or the empty
+     * slot it should be inserted to.
+     *
+     * @param hash Structural hash of the node.
+     * @param matches Predicate checking if a node is structurally the one we look for.
+     * @return index of the slot.
+     */
+    template <typename Predicate>
+    std::size_t probe(hash_t hash, Predicate matches) const {
+        std::size_t mask = slots.size() - 1;
+        std::size_t i = hash & mask;
+        while (slots[i] != nullptr && !(slots[i]->_hash == hash && matches(slots[i]))) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+    /**
+     * Insert a newly created node to the slot found by probe.
+     *
+     * @return the inserted node.
+     */
+    Expression *insert(std::size_t slot, Expression *node);
+    void grow();
+public:
+    Constant *constant(const Number &number);
+    Variable *variable(symbol_t symbol);
+    /**
+     * @param operands Operands in their final order, they are copied into the arena.
+     */
+    Operation *operation(OperationType opType, Expression *const *operands, std::size_t count);
+    /**
+     * @return the number of distinct nodes in the table.
+     */
+    std::size_t size() const;
+    /**
+     * Forget all nodes, this must be done before the arena is released.
+     */
+    void clear();
+    explicit NodeTable(Arena &arena);
+    NodeTable(const NodeTable&) = delete;
+    NodeTable &operator=(const NodeTable&) = delete;
+};
+
+#endif //FLUXION_NODETABLE_H
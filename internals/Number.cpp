@@ -0,0 +1,1099 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+#include "Number.h"
+#include "NumberFormat.h"
+#include "Context.h"
+
+#define NUMBER_MAX_DECIMAL_DIGITS 18 // Fractions with a longer decimal expansion are printed as quotients.
+#define NUMBER_MAX_ROOT 64 // Largest root taken exactly, roots of 64 bit integers are 1 beyond it.
+
+/**
+ * An exact rational too large for 64 bits, allocated from an arena with
+ * its limbs, the numerator then the denominator, right after it.
+ */
+struct BigRational {
+    std::uint32_t numeratorLength;
+    std::uint32_t denominatorLength;
+    bool negative;
+    inline const std::uint32_t *getLimbs() const {return reinterpret_cast<const std::uint32_t*>(this + 1);}
+};
+
+namespace {
+    const std::int64_t powersOfTen[] = {
+        1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL, 1000000000LL,
+        10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL, 100000000000000LL,
+        1000000000000000LL, 10000000000000000LL, 100000000000000000LL, 1000000000000000000LL
+    };
+
+    /**
+     * @return false if a + b overflows or is INT64_MIN, which is never held inline.
+     */
+    inline bool checkedAdd(std::int64_t a, std::int64_t b, std::int64_t &result) {
+#if defined(__GNUC__)
+        return !__builtin_add_overflow(a, b, &result) && result != INT64_MIN;
+#else
+        if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) {
+            return false;
+        }
+        result = a + b;
+        return result != INT64_MIN;
+#endif
+    }
+
+    /**
+     * @return false if a * b overflows or is INT64_MIN.
+     */
+    inline bool checkedMultiply(std::int64_t a, std::int64_t b, std::int64_t &result) {
+#if defined(__GNUC__)
+        return !__builtin_mul_overflow(a, b, &result) && result != INT64_MIN;
+#else
+        if (a != 0 && b != 0) {
+            std::uint64_t x = a < 0 ? 0 - (std::uint64_t) a : (std::uint64_t) a;
+            std::uint64_t y = b < 0 ? 0 - (std::uint64_t) b : (std::uint64_t) b;
+            if (x > (std::uint64_t) INT64_MAX / y) {
+                return false;
+            }
+        }
+        result = a * b;
+        return true;
+#endif
+    }
+
+    inline std::uint64_t magnitude(std::int64_t value) {
+        return value < 0 ? 0 - (std::uint64_t) value : (std::uint64_t) value;
+    }
+
+    inline std::int64_t gcd(std::uint64_t a, std::uint64_t b) {
+        while (b != 0) {
+            std::uint64_t remainder = a % b;
+            a = b;
+            b = remainder;
+        }
+        return (std::int64_t) a;
+    }
+
+    inline int leadingZeros(std::uint32_t limb) {
+#if defined(__GNUC__)
+        return __builtin_clz(limb);
+#else
+        int count = 0;
+        for (; (limb & 0x80000000U) == 0; limb <<= 1) {
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    /**
+     * Arbitrary precision integer, only used while computing, results are kept as BigRational.
+     */
+    struct BigInteger {
+        std::vector<std::uint32_t> limbs; // Magnitude, least significant first, without leading zeros.
+        bool negative = false;
+
+        inline bool isZero() const {return limbs.empty();}
+        inline bool isOne() const {return limbs.size() == 1 && limbs[0] == 1;}
+        void trim() {
+            while (!limbs.empty() && limbs.back() == 0) {
+                limbs.pop_back();
+            }
+            if (limbs.empty()) {
+                negative = false;
+            }
+        }
+    };
+
+    BigInteger fromMagnitude(std::uint64_t value, bool negative) {
+        BigInteger result;
+        result.limbs = {(std::uint32_t) value, (std::uint32_t) (value >> 32)};
+        result.negative = negative;
+        result.trim();
+        return result;
+    }
+
+    BigInteger fromSigned(std::int64_t value) {
+        return fromMagnitude(magnitude(value), value < 0);
+    }
+
+    BigInteger fromLimbs(const std::uint32_t *limbs, std::size_t length, bool negative) {
+        BigInteger result;
+        result.limbs.assign(limbs, limbs + length);
+        result.negative = negative;
+        result.trim();
+        return result;
+    }
+
+    /**
+     * @return the value if it fits in 64 bits, and is not INT64_MIN.
+     */
+    /**
+     * @return the magnitude of a value of at most two limbs.
+     */
+    std::uint64_t lowBits(const BigInteger &value) {
+        std::uint64_t bits = 0;
+        for (std::size_t i = value.limbs.size(); i-- > 0;) {
+            bits = (bits << 32) | value.limbs[i];
+        }
+        return bits;
+    }
+
+    bool toSigned(const BigInteger &value, std::int64_t &result) {
+        if (value.limbs.size() > 2) {
+            return false;
+        }
+        std::uint64_t bits = lowBits(value);
+        if (bits > (std::uint64_t) INT64_MAX) {
+            return false;
+        }
+        result = value.negative ? -(std::int64_t) bits : (std::int64_t) bits;
+        return true;
+    }
+
+    std::size_t bitLength(const BigInteger &value) {
+        if (value.isZero()) {
+            return 0;
+        }
+        return value.limbs.size() * 32 - leadingZeros(value.limbs.back());
+    }
+
+    int compareMagnitudes(const BigInteger &a, const BigInteger &b) {
+        if (a.limbs.size() != b.limbs.size()) {
+            return a.limbs.size() < b.limbs.size() ? -1 : 1;
+        }
+        for (std::size_t i = a.limbs.size(); i-- > 0;) {
+            if (a.limbs[i] != b.limbs[i]) {
+                return a.limbs[i] < b.limbs[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    BigInteger addMagnitudes(const BigInteger &a, const BigInteger &b) {
+        const BigInteger &longer = a.limbs.size() >= b.limbs.size() ? a : b;
+        const BigInteger &shorter = a.limbs.size() >= b.limbs.size() ? b : a;
+        BigInteger result;
+        result.limbs.resize(longer.limbs.size() + 1);
+        std::uint64_t carry = 0;
+        for (std::size_t i = 0; i < longer.limbs.size(); i++) {
+            carry += (std::uint64_t) longer.limbs[i] + (i < shorter.limbs.size() ? shorter.limbs[i] : 0);
+            result.limbs[i] = (std::uint32_t) carry;
+            carry >>= 32;
+        }
+        result.limbs.back() = (std::uint32_t) carry;
+        result.trim();
+        return result;
+    }
+
+    /**
+     * @return |a| - |b|, |a| must be at least |b|.
+     */
+    BigInteger subtractMagnitudes(const BigInteger &a, const BigInteger &b) {
+        BigInteger result;
+        result.limbs.resize(a.limbs.size());
+        std::int64_t borrow = 0;
+        for (std::size_t i = 0; i < a.limbs.size(); i++) {
+            std::int64_t difference = (std::int64_t) a.limbs[i] - (i < b.limbs.size() ? b.limbs[i] : 0) - borrow;
+            borrow = difference < 0;
+            result.limbs[i] = (std::uint32_t) difference;
+        }
+        result.trim();
+        return result;
+    }
+
+    BigInteger add(const BigInteger &a, const BigInteger &b) {
+        BigInteger result;
+        if (a.negative == b.negative) {
+            result = addMagnitudes(a, b);
+            result.negative = a.negative;
+        } else if (compareMagnitudes(a, b) >= 0) {
+            result = subtractMagnitudes(a, b);
+            result.negative = a.negative;
+        } else {
+            result = subtractMagnitudes(b, a);
+            result.negative = b.negative;
+        }
+        result.trim();
+        return result;
+    }
+
+    BigInteger multiply(const BigInteger &a, const BigInteger &b) {
+        BigInteger result;
+        if (a.isZero() || b.isZero()) {
+            return result;
+        }
+        result.limbs.assign(a.limbs.size() + b.limbs.size(), 0);
+        for (std::size_t i = 0; i < a.limbs.size(); i++) {
+            std::uint64_t carry = 0;
+            for (std::size_t j = 0; j < b.limbs.size(); j++) {
+                carry += (std::uint64_t) a.limbs[i] * b.limbs[j] + result.limbs[i + j];
+                result.limbs[i + j] = (std::uint32_t) carry;
+                carry >>= 32;
+            }
+            result.limbs[i + b.limbs.size()] = (std::uint32_t) carry;
+        }
+        result.negative = a.negative != b.negative;
+        result.trim();
+        return result;
+    }
+
+    /**
+     * Divide the magnitude in place by a single limb.
+     *
+     * @return the remainder.
+     */
+    std::uint32_t divideSmall(BigInteger &value, std::uint32_t divisor) {
+        std::uint64_t remainder = 0;
+        for (std::size_t i = value.limbs.size(); i-- > 0;) {
+            remainder = (remainder << 32) | value.limbs[i];
+            value.limbs[i] = (std::uint32_t) (remainder / divisor);
+            remainder %= divisor;
+        }
+        value.trim();
+        return (std::uint32_t) remainder;
+    }
+
+    /**
+     * @return the remainder of the magnitude divided by a single limb.
+     */
+    std::uint32_t remainderSmall(const BigInteger &value, std::uint32_t divisor) {
+        std::uint64_t remainder = 0;
+        for (std::size_t i = value.limbs.size(); i-- > 0;) {
+            remainder = ((remainder << 32) | value.limbs[i]) % divisor;
+        }
+        return (std::uint32_t) remainder;
+    }
+
+    /**
+     * value = value * factor + addend, on the magnitude.
+     */
+    void multiplySmall(BigInteger &value, std::uint32_t factor, std::uint32_t addend) {
+        std::uint64_t carry = addend;
+        for (std::uint32_t &limb : value.limbs) {
+            carry += (std::uint64_t) limb * factor;
+            limb = (std::uint32_t) carry;
+            carry >>= 32;
+        }
+        if (carry != 0) {
+            value.limbs.push_back((std::uint32_t) carry);
+        }
+    }
+
+    BigInteger shiftLeft(const BigInteger &value, std::size_t bits) {
+        BigInteger result;
+        if (value.isZero()) {
+            return result;
+        }
+        std::size_t limbs = bits / 32;
+        int offset = (int) (bits % 32);
+        result.limbs.assign(value.limbs.size() + limbs + 1, 0);
+        for (std::size_t i = 0; i < value.limbs.size(); i++) {
+            std::uint64_t shifted = (std::uint64_t) value.limbs[i] << offset;
+            result.limbs[i + limbs] |= (std::uint32_t) shifted;
+            result.limbs[i + limbs + 1] |= (std::uint32_t) (shifted >> 32);
+        }
+        result.negative = value.negative;
+        result.trim();
+        return result;
+    }
+
+    /**
+     * Divide magnitudes, by Knuth's algorithm D, the quotient is truncated.
+     */
+    void divide(const BigInteger &a, const BigInteger &b, BigInteger &quotient, BigInteger &remainder) {
+        quotient = BigInteger();
+        if (compareMagnitudes(a, b) < 0) {
+            remainder = a;
+            remainder.negative = false;
+            return;
+        }
+        if (b.limbs.size() == 1) {
+            quotient = a;
+            quotient.negative = false;
+            remainder = fromMagnitude(divideSmall(quotient, b.limbs[0]), false);
+            return;
+        }
+        // Normalize so the top limb of the divisor has its top bit set, then each quotient
+        // limb estimated from the top two limbs is at most 2 too large.
+        int shift = leadingZeros(b.limbs.back());
+        std::size_t n = b.limbs.size();
+        std::size_t m = a.limbs.size() - n;
+        std::vector<std::uint32_t> v(n), u(a.limbs.size() + 1);
+        for (std::size_t i = n; i-- > 0;) {
+            v[i] = (b.limbs[i] << shift) | (shift != 0 && i > 0 ? b.limbs[i - 1] >> (32 - shift) : 0);
+        }
+        u[a.limbs.size()] = shift != 0 ? a.limbs.back() >> (32 - shift) : 0;
+        for (std::size_t i = a.limbs.size(); i-- > 0;) {
+            u[i] = (a.limbs[i] << shift) | (shift != 0 && i > 0 ? a.limbs[i - 1] >> (32 - shift) : 0);
+        }
+        quotient.limbs.assign(m + 1, 0);
+        for (std::size_t j = m + 1; j-- > 0;) {
+            std::uint64_t numerator = ((std::uint64_t) u[j + n] << 32) | u[j + n - 1];
+            std::uint64_t estimate = numerator / v[n - 1];
+            std::uint64_t rest = numerator % v[n - 1];
+            while (estimate > 0xffffffffULL || estimate * v[n - 2] > ((rest << 32) | u[j + n - 2])) {
+                estimate--;
+                rest += v[n - 1];
+                if (rest > 0xffffffffULL) {
+                    break;
+                }
+            }
+            std::int64_t borrow = 0;
+            std::uint64_t carry = 0;
+            for (std::size_t i = 0; i < n; i++) {
+                std::uint64_t product = estimate * v[i] + carry;
+                carry = product >> 32;
+                std::int64_t difference = (std::int64_t) u[i + j] - borrow - (std::int64_t) (product & 0xffffffffULL);
+                u[i + j] = (std::uint32_t) difference;
+                borrow = difference < 0;
+            }
+            std::int64_t difference = (std::int64_t) u[j + n] - borrow - (std::int64_t) carry;
+            u[j + n] = (std::uint32_t) difference;
+            if (difference < 0) {
+                // The estimate was one too large, add the divisor back.
+                estimate--;
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; i++) {
+                    sum += (std::uint64_t) u[i + j] + v[i];
+                    u[i + j] = (std::uint32_t) sum;
+                    sum >>= 32;
+                }
+                u[j + n] += (std::uint32_t) sum;
+            }
+            quotient.limbs[j] = (std::uint32_t) estimate;
+        }
+        quotient.trim();
+        remainder.limbs.assign(n, 0);
+        remainder.negative = false;
+        for (std::size_t i = 0; i < n; i++) {
+            remainder.limbs[i] = (u[i] >> shift) | (shift != 0 ? u[i + 1] << (32 - shift) : 0);
+        }
+        remainder.trim();
+    }
+
+    BigInteger gcd(BigInteger a, BigInteger b) {
+        a.negative = false;
+        b.negative = false;
+        BigInteger quotient, remainder;
+        while (!b.isZero()) {
+            if (a.limbs.size() <= 2 && b.limbs.size() <= 2) {
+                // Finished on machine words, which is most of the steps for numbers of a few limbs.
+                std::uint64_t x = lowBits(a);
+                std::uint64_t y = lowBits(b);
+                while (y != 0) {
+                    std::uint64_t next = x % y;
+                    x = y;
+                    y = next;
+                }
+                return fromMagnitude(x, false);
+            }
+            divide(a, b, quotient, remainder);
+            a = std::move(b);
+            b = std::move(remainder);
+        }
+        return a;
+    }
+
+    /**
+     * @return a / b for a b that divides a, with the sign of a.
+     */
+    BigInteger divideExactly(const BigInteger &a, const BigInteger &b) {
+        BigInteger quotient, remainder;
+        divide(a, b, quotient, remainder);
+        quotient.negative = a.negative && !quotient.isZero();
+        return quotient;
+    }
+
+    std::string toDecimal(BigInteger value) {
+        std::string digits;
+        bool negative = value.negative;
+        while (!value.isZero()) {
+            std::uint32_t chunk = divideSmall(value, 1000000000U);
+            for (int i = 0; i < 9 && (chunk != 0 || !value.isZero()); i++) {
+                digits.push_back((char) ('0' + chunk % 10));
+                chunk /= 10;
+            }
+        }
+        if (digits.empty()) {
+            digits = "0";
+        }
+        if (negative) {
+            digits.push_back('-');
+        }
+        return std::string(digits.rbegin(), digits.rend());
+    }
+
+    /**
+     * @return the digits of a non negative integer, written backwards from the end of the buffer.
+     */
+    char *formatInteger(std::uint64_t value, char *end) {
+        do {
+            *--end = (char) ('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        return end;
+    }
+
+    /**
+     * @return number of digits after the point of numerator / denominator written as a decimal,
+     * or -1 if it has none that fits 64 bits.
+     */
+    int decimalDigits(std::int64_t numerator, std::int64_t denominator, std::uint64_t &scaled) {
+        int twos = 0;
+        int fives = 0;
+        std::int64_t rest = denominator;
+        for (; rest % 2 == 0; rest /= 2) {
+            twos++;
+        }
+        for (; rest % 5 == 0; rest /= 5) {
+            fives++;
+        }
+        int digits = twos > fives ? twos : fives;
+        if (rest != 1 || digits > NUMBER_MAX_DECIMAL_DIGITS) {
+            return -1;
+        }
+        std::int64_t result;
+        if (!checkedMultiply((std::int64_t) magnitude(numerator), powersOfTen[digits] / denominator, result)) {
+            return -1;
+        }
+        scaled = (std::uint64_t) result;
+        return digits;
+    }
+
+    /**
+     * @return the integer q-th root of value, false if value is not a q-th power.
+     */
+    bool integerRoot(std::int64_t value, std::int64_t q, std::int64_t &root) {
+        auto estimate = (std::int64_t) std::llround(std::pow((double) value, 1.0 / (double) q));
+        for (std::int64_t candidate = estimate > 0 ? estimate - 1 : 0; candidate <= estimate + 1; candidate++) {
+            std::int64_t power = 1;
+            bool fits = true;
+            for (std::int64_t i = 0; i < q && fits; i++) {
+                fits = checkedMultiply(power, candidate, power);
+            }
+            if (fits && power == value) {
+                root = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+/**
+ * Arithmetic that needs the representation of numbers, on bignums.
+ */
+struct Number::Operations {
+    static Number small(std::int64_t numerator, std::int64_t denominator) {
+        Number number;
+        number.kind = NUMBER_SMALL;
+        number.small = {numerator, denominator};
+        return number;
+    }
+
+    static void expand(const Number &number, BigInteger &numerator, BigInteger &denominator) {
+        if (number.kind == NUMBER_SMALL) {
+            numerator = fromSigned(number.small.numerator);
+            denominator = fromSigned(number.small.denominator);
+        } else {
+            const BigRational *big = number.big;
+            numerator = fromLimbs(big->getLimbs(), big->numeratorLength, big->negative);
+            denominator = fromLimbs(big->getLimbs() + big->numeratorLength, big->denominatorLength, false);
+        }
+    }
+
+    /**
+     * @param denominator Must be positive.
+     * @param reduced True if they are known to have no common factor.
+     */
+    static Number store(BigInteger numerator, BigInteger denominator, bool reduced) {
+        if (!reduced && !denominator.isOne()) {
+            BigInteger common = gcd(numerator, denominator);
+            if (!common.isOne() && !common.isZero()) {
+                BigInteger quotient, remainder;
+                bool negative = numerator.negative;
+                divide(numerator, common, quotient, remainder);
+                numerator = std::move(quotient);
+                numerator.negative = negative && !numerator.isZero();
+                divide(denominator, common, quotient, remainder);
+                denominator = std::move(quotient);
+            }
+        }
+        std::int64_t n, d;
+        if (toSigned(numerator, n) && toSigned(denominator, d)) {
+            return small(n, d);
+        }
+        std::size_t limbs = numerator.limbs.size() + denominator.limbs.size();
+        void *memory = Context::current().arena.allocate(sizeof(BigRational) + limbs * sizeof(std::uint32_t),
+                                                         alignof(BigRational));
+        auto big = new (memory) BigRational {(std::uint32_t) numerator.limbs.size(),
+                                             (std::uint32_t) denominator.limbs.size(), numerator.negative};
+        auto target = reinterpret_cast<std::uint32_t*>(big + 1);
+        std::memcpy(target, numerator.limbs.data(), numerator.limbs.size() * sizeof(std::uint32_t));
+        std::memcpy(target + numerator.limbs.size(), denominator.limbs.data(),
+                    denominator.limbs.size() * sizeof(std::uint32_t));
+        Number number;
+        number.kind = NUMBER_BIG;
+        number.big = big;
+        return number;
+    }
+
+    static Number sum(const Number &a, const Number &b) {
+        BigInteger an, ad, bn, bd;
+        expand(a, an, ad);
+        expand(b, bn, bd);
+        if (ad.isOne() && bd.isOne()) {
+            return store(add(an, bn), ad, true);
+        }
+        // Knuth's method, only the common part of the denominators can be common with the numerator.
+        BigInteger common = gcd(ad, bd);
+        if (common.isOne()) {
+            return store(add(multiply(an, bd), multiply(bn, ad)), multiply(ad, bd), true);
+        }
+        BigInteger bShare = divideExactly(bd, common);
+        BigInteger numerator = add(multiply(an, bShare), multiply(bn, divideExactly(ad, common)));
+        BigInteger factor = gcd(numerator, common);
+        if (factor.isOne()) {
+            return store(numerator, multiply(ad, bShare), true);
+        }
+        return store(divideExactly(numerator, factor), multiply(divideExactly(ad, factor), bShare), true);
+    }
+
+    static Number product(const Number &a, const Number &b) {
+        BigInteger an, ad, bn, bd;
+        expand(a, an, ad);
+        expand(b, bn, bd);
+        // Cancel across first, like for small numbers, so the product is already reduced.
+        BigInteger left = gcd(an, bd);
+        if (!left.isOne()) {
+            an = divideExactly(an, left);
+            bd = divideExactly(bd, left);
+        }
+        BigInteger right = gcd(bn, ad);
+        if (!right.isOne()) {
+            bn = divideExactly(bn, right);
+            ad = divideExactly(ad, right);
+        }
+        return store(multiply(an, bn), multiply(ad, bd), true);
+    }
+
+    static Number quotient(const Number &a, const Number &b) {
+        BigInteger an, ad, bn, bd;
+        expand(a, an, ad);
+        expand(b, bn, bd);
+        BigInteger numerator = multiply(an, bd);
+        BigInteger denominator = multiply(ad, bn);
+        numerator.negative = denominator.negative != numerator.negative && !numerator.isZero();
+        denominator.negative = false;
+        return store(numerator, denominator, false);
+    }
+
+    static int order(const Number &a, const Number &b) {
+        BigInteger an, ad, bn, bd;
+        expand(a, an, ad);
+        expand(b, bn, bd);
+        BigInteger right = multiply(bn, ad);
+        right.negative = !right.negative && !right.isZero();
+        BigInteger difference = add(multiply(an, bd), right);
+        return difference.isZero() ? 0 : (difference.negative ? -1 : 1);
+    }
+
+    /**
+     * @return the closest double to an exact number, rounded once.
+     */
+    static double toDouble(const Number &number) {
+        BigInteger numerator, denominator;
+        expand(number, numerator, denominator);
+        if (numerator.isZero()) {
+            return 0;
+        }
+        double sign = numerator.negative ? -1 : 1;
+        numerator.negative = false;
+        auto numeratorBits = (long) bitLength(numerator);
+        auto denominatorBits = (long) bitLength(denominator);
+        if (numeratorBits - denominatorBits > 1100) {
+            return sign * HUGE_VAL;
+        } else if (denominatorBits - numeratorBits > 1200) {
+            return sign * 0.0;
+        }
+        // Scale so the quotient has 65 or 66 bits, the remainder only matters as a sticky bit.
+        long shift = 65 + denominatorBits - numeratorBits;
+        if (shift > 0) {
+            numerator = shiftLeft(numerator, (std::size_t) shift);
+        } else {
+            denominator = shiftLeft(denominator, (std::size_t) -shift);
+        }
+        BigInteger quotient, remainder;
+        divide(numerator, denominator, quotient, remainder);
+        bool sticky = !remainder.isZero();
+        std::size_t dropped = bitLength(quotient) - 64;
+        std::uint64_t bits = 0;
+        for (std::size_t i = 0; i < 64; i++) {
+            std::size_t position = dropped + i;
+            bits |= (std::uint64_t) ((quotient.limbs[position / 32] >> (position % 32)) & 1U) << i;
+        }
+        for (std::size_t position = 0; position < dropped; position++) {
+            sticky = sticky || ((quotient.limbs[position / 32] >> (position % 32)) & 1U) != 0;
+        }
+        // Round the 64 bits to 53, half to even.
+        std::uint64_t low = bits & 0x7ff;
+        bits >>= 11;
+        if (low > 0x400 || (low == 0x400 && (sticky || (bits & 1) != 0))) {
+            bits++;
+        }
+        return sign * std::ldexp((double) bits, (int) ((long) dropped + 11 - shift));
+    }
+};
+
+Number Number::integer(std::int64_t value) {
+    if (value == INT64_MIN) {
+        return Operations::store(fromSigned(value), fromMagnitude(1, false), true);
+    }
+    return Operations::small(value, 1);
+}
+
+Number Number::rational(std::int64_t numerator, std::int64_t denominator) {
+    if (denominator == 0) {
+        return real((double) numerator / 0.0);
+    }
+    if (numerator == INT64_MIN || denominator == INT64_MIN) {
+        BigInteger n = fromSigned(numerator);
+        BigInteger d = fromSigned(denominator);
+        n.negative = (n.negative != d.negative) && !n.isZero();
+        d.negative = false;
+        return Operations::store(n, d, false);
+    }
+    if (denominator < 0) {
+        numerator = -numerator;
+        denominator = -denominator;
+    }
+    std::int64_t common = gcd(magnitude(numerator), (std::uint64_t) denominator);
+    return Operations::small(numerator / common, denominator / common);
+}
+
+Number Number::real(double value) {
+    Number number;
+    number.kind = NUMBER_REAL;
+    number.inexact = value;
+    return number;
+}
+
+Number Number::fromDouble(double value) {
+    if (value == std::floor(value) && std::fabs(value) < 9.2e18) {
+        return Operations::small((std::int64_t) value, 1);
+    }
+    return real(value);
+}
+
+Number Number::parse(const char *text, std::size_t length) {
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = -1;
+    for (std::size_t i = 0; i < length; i++) {
+        if (text[i] == '.') {
+            fractionDigits = 0;
+            continue;
+        }
+        mantissa = mantissa * 10 + (text[i] - '0');
+        digits++;
+        fractionDigits += fractionDigits >= 0;
+    }
+    fractionDigits = fractionDigits < 0 ? 0 : fractionDigits;
+    if (digits <= NUMBER_MAX_DECIMAL_DIGITS) {
+        // Both the mantissa and the power of ten fit in 64 bits.
+        return rational((std::int64_t) mantissa, powersOfTen[fractionDigits]);
+    }
+    // Digits are read nine at a time, so the bignum is only multiplied once per chunk.
+    BigInteger numerator;
+    std::uint32_t chunk = 0;
+    int chunkDigits = 0;
+    for (std::size_t i = 0; i < length; i++) {
+        if (text[i] == '.') {
+            continue;
+        }
+        chunk = chunk * 10 + (std::uint32_t) (text[i] - '0');
+        if (++chunkDigits == 9) {
+            multiplySmall(numerator, (std::uint32_t) powersOfTen[9], chunk);
+            chunk = 0;
+            chunkDigits = 0;
+        }
+    }
+    multiplySmall(numerator, (std::uint32_t) powersOfTen[chunkDigits], chunk);
+    numerator.trim();
+    // The denominator is a power of ten, so only factors of 2 and 5 can be common, which
+    // are cancelled one at a time rather than by a gcd.
+    int twos = numerator.isZero() ? 0 : fractionDigits;
+    int fives = twos;
+    for (; twos > 0 && (numerator.limbs[0] & 1) == 0; twos--) {
+        divideSmall(numerator, 2);
+    }
+    for (; fives > 0 && remainderSmall(numerator, 5) == 0; fives--) {
+        divideSmall(numerator, 5);
+    }
+    BigInteger denominator = fromMagnitude(1, false);
+    for (; twos > 0; twos--) {
+        multiplySmall(denominator, 2, 0);
+    }
+    for (; fives > 0; fives--) {
+        multiplySmall(denominator, 5, 0);
+    }
+    return Operations::store(numerator, denominator, true);
+}
+
+bool Number::power(const Number &a, const Number &b, Number &result) {
+    if (!a.isExact() || !b.isExact()) {
+        result = real(std::pow(a.toDouble(), b.toDouble()));
+        return true;
+    }
+    if (b.isZero() || a.isOne()) {
+        result = integer(1);
+        return true;
+    }
+    if (b.isOne()) {
+        result = a;
+        return true;
+    }
+    if (b.kind == NUMBER_BIG) {
+        return false;
+    }
+    std::int64_t p = b.small.numerator;
+    std::int64_t q = b.small.denominator;
+    if (a.isZero()) {
+        result = p > 0 ? a : real(std::pow(0.0, (double) p));
+        return true;
+    }
+    Number base = a;
+    if (q != 1) {
+        // Only rationals whose parts are both q-th powers have a rational q-th root.
+        std::int64_t numerator, denominator;
+        if (a.kind == NUMBER_BIG || a.small.numerator < 0 || q > NUMBER_MAX_ROOT
+            || !integerRoot(a.small.numerator, q, numerator) || !integerRoot(a.small.denominator, q, denominator)) {
+            return false;
+        }
+        base = Operations::small(numerator, denominator);
+    }
+    if (base.kind == NUMBER_SMALL && base.small.denominator == 1 && magnitude(base.small.numerator) == 1) {
+        result = p % 2 == 0 ? integer(1) : base; // (-1) ^ p
+        return true;
+    }
+    BigInteger numerator, denominator;
+    Operations::expand(base, numerator, denominator);
+    std::size_t bits = std::max(bitLength(numerator), bitLength(denominator));
+    std::uint64_t exponent = magnitude(p);
+    if (exponent > NUMBER_MAX_POWER_BITS || bits * exponent > NUMBER_MAX_POWER_BITS) {
+        return false;
+    }
+    // Powers of a reduced fraction are reduced, so both parts are raised on their own.
+    BigInteger numeratorPower = fromMagnitude(1, false);
+    BigInteger denominatorPower = fromMagnitude(1, false);
+    for (; exponent != 0; exponent >>= 1) {
+        if ((exponent & 1) != 0) {
+            numeratorPower = multiply(numeratorPower, numerator);
+            denominatorPower = multiply(denominatorPower, denominator);
+        }
+        if (exponent > 1) {
+            numerator = multiply(numerator, numerator);
+            denominator = multiply(denominator, denominator);
+        }
+    }
+    if (p < 0) {
+        std::swap(numeratorPower, denominatorPower);
+        numeratorPower.negative = denominatorPower.negative;
+        denominatorPower.negative = false;
+    }
+    result = Operations::store(numeratorPower, denominatorPower, true);
+    return true;
+}
+
+int Number::compare(const Number &a, const Number &b) {
+    if (a.isExact() && b.isExact()) {
+        if (a.kind == NUMBER_SMALL && b.kind == NUMBER_SMALL) {
+            if (a.small.denominator == b.small.denominator) {
+                return a.small.numerator < b.small.numerator ? -1 : (a.small.numerator > b.small.numerator ? 1 : 0);
+            }
+            std::int64_t left, right;
+            if (checkedMultiply(a.small.numerator, b.small.denominator, left)
+                && checkedMultiply(b.small.numerator, a.small.denominator, right)) {
+                return left < right ? -1 : (left > right ? 1 : 0);
+            }
+        }
+        return Operations::order(a, b);
+    }
+    double x = a.toDouble();
+    double y = b.toDouble();
+    if (std::isnan(x) || std::isnan(y)) {
+        return std::isnan(x) ? (std::isnan(y) ? 0 : 1) : -1; // NaN last.
+    }
+    if (x != y) {
+        return x < y ? -1 : 1;
+    }
+    return a.isExact() == b.isExact() ? 0 : (a.isExact() ? -1 : 1);
+}
+
+bool Number::restore(const NumberRecord &record, const std::uint32_t *limbs, std::size_t limbCount, Number &number) {
+    switch (record.kind) {
+        case NUMBER_SMALL: {
+            auto numerator = (std::int64_t) record.first;
+            auto denominator = (std::int64_t) record.second;
+            if (denominator <= 0) {
+                return false;
+            }
+            number = rational(numerator, denominator);
+            return true;
+        }
+        case NUMBER_REAL: {
+            double value;
+            std::memcpy(&value, &record.first, sizeof(value));
+            number = real(value);
+            return true;
+        }
+        case NUMBER_BIG: {
+            if (record.first > limbCount || record.numeratorLength > limbCount - record.first
+                || record.second > limbCount - record.first - record.numeratorLength) {
+                return false;
+            }
+            BigInteger numerator = fromLimbs(limbs + record.first, record.numeratorLength, record.negative != 0);
+            BigInteger denominator = fromLimbs(limbs + record.first + record.numeratorLength, (std::size_t) record.second, false);
+            if (denominator.isZero()) {
+                return false;
+            }
+            number = Operations::store(numerator, denominator, false);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool Number::isInteger() const {
+    switch (kind) {
+        case NUMBER_SMALL:
+            return small.denominator == 1;
+        case NUMBER_BIG:
+            return big->denominatorLength == 1 && big->getLimbs()[big->numeratorLength] == 1;
+        default:
+            return std::isfinite(inexact) && inexact == std::floor(inexact);
+    }
+}
+
+bool Number::toInteger(std::int64_t &value) const {
+    if (kind != NUMBER_SMALL || small.denominator != 1) {
+        return false; // Big numbers never fit, or they would be small.
+    }
+    value = small.numerator;
+    return true;
+}
+
+bool Number::isZero() const {
+    return kind == NUMBER_SMALL ? small.numerator == 0 : (kind == NUMBER_REAL && inexact == 0);
+}
+
+bool Number::isOne() const {
+    return kind == NUMBER_SMALL ? small.numerator == 1 && small.denominator == 1 : (kind == NUMBER_REAL && inexact == 1);
+}
+
+int Number::sign() const {
+    switch (kind) {
+        case NUMBER_SMALL:
+            return (small.numerator > 0) - (small.numerator < 0);
+        case NUMBER_BIG:
+            return big->negative ? -1 : 1;
+        default:
+            return (inexact > 0) - (inexact < 0);
+    }
+}
+
+double Number::toDouble() const {
+    if (kind == NUMBER_REAL) {
+        return inexact;
+    }
+    if (kind == NUMBER_SMALL && magnitude(small.numerator) <= (1ULL << 53) && small.denominator <= (1LL << 53)) {
+        return (double) small.numerator / (double) small.denominator; // Both exact, so rounded once.
+    }
+    return Operations::toDouble(*this);
+}
+
+bool Number::identical(const Number &other) const {
+    if (kind != other.kind) {
+        return false;
+    }
+    switch (kind) {
+        case NUMBER_SMALL:
+            return small.numerator == other.small.numerator && small.denominator == other.small.denominator;
+        case NUMBER_BIG: {
+            std::size_t limbs = big->numeratorLength + big->denominatorLength;
+            return big->negative == other.big->negative && big->numeratorLength == other.big->numeratorLength
+                && big->denominatorLength == other.big->denominatorLength
+                && std::memcmp(big->getLimbs(), other.big->getLimbs(), limbs * sizeof(std::uint32_t)) == 0;
+        }
+        default:
+            return inexact == other.inexact || (std::isnan(inexact) && std::isnan(other.inexact));
+    }
+}
+
+hash_t Number::hash() const {
+    switch (kind) {
+        case NUMBER_SMALL:
+            return hashCombine(hashValue((std::uint64_t) small.numerator), hashValue((std::uint64_t) small.denominator));
+        case NUMBER_BIG: {
+            hash_t hash = hashValue(((std::uint64_t) big->numeratorLength << 32) | (big->negative ? 1U : 0U));
+            const std::uint32_t *limbs = big->getLimbs();
+            for (std::uint32_t i = 0; i < big->numeratorLength + big->denominatorLength; i++) {
+                hash = hashCombine(hash, limbs[i]);
+            }
+            return hash;
+        }
+        default:
+            return hashCombine(hashValue(inexact), NUMBER_REAL);
+    }
+}
+
+bool Number::isPrintedAsQuotient() const {
+    std::uint64_t scaled;
+    return isExact() && !isInteger()
+        && (kind == NUMBER_BIG || decimalDigits(small.numerator, small.denominator, scaled) < 0);
+}
+
+void Number::write(OutputSink &sink) const {
+    char buffer[2 * NUMBER_FORMAT_BUFFER_SIZE]; // Room for a quotient of two 64 bit integers.
+    char *end = buffer + sizeof(buffer);
+    if (kind == NUMBER_REAL) {
+        sink.write(buffer, formatNumber(inexact, buffer));
+    } else if (kind == NUMBER_BIG) {
+        BigInteger numerator, denominator;
+        Operations::expand(*this, numerator, denominator);
+        std::string text = toDecimal(numerator);
+        if (!denominator.isOne()) {
+            text += "/" + toDecimal(denominator);
+        }
+        sink.write(text.data(), text.size());
+    } else {
+        std::uint64_t scaled;
+        int digits = decimalDigits(small.numerator, small.denominator, scaled);
+        if (small.numerator < 0) {
+            sink.write("-", 1);
+        }
+        if (digits > 0) {
+            // A short decimal expansion, such as 0.25, written with exactly that many digits after the point.
+            std::uint64_t power = (std::uint64_t) powersOfTen[digits];
+            char *start = formatInteger(scaled % power + power, end); // Leading 1 keeps the zeros after the point.
+            *start = '.';
+            start = formatInteger(scaled / power, start);
+            sink.write(start, end - start);
+        } else if (digits == 0) {
+            char *start = formatInteger(magnitude(small.numerator), end);
+            sink.write(start, end - start);
+        } else {
+            char *start = formatInteger((std::uint64_t) small.denominator, end);
+            *--start = '/';
+            start = formatInteger(magnitude(small.numerator), start);
+            sink.write(start, end - start);
+        }
+    }
+}
+
+NumberRecord Number::record(std::vector<std::uint32_t> &limbs) const {
+    NumberRecord record {kind, 0, 0, 0, 0, 0};
+    switch (kind) {
+        case NUMBER_SMALL:
+            record.first = (std::uint64_t) small.numerator;
+            record.second = (std::uint64_t) small.denominator;
+            break;
+        case NUMBER_BIG:
+            record.negative = big->negative;
+            record.numeratorLength = big->numeratorLength;
+            record.first = limbs.size();
+            record.second = big->denominatorLength;
+            limbs.insert(limbs.end(), big->getLimbs(), big->getLimbs() + big->numeratorLength + big->denominatorLength);
+            break;
+        default:
+            std::memcpy(&record.first, &inexact, sizeof(inexact));
+            break;
+    }
+    return record;
+}
+
+Number Number::operator-() const {
+    switch (kind) {
+        case NUMBER_SMALL:
+            return Operations::small(-small.numerator, small.denominator);
+        case NUMBER_BIG: {
+            BigInteger numerator, denominator;
+            Operations::expand(*this, numerator, denominator);
+            numerator.negative = !numerator.negative;
+            return Operations::store(numerator, denominator, true);
+        }
+        default:
+            return real(-inexact);
+    }
+}
+
+Number operator+(const Number &a, const Number &b) {
+    if (a.kind == NUMBER_SMALL && b.kind == NUMBER_SMALL) {
+        std::int64_t numerator, denominator;
+        if (a.small.denominator == 1 && b.small.denominator == 1) {
+            if (checkedAdd(a.small.numerator, b.small.numerator, numerator)) {
+                return Number::Operations::small(numerator, 1);
+            }
+        } else {
+            std::int64_t common = gcd((std::uint64_t) a.small.denominator, (std::uint64_t) b.small.denominator);
+            std::int64_t left, right;
+            if (checkedMultiply(a.small.numerator, b.small.denominator / common, left)
+                && checkedMultiply(b.small.numerator, a.small.denominator / common, right)
+                && checkedAdd(left, right, numerator)
+                && checkedMultiply(a.small.denominator, b.small.denominator / common, denominator)) {
+                return Number::rational(numerator, denominator);
+            }
+        }
+    }
+    if (!a.isExact() || !b.isExact()) {
+        return Number::real(a.toDouble() + b.toDouble());
+    }
+    return Number::Operations::sum(a, b);
+}
+
+Number operator-(const Number &a, const Number &b) {
+    if (b.kind == NUMBER_BIG && a.isExact()) {
+        return Number::Operations::sum(a, -b);
+    }
+    return a + -b;
+}
+
+Number operator*(const Number &a, const Number &b) {
+    if (a.kind == NUMBER_SMALL && b.kind == NUMBER_SMALL) {
+        // Cancel across first, so the product is already reduced.
+        if (a.small.numerator == 0 || b.small.numerator == 0) {
+            return Number::Operations::small(0, 1);
+        }
+        std::int64_t left = gcd(magnitude(a.small.numerator), (std::uint64_t) b.small.denominator);
+        std::int64_t right = gcd(magnitude(b.small.numerator), (std::uint64_t) a.small.denominator);
+        std::int64_t numerator, denominator;
+        if (checkedMultiply(a.small.numerator / left, b.small.numerator / right, numerator)
+            && checkedMultiply(a.small.denominator / right, b.small.denominator / left, denominator)) {
+            return Number::Operations::small(numerator, denominator);
+        }
+    }
+    if (!a.isExact() || !b.isExact()) {
+        return Number::real(a.toDouble() * b.toDouble());
+    }
+    if (a.isOne() || b.isOne()) {
+        return a.isOne() ? b : a; // Common for weights and coefficients, and needs no bignum.
+    }
+    return Number::Operations::product(a, b);
+}
+
+Number operator/(const Number &a, const Number &b) {
+    if (!a.isExact() || !b.isExact() || b.isZero()) {
+        return Number::real(a.toDouble() / b.toDouble());
+    }
+    if (b.kind == NUMBER_SMALL) {
+        std::int64_t numerator = b.small.numerator;
+        Number reciprocal = Number::Operations::small(numerator < 0 ? -b.small.denominator : b.small.denominator,
+                                                      (std::int64_t) magnitude(numerator));
+        return a * reciprocal;
+    }
+    return Number::Operations::quotient(a, b);
+}
@@ -0,0 +1,137 @@
+#ifndef FLUXION_NUMBER_H
+#define FLUXION_NUMBER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "OutputSink.h"
+#include "util.h"
+
+#define NUMBER_MAX_POWER_BITS 65536 // Exact powers whose result would need more bits are left unevaluated.
+
+enum NumberKind : std::uint8_t {
+    NUMBER_SMALL, // An exact rational whose numerator and denominator fit in 64 bits.
+    NUMBER_BIG, // An exact rational too large for 64 bits.
+    NUMBER_REAL // A double, inexact.
+};
+
+enum NumberMode {
+    NUMBER_MODE_EXACT, // Literals are exact rationals, 0.1 is 1/10.
+    NUMBER_MODE_DOUBLE // Literals are doubles, so is any arithmetic involving them.
+};
+
+struct BigRational;
+
+/**
+ * A number that owns nothing and refers to no context, so it can be kept
+ * outside of one, such as in a file. The limbs of big numbers are stored
+ * separately, this only holds where they start.
+ */
+struct NumberRecord {
+    std::uint8_t kind; // NumberKind
+    std::uint8_t negative; // NUMBER_BIG
+    std::uint16_t reserved;
+    std::uint32_t numeratorLength; // Limbs of the numerator, NUMBER_BIG
+    std::uint64_t first; // Numerator, bits of the double, or index of the first limb.
+    std::uint64_t second; // Denominator, or limbs of the denominator.
+};
+
+/**
+ * An exact rational or a double. Rationals are always reduced, with a
+ * positive denominator, and are held inline while both parts fit in 64
+ * bits. Arithmetic on them is overflow checked and moves to a bignum only
+ * when it would overflow, bignums are allocated from the arena of the
+ * current context. Any arithmetic involving a double gives a double.
+ *
+ * Numbers are plain values, copying one never allocates.
+ */
+class Number {
+private:
+    struct Small {
+        std::int64_t numerator; // Never INT64_MIN, so it can always be negated.
+        std::int64_t denominator;
+    };
+    struct Operations;
+    NumberKind kind;
+    union {
+        Small small;
+        const BigRational *big;
+        double inexact;
+    };
+public:
+    static Number integer(std::int64_t value);
+    /**
+     * @return numerator / denominator reduced, a division by 0 gives a double like it would.
+     */
+    static Number rational(std::int64_t numerator, std::int64_t denominator);
+    static Number real(double value);
+    /**
+     * @return value as an exact integer if it is one, a double otherwise.
+     */
+    static Number fromDouble(double value);
+    /**
+     * Parse digits with an optional fraction exactly, 0.1 gives 1/10.
+     */
+    static Number parse(const char *text, std::size_t length);
+    /**
+     * @return a ^ b, false if both are exact but the result is irrational, or too large.
+     */
+    static bool power(const Number &a, const Number &b, Number &result);
+    /**
+     * Total order, by value, an exact number comes before a double of the
+     * same value and NaN comes last.
+     */
+    static int compare(const Number &a, const Number &b);
+    /**
+     * @return a number stored in a record, its big limbs starting at limbs[record.first],
+     * false if the record is malformed.
+     */
+    static bool restore(const NumberRecord &record, const std::uint32_t *limbs, std::size_t limbCount, Number &number);
+    inline NumberKind getKind() const {return kind;}
+    inline bool isExact() const {return kind != NUMBER_REAL;}
+    /**
+     * @return true if it is an integer, exact or not.
+     */
+    bool isInteger() const;
+    /**
+     * @param value Set to the number, if it is an exact integer that fits in 64 bits.
+     * @return false if it is not one.
+     */
+    bool toInteger(std::int64_t &value) const;
+    bool isZero() const;
+    bool isOne() const;
+    /**
+     * @return -1, 0 or 1, 0 for NaN as well.
+     */
+    int sign() const;
+    /**
+     * @return the closest double.
+     */
+    double toDouble() const;
+    /**
+     * @return true if it is the same constant, NaN is the same as NaN and 0 as -0.
+     */
+    bool identical(const Number &other) const;
+    hash_t hash() const;
+    /**
+     * @return true if it is printed as a quotient, such as 1/3, rather than as a single number.
+     */
+    bool isPrintedAsQuotient() const;
+    /**
+     * Print the number so it reads back as the same number, rationals
+     * with a short decimal expansion are printed as decimals.
+     */
+    void write(OutputSink &sink) const;
+    /**
+     * @param limbs Limbs of big numbers are appended to it.
+     */
+    NumberRecord record(std::vector<std::uint32_t> &limbs) const;
+    Number operator-() const;
+    friend Number operator+(const Number &a, const Number &b);
+    friend Number operator-(const Number &a, const Number &b);
+    friend Number operator*(const Number &a, const Number &b);
+    friend Number operator/(const Number &a, const Number &b);
+    Number() = default;
+};
+
+#endif //FLUXION_NUMBER_H
@@ -0,0 +1,314 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "NumberFormat.h"
+
+#define GRISU_MIN_EXPONENT (-60) // Binary exponent range of scaled numbers, so the digits before the
+#define GRISU_MAX_EXPONENT (-32) // point fit in 32 bits and the ones after it in 60 bits.
+#define CACHED_POWER_MIN_DECIMAL_EXPONENT (-300)
+#define CACHED_POWER_DECIMAL_STEP 8
+#define POSITIONAL_MAX_EXPONENT 21 // Numbers below 1e21 are printed without an exponent.
+#define POSITIONAL_MIN_EXPONENT (-6) // Numbers from 1e-7 are printed without an exponent.
+
+namespace {
+    /**
+     * A floating point number with a 64 bit significand, f * 2 ^ e.
+     */
+    struct DiyFp {
+        std::uint64_t f;
+        int e;
+    };
+
+    /**
+     * Normalised power of ten, f * 2 ^ e rounded from 10 ^ k.
+     */
+    struct CachedPower {
+        std::uint64_t f;
+        int e;
+        int k;
+    };
+
+    const CachedPower cachedPowers[] = {
+        {0xAB70FE17C79AC6CAULL, -1060, -300},
+        {0xFF77B1FCBEBCDC4FULL, -1034, -292},
+        {0xBE5691EF416BD60CULL, -1007, -284},
+        {0x8DD01FAD907FFC3CULL, -980, -276},
+        {0xD3515C2831559A83ULL, -954, -268},
+        {0x9D71AC8FADA6C9B5ULL, -927, -260},
+        {0xEA9C227723EE8BCBULL, -901, -252},
+        {0xAECC49914078536DULL, -874, -244},
+        {0x823C12795DB6CE57ULL, -847, -236},
+        {0xC21094364DFB5637ULL, -821, -228},
+        {0x9096EA6F3848984FULL, -794, -220},
+        {0xD77485CB25823AC7ULL, -768, -212},
+        {0xA086CFCD97BF97F4ULL, -741, -204},
+        {0xEF340A98172AACE5ULL, -715, -196},
+        {0xB23867FB2A35B28EULL, -688, -188},
+        {0x84C8D4DFD2C63F3BULL, -661, -180},
+        {0xC5DD44271AD3CDBAULL, -635, -172},
+        {0x936B9FCEBB25C996ULL, -608, -164},
+        {0xDBAC6C247D62A584ULL, -582, -156},
+        {0xA3AB66580D5FDAF6ULL, -555, -148},
+        {0xF3E2F893DEC3F126ULL, -529, -140},
+        {0xB5B5ADA8AAFF80B8ULL, -502, -132},
+        {0x87625F056C7C4A8BULL, -475, -124},
+        {0xC9BCFF6034C13053ULL, -449, -116},
+        {0x964E858C91BA2655ULL, -422, -108},
+        {0xDFF9772470297EBDULL, -396, -100},
+        {0xA6DFBD9FB8E5B88FULL, -369, -92},
+        {0xF8A95FCF88747D94ULL, -343, -84},
+        {0xB94470938FA89BCFULL, -316, -76},
+        {0x8A08F0F8BF0F156BULL, -289, -68},
+        {0xCDB02555653131B6ULL, -263, -60},
+        {0x993FE2C6D07B7FACULL, -236, -52},
+        {0xE45C10C42A2B3B06ULL, -210, -44},
+        {0xAA242499697392D3ULL, -183, -36},
+        {0xFD87B5F28300CA0EULL, -157, -28},
+        {0xBCE5086492111AEBULL, -130, -20},
+        {0x8CBCCC096F5088CCULL, -103, -12},
+        {0xD1B71758E219652CULL, -77, -4},
+        {0x9C40000000000000ULL, -50, 4},
+        {0xE8D4A51000000000ULL, -24, 12},
+        {0xAD78EBC5AC620000ULL, 3, 20},
+        {0x813F3978F8940984ULL, 30, 28},
+        {0xC097CE7BC90715B3ULL, 56, 36},
+        {0x8F7E32CE7BEA5C70ULL, 83, 44},
+        {0xD5D238A4ABE98068ULL, 109, 52},
+        {0x9F4F2726179A2245ULL, 136, 60},
+        {0xED63A231D4C4FB27ULL, 162, 68},
+        {0xB0DE65388CC8ADA8ULL, 189, 76},
+        {0x83C7088E1AAB65DBULL, 216, 84},
+        {0xC45D1DF942711D9AULL, 242, 92},
+        {0x924D692CA61BE758ULL, 269, 100},
+        {0xDA01EE641A708DEAULL, 295, 108},
+        {0xA26DA3999AEF774AULL, 322, 116},
+        {0xF209787BB47D6B85ULL, 348, 124},
+        {0xB454E4A179DD1877ULL, 375, 132},
+        {0x865B86925B9BC5C2ULL, 402, 140},
+        {0xC83553C5C8965D3DULL, 428, 148},
+        {0x952AB45CFA97A0B3ULL, 455, 156},
+        {0xDE469FBD99A05FE3ULL, 481, 164},
+        {0xA59BC234DB398C25ULL, 508, 172},
+        {0xF6C69A72A3989F5CULL, 534, 180},
+        {0xB7DCBF5354E9BECEULL, 561, 188},
+        {0x88FCF317F22241E2ULL, 588, 196},
+        {0xCC20CE9BD35C78A5ULL, 614, 204},
+        {0x98165AF37B2153DFULL, 641, 212},
+        {0xE2A0B5DC971F303AULL, 667, 220},
+        {0xA8D9D1535CE3B396ULL, 694, 228},
+        {0xFB9B7CD9A4A7443CULL, 720, 236},
+        {0xBB764C4CA7A44410ULL, 747, 244},
+        {0x8BAB8EEFB6409C1AULL, 774, 252},
+        {0xD01FEF10A657842CULL, 800, 260},
+        {0x9B10A4E5E9913129ULL, 827, 268},
+        {0xE7109BFBA19C0C9DULL, 853, 276},
+        {0xAC2820D9623BF429ULL, 880, 284},
+        {0x80444B5E7AA7CF85ULL, 907, 292},
+        {0xBF21E44003ACDD2DULL, 933, 300},
+        {0x8E679C2F5E44FF8FULL, 960, 308},
+        {0xD433179D9C8CB841ULL, 986, 316},
+        {0x9E19DB92B4E31BA9ULL, 1013, 324},
+    };
+
+    /**
+     * @return the product, with its significand rounded to 64 bits.
+     */
+    inline DiyFp multiply(DiyFp x, DiyFp y) {
+        unsigned __int128 product = (unsigned __int128) x.f * y.f;
+        auto high = (std::uint64_t) (product >> 64);
+        auto low = (std::uint64_t) product;
+        return {high + (low >> 63), x.e + y.e + 64};
+    }
+
+    inline DiyFp normalize(DiyFp x) {
+        int shift = __builtin_clzll(x.f);
+        return {x.f << shift, x.e - shift};
+    }
+
+    /**
+     * A positive double, and the bounds of the numbers that round to it,
+     * all normalised to the same exponent.
+     */
+    struct Boundaries {
+        DiyFp value;
+        DiyFp lower;
+        DiyFp upper;
+    };
+
+    Boundaries boundariesOf(double number) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        std::uint64_t fraction = bits & ((1ULL << 52) - 1);
+        auto biasedExponent = (int) (bits >> 52);
+        DiyFp value = biasedExponent == 0 ? DiyFp {fraction, 1 - 1075} : DiyFp {fraction | (1ULL << 52), biasedExponent - 1075};
+        // Above a power of two, the next double below is twice as close as the next one above.
+        bool lowerIsCloser = fraction == 0 && biasedExponent > 1;
+        DiyFp upper = normalize({(value.f << 1) + 1, value.e - 1});
+        DiyFp lower = lowerIsCloser ? DiyFp {(value.f << 2) - 1, value.e - 2} : DiyFp {(value.f << 1) - 1, value.e - 1};
+        lower.f <<= lower.e - upper.e;
+        lower.e = upper.e;
+        return {normalize(value), lower, upper};
+    }
+
+    /**
+     * @return the cached power c such that c * 2 ^ e has its exponent in the Grisu range.
+     */
+    const CachedPower &cachedPowerFor(int e) {
+        int f = GRISU_MIN_EXPONENT - e - 1;
+        int k = (f * 78913) / (1 << 18) + (f > 0 ? 1 : 0); // ceil(f * log10(2))
+        int index = (k - CACHED_POWER_MIN_DECIMAL_EXPONENT + CACHED_POWER_DECIMAL_STEP - 1) / CACHED_POWER_DECIMAL_STEP;
+        return cachedPowers[index];
+    }
+
+    /**
+     * Move the last digit towards the exact value as long as the digits stay inside the interval.
+     *
+     * @param distance Distance from the upper bound to the exact value.
+     * @param delta Width of the interval.
+     * @param rest Distance from the upper bound to the digits.
+     * @param step Value of a unit of the last digit.
+     */
+    void roundDigits(char *digits, int length, std::uint64_t distance, std::uint64_t delta, std::uint64_t rest, std::uint64_t step) {
+        while (rest < distance && delta - rest >= step && (rest + step < distance || distance - rest > rest + step - distance)) {
+            digits[length - 1]--;
+            rest += step;
+        }
+    }
+
+    /**
+     * Generate the shortest digits of a number inside the interval (lower, upper),
+     * all three scaled so their exponent is in the Grisu range.
+     *
+     * @param exponent Decimal exponent of the scaling, the exponent of the last digit on return.
+     */
+    void generateDigits(char *digits, int &length, int &exponent, DiyFp lower, DiyFp value, DiyFp upper) {
+        std::uint64_t delta = upper.f - lower.f;
+        std::uint64_t distance = upper.f - value.f;
+        int shift = -upper.e;
+        std::uint64_t one = 1ULL << shift;
+        auto integral = (std::uint32_t) (upper.f >> shift);
+        std::uint64_t fractional = upper.f & (one - 1);
+        std::uint32_t divisor = 1;
+        int remaining = 1;
+        while (remaining < 10 && integral / divisor >= 10) {
+            divisor *= 10;
+            remaining++;
+        }
+        while (remaining > 0) {
+            digits[length++] = (char) ('0' + integral / divisor);
+            integral %= divisor;
+            remaining--;
+            std::uint64_t rest = ((std::uint64_t) integral << shift) + fractional;
+            if (rest <= delta) {
+                exponent += remaining;
+                roundDigits(digits, length, distance, delta, rest, (std::uint64_t) divisor << shift);
+                return;
+            }
+            divisor /= 10;
+        }
+        do {
+            fractional *= 10;
+            digits[length++] = (char) ('0' + (fractional >> shift));
+            fractional &= one - 1;
+            exponent--;
+            delta *= 10;
+            distance *= 10;
+        } while (fractional > delta);
+        roundDigits(digits, length, distance, delta, fractional, one);
+    }
+
+    /**
+     * Print the digits of a positive number, in the same layout as JavaScript does.
+     *
+     * @param exponent Decimal exponent of the last digit.
+     */
+    std::size_t layoutDigits(const char *digits, int length, int exponent, char *buffer) {
+        int point = length + exponent; // Number of digits before the decimal point.
+        char *c = buffer;
+        if (length <= point && point <= POSITIONAL_MAX_EXPONENT) {
+            std::memcpy(c, digits, length);
+            c += length;
+            std::memset(c, '0', point - length);
+            c += point - length;
+        } else if (0 < point && point <= POSITIONAL_MAX_EXPONENT) {
+            std::memcpy(c, digits, point);
+            c += point;
+            *c++ = '.';
+            std::memcpy(c, digits + point, length - point);
+            c += length - point;
+        } else if (POSITIONAL_MIN_EXPONENT < point && point <= 0) {
+            *c++ = '0';
+            *c++ = '.';
+            std::memset(c, '0', -point);
+            c += -point;
+            std::memcpy(c, digits, length);
+            c += length;
+        } else {
+            *c++ = digits[0];
+            if (length > 1) {
+                *c++ = '.';
+                std::memcpy(c, digits + 1, length - 1);
+                c += length - 1;
+            }
+            int power = point - 1;
+            *c++ = 'e';
+            *c++ = power < 0 ? '-' : '+';
+            power = power < 0 ? -power : power;
+            if (power >= 100) {
+                *c++ = (char) ('0' + power / 100);
+            }
+            if (power >= 10) {
+                *c++ = (char) ('0' + power / 10 % 10);
+            }
+            *c++ = (char) ('0' + power % 10);
+        }
+        return c - buffer;
+    }
+
+    std::size_t formatInteger(std::uint64_t value, char *buffer) {
+        char digits[20];
+        int length = 0;
+        do {
+            digits[length++] = (char) ('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        for (int i = 0; i < length; i++) {
+            buffer[i] = digits[length - 1 - i];
+        }
+        return length;
+    }
+}
+
+std::size_t formatNumber(double value, char *buffer) {
+    if (std::isnan(value)) {
+        std::memcpy(buffer, "nan", 3);
+        return 3;
+    }
+    std::size_t length = 0;
+    if (value < 0) {
+        buffer[length++] = '-';
+        value = -value;
+    }
+    if (std::isinf(value)) {
+        std::memcpy(buffer + length, "inf", 3);
+        return length + 3;
+    }
+    if (value < 9007199254740992.0 && value == std::floor(value)) { // Integers below 2^53 are exact.
+        return length + formatInteger((std::uint64_t) value, buffer + length);
+    }
+    Boundaries boundaries = boundariesOf(value);
+    const CachedPower &power = cachedPowerFor(boundaries.upper.e);
+    DiyFp scale {power.f, power.e};
+    DiyFp scaled = multiply(boundaries.value, scale);
+    DiyFp lower = multiply(boundaries.lower, scale);
+    DiyFp upper = multiply(boundaries.upper, scale);
+    // The scaled bounds are off by at most one unit, so the interval is narrowed
+    // by one unit on each side, and any digits inside it read back as the value.
+    lower.f++;
+    upper.f--;
+    char digits[20];
+    int digitCount = 0;
+    int exponent = -power.k;
+    generateDigits(digits, digitCount, exponent, lower, scaled, upper);
+    return length + layoutDigits(digits, digitCount, exponent, buffer + length);
+}
@@ -0,0 +1,21 @@
+#ifndef FLUXION_NUMBERFORMAT_H
+#define FLUXION_NUMBERFORMAT_H
+#include <cstddef>
+
+#define NUMBER_FORMAT_BUFFER_SIZE 32 // Longer than any printed number, such as -1.2345678901234567e-308.
+
+/**
+ * Print a number with the fewest digits that read back as the same double,
+ * so 0.1 is printed as 0.1 rather than 0.1000000000000000055. Digits are
+ * found with Grisu2, using only integer arithmetic, which in rare cases
+ * prints one digit more than needed, and integers below 2^53 are printed
+ * directly. Numbers from 1e-7 up to 1e21 are printed without an
+ * exponent, others as 1e+21, and NaN and infinities as nan and inf.
+ *
+ * @param value Number to print, -0 is printed as 0.
+ * @param buffer At least NUMBER_FORMAT_BUFFER_SIZE characters, the text is not terminated.
+ * @return number of characters written.
+ */
+std::size_t formatNumber(double value, char *buffer);
+
+#endif //FLUXION_NUMBERFORMAT_H
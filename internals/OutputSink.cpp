@@ -0,0 +1,38 @@
+#include <algorithm>
+#include "OutputSink.h"
+
+StringSink::StringSink(std::string &output) : output(output) {
+
+}
+
+void StringSink::write(const char *text, std::size_t length) {
+    this->output.append(text, length);
+}
+
+StreamSink::StreamSink(std::ostream &stream) : stream(stream) {
+
+}
+
+void StreamSink::write(const char *text, std::size_t length) {
+    this->stream.write(text, (std::streamsize) length);
+}
+
+BufferSink::BufferSink(char *buffer, std::size_t capacity) : buffer(buffer), capacity(capacity), length(0) {
+
+}
+
+void BufferSink::write(const char *text, std::size_t length) {
+    if (this->length < this->capacity) {
+        std::size_t fitting = std::min(length, this->capacity - this->length);
+        std::memcpy(this->buffer + this->length, text, fitting);
+    }
+    this->length += length;
+}
+
+std::size_t BufferSink::getLength() const {
+    return this->length;
+}
+
+bool BufferSink::isComplete() const {
+    return this->length <= this->capacity;
+}
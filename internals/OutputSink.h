@@ -0,0 +1,78 @@
+#ifndef FLUXION_OUTPUTSINK_H
+#define FLUXION_OUTPUTSINK_H
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+/**
+ * Destination of printed text. Text is written to the sink piece by piece
+ * as soon as it is known, so printing builds no intermediate strings.
+ */
+class OutputSink {
+public:
+    /**
+     * Append text to the output.
+     *
+     * @param text Text to append, not terminated.
+     * @param length Number of characters to append.
+     */
+    virtual void write(const char *text, std::size_t length) = 0;
+    inline void write(const char *text) {this->write(text, std::strlen(text));}
+    virtual ~OutputSink() = default;
+};
+
+/**
+ * Appends to a string owned by the caller, which can be reserved in
+ * advance and reused so printing does not allocate.
+ */
+class StringSink : public OutputSink {
+private:
+    std::string &output;
+public:
+    using OutputSink::write;
+    void write(const char *text, std::size_t length) override;
+    explicit StringSink(std::string &output);
+};
+
+/**
+ * Writes to a stream, such as a file or std::cout.
+ */
+class StreamSink : public OutputSink {
+private:
+    std::ostream &stream;
+public:
+    using OutputSink::write;
+    void write(const char *text, std::size_t length) override;
+    explicit StreamSink(std::ostream &stream);
+};
+
+/**
+ * Writes to a fixed buffer owned by the caller and never allocates. Text
+ * that does not fit is dropped but still counted, so the caller can retry
+ * with a buffer of the right size.
+ */
+class BufferSink : public OutputSink {
+private:
+    char *buffer;
+    std::size_t capacity;
+    std::size_t length;
+public:
+    using OutputSink::write;
+    void write(const char *text, std::size_t length) override;
+    /**
+     * @return number of characters written so far, including the dropped ones.
+     */
+    std::size_t getLength() const;
+    /**
+     * @return true if nothing was dropped.
+     */
+    bool isComplete() const;
+    /**
+     * @param buffer Buffer to write to, the text is not terminated.
+     * @param capacity Size of the buffer.
+     */
+    BufferSink(char *buffer, std::size_t capacity);
+};
+
+#endif //FLUXION_OUTPUTSINK_H
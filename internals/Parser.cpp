@@ -1,158 +1,153 @@
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include "Parser.h"
+#include "Context.h"
+#include "Instrumentation.h"
 
-TokenType Token::getTokenType() const {
-    return this->type;
-}
-
-int Token::getLocation() const {
-    return this->location;
-}
-
-int Token::getIndex() const {
-    return this->index;
-}
-
-Token::Token(TokenType type, int location, int index) : type(type), location(location), index(index) {
-
-}
-
-
-ConstantToken::ConstantToken(int location, int index, double value) : value(value), Token(TOKEN_CONSTANT, location, index) {
-
-}
-
-double ConstantToken::getValue() const {
-    return this->value;
-}
-
-
-const char *VariableToken::getName() const {
-    return this->name.c_str();
-}
-
-VariableToken::VariableToken(int location, int index, std::string name) : name(name), Token(TOKEN_VARIABLE, location, index) {
-}
-
-
-OperationType OperatorToken::getOperationType() const {
-    return this->opType;
-}
+#define MAX_EXACT_DIGITS 15 // Mantissas with up to this many digits are exact doubles.
+#define MAX_EXACT_POWER 22 // Largest power of ten that is an exact double.
 
-OperatorToken::OperatorToken(int location, int index, OperationType operationType) : opType(operationType), Token(TOKEN_OPERATOR, location, index) {
+namespace {
+    const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
 
-}
-
-char Parser::peek() {
-    return *instructionPointer;
-}
-
-void Parser::consume() {
-    instructionPointer++;
-}
+    inline bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
 
-void Parser::pop() {
-    currentToken = currentToken + *instructionPointer;
-    consume();
-}
+    inline bool isIdentifierStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
 
-bool Parser::isTerminator() {
-    return typing::isOperator(instructionPointer) || contains("()\t\n ", instructionPointer) || *instructionPointer == '\0';
+    inline bool isIdentifierPart(char c) {
+        return isIdentifierStart(c) || isDigit(c);
+    }
 }
 
-OperationType Parser::determineOperatorType() {
-    switch(*currentToken.c_str()) {
-        case '+':
-            return OP_ADD;
-        case '-':
-            return OP_MIN;
-        case '*':
-            return OP_MUL;
-        case '^':
-            return OP_EXP;
-        case '/':
-            return OP_DIV;
-        default:
-            return OP_ERR;
+void Parser::consumeRedundant() {
+    while (peek() == ' ' || peek() == '\t' || peek() == '\n' || peek() == '\r') {
+        consume();
     }
 }
 
-TokenType Parser::determineTokenType() {
-    if (typing::isNumber(currentToken.c_str())) {
-        return TOKEN_CONSTANT;
-    } else if (typing::isIdentifier(currentToken.c_str())) {
-        return TOKEN_VARIABLE;
-    } else if (currentToken == "(") {
-        return TOKEN_LEFT_PAREN;
-    } else if (currentToken == ")") {
-        return TOKEN_RIGHT_PAREN;
-    } else if (typing::isOperator(currentToken.c_str())) {
-        return TOKEN_OPERATOR;
+bool Parser::consumeNumber(Token &token) {
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = 0;
+    for (; isDigit(peek()); consume()) {
+        mantissa = mantissa * 10 + (peek() - '0');
+        digits += (mantissa != 0); // Leading zeros do not count.
+    }
+    if (peek() == '.') {
+        consume();
+        if (!isDigit(peek())) {
+            return false; // There must be digits after the dot.
+        }
+        for (; isDigit(peek()); consume(), fractionDigits++) {
+            mantissa = mantissa * 10 + (peek() - '0');
+            digits += (mantissa != 0);
+        }
+    }
+    if (Context::current().numberMode == NUMBER_MODE_EXACT) {
+        token.value = Number::parse(source + token.location, (instructionPointer - source) - token.location);
+    } else if (digits <= MAX_EXACT_DIGITS && fractionDigits <= MAX_EXACT_POWER) {
+        // Both the mantissa and the power are exact, so the division is correctly rounded.
+        token.value = Number::real((double) mantissa / powersOfTen[fractionDigits]);
     } else {
-        return TOKEN_UNDEFINED;
+        token.value = Number::real(std::strtod(source + token.location, nullptr));
     }
+    return true;
 }
 
-TokenType Parser::consumeToken() {
-    do {
-        pop();
-    } while (!isTerminator()); // Do while so we can get terminating tokens too.
-    return determineTokenType();
-}
-
-void Parser::consumeRedundant() {
-    while(typing::isWhiteSpace(instructionPointer)) {
+void Parser::consumeIdentifier(Token &token) {
+    const char *name = instructionPointer;
+    while (isIdentifierPart(peek())) {
         consume();
     }
+    token.symbol = SymbolTable::global().intern({name, (std::size_t) (instructionPointer - name)});
 }
 
 ParsingStatus Parser::parseToken() {
-    TokenType currentTokenType;
-    currentTokenType = consumeToken(); // This sets the currentToken to the string rep of the token.
-    Token *newToken;
-    int index = tokens.size();
-    int location = (long) (instructionPointer - source);
-    // Time to generate a new token.
-    switch(currentTokenType) {
-        case TOKEN_CONSTANT:
-            newToken = new ConstantToken(location, index, std::atof(currentToken.c_str()));
-            break;
-        case TOKEN_VARIABLE:
-            newToken = new VariableToken(location, index, currentToken);
-            break;
-        case TOKEN_OPERATOR:
-            newToken = new OperatorToken(location, index, determineOperatorType());
-            break;
-        case TOKEN_LEFT_PAREN:
-        case TOKEN_RIGHT_PAREN:
-            newToken = new Token(currentTokenType, location, index);
-            break;
-        case TOKEN_UNDEFINED:
+    Token token;
+    token.location = (std::uint32_t) (instructionPointer - source);
+    char c = peek();
+    if (isDigit(c)) {
+        token.type = TOKEN_CONSTANT;
+        if (!consumeNumber(token)) {
             return PARSING_FAILED;
-    }
-    tokens.push_back(newToken);
-    if (*instructionPointer == '\0') {
-        return PARSING_COMPLETED; // At the end of the string.
+        }
+    } else if (isIdentifierStart(c)) {
+        token.type = TOKEN_VARIABLE;
+        consumeIdentifier(token);
     } else {
-        return PARSING_IN_PROGRESS;
+        switch (c) {
+            case '+':
+                token.opType = OP_ADD;
+                break;
+            case '-':
+                token.opType = OP_MIN;
+                break;
+            case '*':
+                token.opType = OP_MUL;
+                break;
+            case '^':
+                token.opType = OP_EXP;
+                break;
+            case '/':
+                token.opType = OP_DIV;
+                break;
+            case '(':
+                token.type = TOKEN_LEFT_PAREN;
+                deepest = std::max(deepest, ++nesting);
+                break;
+            case ')':
+                token.type = TOKEN_RIGHT_PAREN;
+                nesting -= nesting != 0; // Unbalanced parentheses are reported by the compiler.
+                break;
+            default:
+                return PARSING_FAILED; // Malformed token.
+        }
+        if (c != '(' && c != ')') {
+            token.type = TOKEN_OPERATOR;
+        }
+        consume();
     }
+    token.length = (std::uint32_t) (instructionPointer - source) - token.location;
+    tokens.push_back(token);
+    return peek() == '\0' ? PARSING_COMPLETED : PARSING_IN_PROGRESS;
 }
 
 ParsingStatus Parser::parse() {
-    ParsingStatus currentStatus;
-    do {
-      currentStatus = parseToken();
-      currentToken = "";
-      consumeRedundant(); // If pointer is on whitespace, bring it to a usable character.
-    } while(currentStatus == PARSING_IN_PROGRESS);
+    Instrumentation::Scope scope {PHASE_PARSE};
+    ParsingStatus currentStatus = PARSING_IN_PROGRESS;
+    tokens.clear();
+    instructionPointer = source;
+    nesting = 0;
+    deepest = 0;
+    consumeRedundant();
+    if (peek() == '\0') {
+        return PARSING_FAILED; // Nothing to parse.
+    }
+    while (currentStatus == PARSING_IN_PROGRESS) {
+        currentStatus = parseToken();
+        consumeRedundant(); // If pointer is on whitespace, bring it to a usable character.
+        if (currentStatus == PARSING_IN_PROGRESS && peek() == '\0') {
+            currentStatus = PARSING_COMPLETED; // Trailing whitespace.
+        }
+    }
+    Instrumentation::count(COUNTER_TOKENS, tokens.size());
+    Instrumentation::reportDepth(PHASE_PARSE, deepest);
     return currentStatus;
 }
 
-std::vector<Token*> Parser::getTokens() {
+const std::vector<Token> &Parser::getTokens() const {
     return this->tokens;
 }
 
-Parser::Parser(const char *source) {
-    this->source = source;
-    this->instructionPointer = (char *) source;
-}
\ No newline at end of file
+Parser::Parser(const char *source) : source(source), instructionPointer(source), nesting(0), deepest(0) {
+    // Most tokens are separated by at least one character, this avoids most reallocations.
+    tokens.reserve(std::strlen(source) / 2 + 1);
+}
@@ -1,11 +1,12 @@
 #ifndef FLUXION_PARSER_H
 #define FLUXION_PARSER_H
 
+#include <cstdint>
 #include <vector>
 #include "Expression.h"
 #include "util.h"
 
-enum TokenType {
+enum TokenType : std::uint8_t {
     TOKEN_CONSTANT,
     TOKEN_VARIABLE,
     TOKEN_OPERATOR,
@@ -21,90 +22,57 @@ enum ParsingStatus {
 };
 
 /**
- * This class represents a Token.
+ * This class represents a Token, tokens are plain values stored
+ * contiguously, the value of the token is held inline depending on
+ * its type.
  */
-class Token {
-private:
-    const TokenType type;
-    const int location; // Location in raw string.
-    const int index; // Index among tokens.
-public:
-    TokenType getTokenType() const;
-    int getLocation() const;
-    int getIndex() const;
-    virtual ~Token() = default;
-    Token(TokenType type, int location, int index);
-};
-
-class ConstantToken : public Token {
-private:
-    const double value;
-public:
-    ConstantToken(int location, int index, double value);
-    double getValue() const;
-};
+struct Token {
+    std::uint32_t location; // Location in raw string.
+    std::uint32_t length; // Length in raw string.
+    union {
+        Number value; // TOKEN_CONSTANT
+        OperationType opType; // TOKEN_OPERATOR
+        symbol_t symbol; // TOKEN_VARIABLE, interned once while lexing.
+    };
+    TokenType type;
 
-class VariableToken : public Token {
-private:
-    std::string name; // Variables has single character names.
-public:
-    const char *getName() const;
-    VariableToken(int location, int index, std::string name);
-};
-
-class OperatorToken : public Token {
-private:
-    const OperationType opType;
-public:
-    OperationType getOperationType() const;
-    OperatorToken(int location, int index, OperationType operationType);
+    inline TokenType getTokenType() const {return type;}
+    inline int getLocation() const {return (int) location;}
+    inline const Number &getValue() const {return value;}
+    inline OperationType getOperationType() const {return opType;}
+    inline symbol_t getSymbol() const {return symbol;}
 };
 
 class Parser {
 private:
     const char *source;
-    char *instructionPointer;
-    std::string currentToken;
-    std::vector<Token*> tokens;
+    const char *instructionPointer;
+    std::vector<Token> tokens;
+    std::uint32_t nesting; // Parentheses open before the instruction pointer.
+    std::uint32_t deepest; // Most parentheses open at once.
     /**
      * Peek at the current char.
      *
      * @return the current char.
      */
-    char peek();
-    /**
-     * Increment the character to the currentToken.
-     * the instruction pointer.
-     */
-    void pop();
+    inline char peek() const {return *instructionPointer;}
     /**
      * Consume the current char without
      * returning it.
      */
-    void consume();
-    /**
-     * Check if the current character is a terminator,
-     * that is, the border of which a token is finalised.
-     *
-     * @return true if the character is either an operator,
-     * left or right paranthesis or whitespace.
-     */
-    bool isTerminator();
-    OperationType determineOperatorType();
-    TokenType determineTokenType();
-    /**
-     * Consume a token, filling the current token
-     * with characters, return the token type.
-     * @return token type of the current token.
-     */
-    TokenType consumeToken();
+    inline void consume() {instructionPointer++;}
     /**
      * Consume reduntant terminal characters such as
      * whitespace.
-     *
-     * @return
      */
     void consumeRedundant();
+    /**
+     * Consume a number literal, digits with an optional fraction.
+     *
+     * @return false if the literal is malformed.
+     */
+    bool consumeNumber(Token &token);
+    void consumeIdentifier(Token &token);
     /**
      * Parse a single token, add it to the tokens vector.
      * @return the current parsing status.
@@ -118,10 +86,12 @@ public:
      */
     ParsingStatus parse();
     /**
-     * This must be ran after a successful parse.
+     * This must be ran after a successful parse, variable tokens carry
+     * their interned symbol, so the source need not outlive them.
+     *
      * @return the tokens vector.
      */
-    std::vector<Token*> getTokens();
+    const std::vector<Token> &getTokens() const;
     explicit Parser(const char *source);
 };
 
@@ -0,0 +1,696 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include "Polynomial.h"
+#include "DenseMultiplication.h"
+
+namespace {
+    /**
+     * Order of the terms of a polynomial, the highest powers first.
+     *
+     * @return negative if the first term comes first, positive if the second does, 0 if they have the same exponents.
+     */
+    int compareTerms(const Polynomial::Factor *a, std::size_t aCount, const Polynomial::Factor *b, std::size_t bCount) {
+        for (std::size_t i = 0; i < aCount && i < bCount; i++) {
+            if (a[i].atom != b[i].atom) {
+                return a[i].atom < b[i].atom ? -1 : 1; // The other term has that atom to the power 0.
+            }
+            if (a[i].exponent != b[i].exponent) {
+                return a[i].exponent > b[i].exponent ? -1 : 1;
+            }
+        }
+        return aCount == bCount ? 0 : (aCount > bCount ? -1 : 1);
+    }
+
+    /**
+     * Multiply two terms, both sorted by atom, so they are merged, adding the exponents of the atoms they share.
+     *
+     * @param product Set to the factors of the product.
+     */
+    void multiplyTerms(const Polynomial::Factor *a, std::size_t aCount, const Polynomial::Factor *b, std::size_t bCount,
+                       std::vector<Polynomial::Factor> &product) {
+        const Polynomial::Factor *aEnd = a + aCount;
+        const Polynomial::Factor *bEnd = b + bCount;
+        product.clear();
+        while (a != aEnd || b != bEnd) {
+            if (b == bEnd || (a != aEnd && a->atom < b->atom)) {
+                product.push_back(*a++);
+            } else if (a == aEnd || b->atom < a->atom) {
+                product.push_back(*b++);
+            } else {
+                product.push_back(Polynomial::Factor {a->atom, a->exponent + b->exponent});
+                a++;
+                b++;
+            }
+        }
+    }
+
+    /**
+     * Accumulates terms into arrays laid out like a polynomial, adding the
+     * coefficients of terms with the same exponents, found by hashing them.
+     */
+    class TermTable {
+    private:
+        std::vector<Polynomial::Factor> &factors;
+        std::vector<std::uint32_t> &starts;
+        std::vector<Number> &coefficients;
+        std::vector<std::uint32_t> slots; // Index of the term plus one, 0 if empty.
+        std::size_t mask;
+
+        static hash_t hash(const Polynomial::Factor *termFactors, std::size_t count) {
+            hash_t result = 0;
+            for (std::size_t i = 0; i < count; i++) {
+                result = hashCombine(hashCombine(result, termFactors[i].atom), termFactors[i].exponent);
+            }
+            return result;
+        }
+
+        std::size_t find(const Polynomial::Factor *termFactors, std::size_t count) const {
+            std::size_t i = hash(termFactors, count) & mask;
+            while (slots[i] != 0) {
+                std::uint32_t start = starts[slots[i] - 1];
+                if (compareTerms(factors.data() + start, starts[slots[i]] - start, termFactors, count) == 0) {
+                    break;
+                }
+                i = (i + 1) & mask;
+            }
+            return i;
+        }
+
+        void grow() {
+            slots.assign(slots.size() * 2, 0);
+            mask = slots.size() - 1;
+            for (std::size_t term = 0; term < coefficients.size(); term++) {
+                slots[find(factors.data() + starts[term], starts[term + 1] - starts[term])] = (std::uint32_t) term + 1;
+            }
+        }
+    public:
+        TermTable(std::vector<Polynomial::Factor> &factors, std::vector<std::uint32_t> &starts,
+                  std::vector<Number> &coefficients, std::size_t expectedTerms)
+            : factors(factors), starts(starts), coefficients(coefficients) {
+            std::size_t size = 16;
+            while (size < expectedTerms * 2) {
+                size <<= 1;
+            }
+            slots.assign(size, 0);
+            mask = size - 1;
+        }
+
+        void add(const Polynomial::Factor *termFactors, std::size_t count, const Number &coefficient) {
+            std::size_t slot = find(termFactors, count);
+            if (slots[slot] != 0) {
+                Number &sum = coefficients[slots[slot] - 1];
+                sum = sum + coefficient;
+                return;
+            }
+            factors.insert(factors.end(), termFactors, termFactors + count);
+            starts.push_back((std::uint32_t) factors.size());
+            coefficients.push_back(coefficient);
+            slots[slot] = (std::uint32_t) coefficients.size();
+            // Keep the load factor under a half, so probe sequences stay short.
+            if (coefficients.size() * 2 > slots.size()) {
+                grow();
+            }
+        }
+    };
+
+    /**
+     * @return an exact coefficient of a dense product as a number.
+     */
+    Number toNumber(const dense::WideInteger &value) {
+        if (value.high == (std::int64_t) value.low >> 63) {
+            return Number::integer((std::int64_t) value.low); // Fits in 64 bits.
+        }
+        Number half = Number::integer(std::int64_t(1) << 32);
+        return (Number::integer(value.high) * half + Number::integer((std::int64_t) (value.low >> 32))) * half
+            + Number::integer((std::int64_t) (value.low & 0xffffffffU));
+    }
+
+    /**
+     * @return true if the exponent is a power sums are expanded to.
+     */
+    bool isExpandedExponent(Expression *exponent) {
+        if (exponent->type != EXPRESSION_CONSTANT) {
+            return false;
+        }
+        double value = ((Constant*) exponent)->getValue();
+        return value >= 0 && value <= POLYNOMIAL_MAX_EXPONENT && value == std::floor(value);
+    }
+
+    /**
+     * @return true if an operation is expanded as part of the polynomial it is in, rather than kept as an atom.
+     */
+    bool isPolynomial(Operation *operation) {
+        OperationType opType = operation->getOperationType();
+        return opType == OP_ADD || opType == OP_MUL || opType == OP_MIN
+            || (opType == OP_EXP && isExpandedExponent(operation->getOperand(1)))
+            || (opType == OP_DIV && operation->getOperand(1)->type == EXPRESSION_CONSTANT);
+    }
+
+    /**
+     * @return number of operands of a polynomial operation that are polynomials, not an exponent or a divisor.
+     */
+    std::uint32_t getPolynomialOperandCount(Operation *operation) {
+        OperationType opType = operation->getOperationType();
+        return opType == OP_ADD || opType == OP_MUL || opType == OP_MIN ? operation->getOperandCount() : 1;
+    }
+
+    /**
+     * @return true if raising a polynomial with exact coefficients to a power
+     * keeps them under POLYNOMIAL_MAX_COEFFICIENT_BITS, each is at most the
+     * sum of the magnitudes of the coefficients of the base to that power.
+     */
+    bool isPowerSmall(const Polynomial &base, std::uint32_t exponent) {
+        double sum = 0;
+        for (std::size_t term = 0; term < base.getTermCount(); term++) {
+            if (!base.getCoefficient(term).isExact()) {
+                return true; // Real coefficients are checked once computed instead.
+            }
+            sum += std::fabs(base.getCoefficient(term).toDouble());
+        }
+        return sum <= 1 || exponent * std::log2(sum) <= POLYNOMIAL_MAX_COEFFICIENT_BITS;
+    }
+
+    /**
+     * @return false if a real coefficient overflowed to an infinity or a nan.
+     */
+    bool isFinite(const Polynomial &polynomial) {
+        for (std::size_t term = 0; term < polynomial.getTermCount(); term++) {
+            const Number &coefficient = polynomial.getCoefficient(term);
+            if (!coefficient.isExact() && !std::isfinite(coefficient.toDouble())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Expands an expression region by region. A region is a root and the
+     * polynomial operations under it, its leaves are constants and atoms,
+     * which are variables, operations that are not polynomials such as
+     * x ^ 0.5, and operations left unexpanded because their coefficients
+     * would not be finite or too large. An atom is rebuilt from its operands,
+     * each expanded as the root of a region of its own, or from their
+     * polynomials when it is left unexpanded while its region is expanded.
+     *
+     * Regions and atoms wait on an explicit stack for those they need, so
+     * deep expressions do not overflow the call stack.
+     */
+    class Expansion {
+    private:
+        struct Task {
+            Expression *expression;
+            bool atom; // Rebuild an atom, or expand the region rooted at the expression.
+        };
+        struct Region {
+            std::vector<Operation*> operations; // Polynomial operations of the region, operands first.
+            std::unordered_map<Expression*, std::uint32_t> uses; // Number of parents in the region of each operation still to be computed.
+            std::unordered_map<Expression*, Polynomial> values; // Of the operations computed and still used.
+            std::vector<Expression*> atoms; // Rebuilt.
+            std::unordered_map<Expression*, std::uint32_t> indices; // Of each atom, by the node in the original expression.
+
+            void addAtom(Expression *node, Expression *atom) {
+                indices[node] = (std::uint32_t) atoms.size();
+                atoms.push_back(atom);
+            }
+        };
+        std::unordered_map<Expression*, Expression*> expanded; // Of each region root.
+        std::unordered_map<Expression*, Expression*> atoms; // Rebuilt expression of each atom, including polynomial operations left unexpanded.
+        std::vector<Task> tasks;
+
+        bool isAtom(Expression *expression) const {
+            return expression->type == EXPRESSION_VARIABLE || !isPolynomial((Operation*) expression)
+                || atoms.count(expression) != 0;
+        }
+
+        /**
+         * @return false if the operands are not expanded yet, they are pushed to the tasks.
+         */
+        bool rebuildAtom(Operation *operation) {
+            bool ready = true;
+            std::vector<Expression*> operands;
+            for (std::uint32_t i = 0; i < operation->getOperandCount(); i++) {
+                auto operand = expanded.find(operation->getOperand(i));
+                if (operand == expanded.end()) {
+                    tasks.push_back(Task {operation->getOperand(i), false});
+                    ready = false;
+                } else {
+                    operands.push_back(operand->second);
+                }
+            }
+            if (ready) {
+                atoms[operation] = Operation::create(operation->getOperationType(), operands.data(), operands.size())->evaluate();
+            }
+            return ready;
+        }
+
+        /**
+         * List the operations and atoms of a region.
+         *
+         * @return false if an atom is not rebuilt yet, it is pushed to the tasks.
+         */
+        bool collect(Expression *root, Region &region) {
+            bool ready = true;
+            struct Visit {
+                Expression *expression;
+                bool expanded; // Operands pushed, so the operation comes next.
+            };
+            std::vector<Visit> stack {Visit {root, false}};
+            while (!stack.empty()) {
+                Visit visit = stack.back();
+                stack.pop_back();
+                Expression *expression = visit.expression;
+                if (visit.expanded) {
+                    region.operations.push_back((Operation*) expression);
+                } else if (expression->type == EXPRESSION_CONSTANT) {
+                    continue;
+                } else if (isAtom(expression)) {
+                    auto rebuilt = atoms.find(expression);
+                    if (region.indices.count(expression) != 0) {
+                        continue;
+                    } else if (expression->type == EXPRESSION_VARIABLE) {
+                        region.addAtom(expression, expression);
+                    } else if (rebuilt != atoms.end()) {
+                        region.addAtom(expression, rebuilt->second);
+                    } else {
+                        tasks.push_back(Task {expression, true});
+                        ready = false;
+                    }
+                } else if (region.uses[expression]++ == 0) {
+                    auto operation = (Operation*) expression;
+                    stack.push_back(Visit {expression, true});
+                    for (std::uint32_t i = getPolynomialOperandCount(operation); i-- > 0;) {
+                        stack.push_back(Visit {operation->getOperand(i), false});
+                    }
+                }
+            }
+            return ready;
+        }
+
+        /**
+         * @return the polynomial of an operand, moved out of the region once its last parent took it.
+         */
+        Polynomial take(Expression *operand, Region &region) {
+            if (operand->type == EXPRESSION_CONSTANT) {
+                return Polynomial::constant(((Constant*) operand)->getNumber());
+            }
+            auto atom = region.indices.find(operand);
+            if (atom != region.indices.end()) {
+                return Polynomial::atom(atom->second);
+            }
+            auto value = region.values.find(operand);
+            if (--region.uses[operand] != 0) {
+                return value->second;
+            }
+            Polynomial result = std::move(value->second);
+            region.values.erase(value);
+            return result;
+        }
+
+        /**
+         * Leave an operation unexpanded, as a new atom of the region rebuilt
+         * from the polynomials of its operands.
+         */
+        void keep(Operation *operation, const std::vector<Polynomial> &operands, Region &region) {
+            std::vector<Expression*> rebuilt;
+            for (std::uint32_t i = 0; i < operation->getOperandCount(); i++) {
+                rebuilt.push_back(i < operands.size() ? operands[i].toExpression(region.atoms)->evaluate() : operation->getOperand(i));
+            }
+            Expression *atom = Operation::create(operation->getOperationType(), rebuilt.data(), rebuilt.size())->evaluate();
+            atoms[operation] = atom;
+            region.addAtom(operation, atom);
+        }
+
+        /**
+         * @return false if the region needs atoms not rebuilt yet, they are pushed to the tasks.
+         */
+        bool expandRegion(Expression *root) {
+            if (root->type != EXPRESSION_OPERATION) {
+                expanded[root] = root;
+                return true;
+            }
+            Region region;
+            if (!collect(root, region)) {
+                return false;
+            }
+            std::vector<Polynomial> operands;
+            for (Operation *operation : region.operations) {
+                std::uint32_t count = getPolynomialOperandCount(operation);
+                operands.clear();
+                for (std::uint32_t i = 0; i < count; i++) {
+                    operands.push_back(take(operation->getOperand(i), region));
+                }
+                Polynomial result = operands[0];
+                bool expandable = true;
+                switch (operation->getOperationType()) {
+                    case OP_ADD:
+                        result = Polynomial::sum(operands);
+                        break;
+                    case OP_MUL:
+                        for (std::uint32_t i = 1; i < count; i++) {
+                            result = result * operands[i];
+                        }
+                        break;
+                    case OP_MIN:
+                        result = result + operands[1].scale(Number::integer(-1));
+                        break;
+                    case OP_DIV:
+                        result = result.scale(Number::integer(1) / ((Constant*) operation->getOperand(1))->getNumber());
+                        break;
+                    default: {
+                        auto exponent = (std::uint32_t) ((Constant*) operation->getOperand(1))->getValue();
+                        expandable = isPowerSmall(result, exponent);
+                        if (expandable) {
+                            result = result.power(exponent);
+                        }
+                    }
+                }
+                if (expandable && isFinite(result)) {
+                    region.values.emplace(operation, std::move(result));
+                } else {
+                    keep(operation, operands, region);
+                }
+            }
+            // Simplifying merges atoms that turned out to be related, such as x and x ^ -1.
+            expanded[root] = take(root, region).toExpression(region.atoms)->evaluate();
+            return true;
+        }
+    public:
+        Expression *expand(Expression *expression) {
+            tasks.push_back(Task {expression, false});
+            while (!tasks.empty()) {
+                Task task = tasks.back();
+                bool done = task.atom ? atoms.count(task.expression) != 0 || rebuildAtom((Operation*) task.expression)
+                    : expanded.count(task.expression) != 0 || expandRegion(task.expression);
+                // Tasks pushed meanwhile are above this one, it is retried once they are done.
+                if (done) {
+                    tasks.pop_back();
+                }
+            }
+            return expanded[expression];
+        }
+    };
+}
+
+Polynomial::Polynomial() : starts(1, 0) {
+
+}
+
+Polynomial Polynomial::constant(const Number &value) {
+    Polynomial result;
+    if (!value.isZero()) {
+        result.addTerm(nullptr, 0, value);
+    }
+    return result;
+}
+
+Polynomial Polynomial::atom(std::uint32_t index) {
+    Polynomial result;
+    Factor factor {index, 1};
+    result.addTerm(&factor, 1, Number::integer(1));
+    return result;
+}
+
+std::size_t Polynomial::getTermCount() const {
+    return this->coefficients.size();
+}
+
+const Number &Polynomial::getCoefficient(std::size_t term) const {
+    return this->coefficients[term];
+}
+
+const Polynomial::Factor *Polynomial::getFactors(std::size_t term) const {
+    return this->factors.data() + this->starts[term];
+}
+
+std::size_t Polynomial::getFactorCount(std::size_t term) const {
+    return this->starts[term + 1] - this->starts[term];
+}
+
+std::uint32_t Polynomial::getDegree(std::size_t term) const {
+    return getFactorCount(term) == 0 ? 0 : getFactors(term)->exponent;
+}
+
+void Polynomial::addTerm(const Factor *termFactors, std::size_t count, const Number &coefficient) {
+    factors.insert(factors.end(), termFactors, termFactors + count);
+    starts.push_back((std::uint32_t) factors.size());
+    coefficients.push_back(coefficient);
+}
+
+void Polynomial::normalize() {
+    std::vector<std::uint32_t> order(coefficients.size());
+    for (std::uint32_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    // Highest powers first, so x ^ 2 comes before x.
+    std::sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b) {
+        return compareTerms(getFactors(a), getFactorCount(a), getFactors(b), getFactorCount(b)) < 0;
+    });
+    Polynomial sorted;
+    sorted.factors.reserve(factors.size());
+    sorted.starts.reserve(starts.size());
+    sorted.coefficients.reserve(coefficients.size());
+    for (std::uint32_t term : order) {
+        std::size_t last = sorted.getTermCount();
+        if (last != 0 && compareTerms(getFactors(term), getFactorCount(term),
+                                      sorted.getFactors(last - 1), sorted.getFactorCount(last - 1)) == 0) {
+            sorted.coefficients[last - 1] = sorted.coefficients[last - 1] + coefficients[term];
+        } else {
+            sorted.addTerm(getFactors(term), getFactorCount(term), coefficients[term]);
+        }
+    }
+    *this = Polynomial {};
+    for (std::size_t term = 0; term < sorted.getTermCount(); term++) {
+        if (!sorted.coefficients[term].isZero()) {
+            addTerm(sorted.getFactors(term), sorted.getFactorCount(term), sorted.coefficients[term]);
+        }
+    }
+}
+
+Polynomial Polynomial::sum(const std::vector<Polynomial> &terms) {
+    if (terms.size() <= 2) {
+        // Merging sorted terms is cheaper than sorting them again.
+        return terms.empty() ? Polynomial {} : (terms.size() == 1 ? terms[0] : terms[0] + terms[1]);
+    }
+    std::size_t count = 0;
+    for (const Polynomial &term : terms) {
+        count += term.getTermCount();
+    }
+    Polynomial result;
+    TermTable table {result.factors, result.starts, result.coefficients, count};
+    for (const Polynomial &polynomial : terms) {
+        for (std::size_t term = 0; term < polynomial.getTermCount(); term++) {
+            table.add(polynomial.getFactors(term), polynomial.getFactorCount(term), polynomial.coefficients[term]);
+        }
+    }
+    result.normalize();
+    return result;
+}
+
+Polynomial Polynomial::operator+(const Polynomial &other) const {
+    // Both are sorted, so they are merged in a single pass.
+    Polynomial result;
+    result.factors.reserve(factors.size() + other.factors.size());
+    result.starts.reserve(starts.size() + other.starts.size());
+    result.coefficients.reserve(coefficients.size() + other.coefficients.size());
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < getTermCount() || j < other.getTermCount()) {
+        int order = 0;
+        if (i == getTermCount()) {
+            order = 1;
+        } else if (j == other.getTermCount()) {
+            order = -1;
+        } else {
+            order = compareTerms(getFactors(i), getFactorCount(i), other.getFactors(j), other.getFactorCount(j));
+        }
+        if (order < 0) {
+            result.addTerm(getFactors(i), getFactorCount(i), coefficients[i]);
+            i++;
+        } else if (order > 0) {
+            result.addTerm(other.getFactors(j), other.getFactorCount(j), other.coefficients[j]);
+            j++;
+        } else {
+            Number sum = coefficients[i] + other.coefficients[j];
+            if (!sum.isZero()) {
+                result.addTerm(getFactors(i), getFactorCount(i), sum);
+            }
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+bool Polynomial::isDense(std::uint32_t &atom) const {
+    if (getTermCount() < POLYNOMIAL_DENSE_MIN_TERMS) {
+        return false;
+    }
+    // The highest power comes first, so the first term tells which atom it would be.
+    if (getFactorCount(0) != 1 || getDegree(0) + 1 > 2 * getTermCount()) {
+        return false;
+    }
+    atom = getFactors(0)->atom;
+    for (std::size_t term = 0; term < getTermCount(); term++) {
+        if (getFactorCount(term) > 1 || (getFactorCount(term) == 1 && getFactors(term)->atom != atom)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Polynomial::multiplyDense(const Polynomial &other, std::uint32_t atom, Polynomial &result) const {
+    bool real = !coefficients[0].isExact();
+    double largest[2] = {0, 0};
+    auto toDense = [real](const Polynomial &polynomial, std::vector<double> &values,
+                          std::vector<std::int64_t> &integers, double &largest) {
+        std::size_t length = polynomial.getDegree(0) + 1;
+        values.assign(length, 0.0);
+        integers.assign(real ? 0 : length, 0);
+        for (std::size_t term = 0; term < polynomial.getTermCount(); term++) {
+            const Number &coefficient = polynomial.coefficients[term];
+            std::uint32_t degree = polynomial.getDegree(term);
+            if (real ? coefficient.isExact() : !coefficient.toInteger(integers[degree])) {
+                return false;
+            }
+            values[degree] = coefficient.toDouble();
+            largest = std::max(largest, std::fabs(values[degree]));
+        }
+        return true;
+    };
+    std::vector<double> a;
+    std::vector<double> b;
+    std::vector<std::int64_t> aIntegers;
+    std::vector<std::int64_t> bIntegers;
+    if (!toDense(*this, a, aIntegers, largest[0]) || !toDense(other, b, bIntegers, largest[1])) {
+        return false;
+    }
+    result = Polynomial {};
+    Factor factor {atom, 0};
+    std::size_t length = a.size() + b.size() - 1;
+    // Doubles are as exact as reals, and exact for integers as long as no sum of products exceeds 2^53.
+    // Karatsuba multiplies sums of halves, which are larger, so the bound counts the length twice.
+    auto shorter = (double) std::min(a.size(), b.size());
+    bool exact = real || largest[0] * largest[1] * shorter * shorter < POLYNOMIAL_MAX_EXACT_DOUBLE;
+    if (!real && (!exact || shorter >= DENSE_NTT_THRESHOLD)) {
+        std::vector<dense::WideInteger> product(length);
+        if (dense::ntt(aIntegers.data(), aIntegers.size(), bIntegers.data(), bIntegers.size(), product.data())) {
+            for (std::size_t degree = length; degree-- > 0;) {
+                if (product[degree].high != 0 || product[degree].low != 0) {
+                    factor.exponent = (std::uint32_t) degree;
+                    result.addTerm(&factor, degree == 0 ? 0 : 1, toNumber(product[degree]));
+                }
+            }
+            return true;
+        }
+    }
+    if (!exact) {
+        return false;
+    }
+    std::vector<double> product(length);
+    dense::multiply(a.data(), a.size(), b.data(), b.size(), product.data());
+    for (std::size_t degree = length; degree-- > 0;) {
+        if (product[degree] != 0) {
+            factor.exponent = (std::uint32_t) degree;
+            result.addTerm(&factor, degree == 0 ? 0 : 1, real ? Number::real(product[degree]) : Number::fromDouble(product[degree]));
+        }
+    }
+    return true;
+}
+
+Polynomial Polynomial::operator*(const Polynomial &other) const {
+    std::uint32_t atom = 0;
+    std::uint32_t otherAtom = 0;
+    Polynomial result;
+    if (isDense(atom) && other.isDense(otherAtom) && atom == otherAtom && multiplyDense(other, atom, result)) {
+        return result;
+    }
+    std::vector<Factor> product;
+    if (getTermCount() == 1 || other.getTermCount() == 1) {
+        // Multiplying by a monomial adds the same exponents to every term, which keeps them sorted.
+        for (std::size_t i = 0; i < getTermCount(); i++) {
+            for (std::size_t j = 0; j < other.getTermCount(); j++) {
+                multiplyTerms(getFactors(i), getFactorCount(i), other.getFactors(j), other.getFactorCount(j), product);
+                Number coefficient = coefficients[i] * other.coefficients[j];
+                if (!coefficient.isZero()) {
+                    result.addTerm(product.data(), product.size(), coefficient);
+                }
+            }
+        }
+        return result;
+    }
+    TermTable table {result.factors, result.starts, result.coefficients, getTermCount() + other.getTermCount()};
+    for (std::size_t i = 0; i < getTermCount(); i++) {
+        for (std::size_t j = 0; j < other.getTermCount(); j++) {
+            multiplyTerms(getFactors(i), getFactorCount(i), other.getFactors(j), other.getFactorCount(j), product);
+            table.add(product.data(), product.size(), coefficients[i] * other.coefficients[j]);
+        }
+    }
+    result.normalize();
+    return result;
+}
+
+Polynomial Polynomial::scale(const Number &factor) const {
+    if (factor.isZero()) {
+        return Polynomial {};
+    }
+    Polynomial result = *this;
+    for (Number &coefficient : result.coefficients) {
+        coefficient = coefficient * factor;
+    }
+    return result;
+}
+
+Polynomial Polynomial::power(std::uint32_t exponent) const {
+    Polynomial result = constant(Number::integer(1));
+    Polynomial base = *this;
+    while (exponent != 0) {
+        if (exponent & 1) {
+            result = result * base;
+        }
+        exponent >>= 1;
+        if (exponent != 0) {
+            base = base * base;
+        }
+    }
+    return result;
+}
+
+Expression *Polynomial::toExpression(const std::vector<Expression*> &atoms) const {
+    std::vector<Expression*> terms;
+    std::vector<Expression*> factors;
+    terms.reserve(getTermCount());
+    for (std::size_t term = 0; term < getTermCount(); term++) {
+        factors.clear();
+        if (!coefficients[term].isOne()) {
+            factors.push_back(Constant::create(coefficients[term]));
+        }
+        for (std::uint32_t i = starts[term]; i < starts[term + 1]; i++) {
+            const Factor &factor = this->factors[i];
+            if (factor.exponent == 1) {
+                factors.push_back(atoms[factor.atom]);
+            } else {
+                factors.push_back(Operation::create(atoms[factor.atom], Constant::create(factor.exponent), OP_EXP));
+            }
+        }
+        if (factors.empty()) {
+            terms.push_back(Constant::create(1));
+        } else if (factors.size() == 1) {
+            terms.push_back(factors[0]);
+        } else {
+            terms.push_back(Operation::create(OP_MUL, factors.data(), factors.size()));
+        }
+    }
+    if (terms.empty()) {
+        return Constant::create(0);
+    }
+    if (terms.size() == 1) {
+        return terms[0];
+    }
+    return Operation::create(OP_ADD, terms.data(), terms.size());
+}
+
+Expression *Polynomial::expand(Expression *expression) {
+    Expansion expansion;
+    return expansion.expand(expression);
+}
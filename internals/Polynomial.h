@@ -0,0 +1,104 @@
+#ifndef FLUXION_POLYNOMIAL_H
+#define FLUXION_POLYNOMIAL_H
+
+#include <cstdint>
+#include <vector>
+#include "Expression.h"
+
+#define POLYNOMIAL_MAX_EXPONENT 4096 // Larger powers of sums are left unexpanded.
+#define POLYNOMIAL_MAX_COEFFICIENT_BITS 256 // Powers whose exact coefficients could be larger are left unexpanded.
+#define POLYNOMIAL_DENSE_MIN_TERMS 8 // Shorter univariate polynomials are multiplied term by term.
+#define POLYNOMIAL_MAX_EXACT_DOUBLE 9007199254740992.0 // 2^53, integers up to it are exact doubles.
+
+/**
+ * A sparse multivariate polynomial over a list of atoms, which are
+ * variables, or subexpressions that are not polynomials such as x ^ 0.5.
+ * Coefficients are numbers, so expanding exact coefficients stays exact.
+ *
+ * Terms are stored flat, the factors of each term one after another, each
+ * an atom with a non zero exponent, by increasing atom. Terms are sorted
+ * in lexicographic order of the exponents of the atoms, highest first,
+ * with no two terms having the same exponents and no zero coefficients.
+ * A term only holds the atoms it has, so polynomials over many atoms stay
+ * as small as their terms.
+ */
+class Polynomial {
+public:
+    /**
+     * An atom raised to a positive power.
+     */
+    struct Factor {
+        std::uint32_t atom;
+        std::uint32_t exponent;
+    };
+private:
+    std::vector<Factor> factors;
+    std::vector<std::uint32_t> starts; // Index of the first factor of each term, then the number of factors.
+    std::vector<Number> coefficients;
+    /**
+     * Sort the terms, combine the ones with the same exponents and drop zeros.
+     */
+    void normalize();
+    void addTerm(const Factor *termFactors, std::size_t count, const Number &coefficient);
+    /**
+     * @param atom Set to the only atom of the polynomial.
+     * @return true if the polynomial is univariate, with at least half of its
+     * coefficients up to its degree non zero.
+     */
+    bool isDense(std::uint32_t &atom) const;
+    /**
+     * @return the exponent of the only atom of a term of a univariate polynomial, 0 for its constant term.
+     */
+    std::uint32_t getDegree(std::size_t term) const;
+    /**
+     * Multiply two dense polynomials of the same atom as coefficient arrays,
+     * of doubles, or of integers transformed exactly when doubles would round.
+     *
+     * @return false if neither is as exact as the coefficients.
+     */
+    bool multiplyDense(const Polynomial &other, std::uint32_t atom, Polynomial &result) const;
+public:
+    static Polynomial constant(const Number &value);
+    /**
+     * @return the polynomial of a single atom, to the first power.
+     */
+    static Polynomial atom(std::uint32_t index);
+    /**
+     * Add any number of polynomials at once, accumulating their terms in a
+     * single table, so the terms are sorted once.
+     */
+    static Polynomial sum(const std::vector<Polynomial> &terms);
+    Polynomial operator+(const Polynomial &other) const;
+    Polynomial operator*(const Polynomial &other) const;
+    Polynomial scale(const Number &factor) const;
+    /**
+     * Raise to a power by repeated squaring.
+     */
+    Polynomial power(std::uint32_t exponent) const;
+    std::size_t getTermCount() const;
+    const Number &getCoefficient(std::size_t term) const;
+    const Factor *getFactors(std::size_t term) const;
+    std::size_t getFactorCount(std::size_t term) const;
+    /**
+     * Build the sum of monomials in the current context.
+     *
+     * @param atoms Expression of each atom.
+     */
+    Expression *toExpression(const std::vector<Expression*> &atoms) const;
+    /**
+     * Expand products and non negative integer powers of sums of a simplified
+     * expression, so (x + 1) ^ 2 becomes x ^ 2 + 2x + 1. Subexpressions that
+     * are not polynomials are expanded inside, and kept as atoms, as are
+     * operations whose real coefficients would overflow and powers whose
+     * exact coefficients could get larger than POLYNOMIAL_MAX_COEFFICIENT_BITS.
+     *
+     * @return the expanded expression, simplified.
+     */
+    static Expression *expand(Expression *expression);
+    /**
+     * The zero polynomial.
+     */
+    Polynomial();
+};
+
+#endif //FLUXION_POLYNOMIAL_H
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include "RuleSet.h"
+#include "Compiler.h"
+#include "Context.h"
+#include "Parser.h"
+#include "SimplificationCache.h"
+
+namespace {
+    thread_local std::vector<Expression*> terms; // Terms left to match, the next is the last.
+    thread_local std::vector<std::uint32_t> candidates; // Shared by nested rewrites, each one works above those of its caller.
+    thread_local std::vector<Expression*> bindings; // Likewise.
+    thread_local std::uint32_t depth = 0; // Rewrites in progress on this thread.
+
+    /**
+     * c ^ d of two constants, the rule does not apply if the exact result is irrational, such as 2 ^ (1/2).
+     */
+    Expression *foldPower(Expression *const *bindings) {
+        Number power;
+        if (!Number::power(((Constant*) bindings[0])->getNumber(), ((Constant*) bindings[1])->getNumber(), power)) {
+            return nullptr;
+        }
+        return Constant::create(power);
+    }
+
+    bool satisfies(Expression *expression, RuleGuard guard) {
+        bool constant = expression->type == EXPRESSION_CONSTANT;
+        switch (guard) {
+            case GUARD_CONSTANT:
+                return constant;
+            case GUARD_INTEGER:
+                return constant && ((Constant*) expression)->getNumber().isInteger();
+            case GUARD_POSITIVE:
+                return constant && ((Constant*) expression)->getNumber().sign() > 0;
+            case GUARD_NONZERO:
+                return constant && ((Constant*) expression)->getNumber().sign() != 0;
+            case GUARD_VARIABLE:
+                return expression->type == EXPRESSION_VARIABLE;
+            case GUARD_NOT_CONSTANT:
+                return !constant;
+            default:
+                return true;
+        }
+    }
+
+    /**
+     * @return key of a constant by its value, so a pattern constant finds doubles of the same value.
+     */
+    inline std::uint64_t constantKey(double value) {
+        return (2ULL << 62) | (hashValue(value == 0 ? 0.0 : value) >> 2);
+    }
+}
+
+RuleSet::RuleSet() : builtinCount(0), rootTypes(0), generation(0) {
+    branches.emplace_back();
+    // The reductions of powers, in the order Operation::simplifyPower used to try them.
+    addRule("c ^ d", nullptr, foldPower, {{"c", GUARD_CONSTANT}, {"d", GUARD_CONSTANT}});
+    addRule("1 ^ x", "1", nullptr, {{"x", GUARD_ANY}});
+    addRule("x ^ 0", "1", nullptr, {{"x", GUARD_ANY}});
+    addRule("x ^ 1", "x", nullptr, {{"x", GUARD_ANY}});
+    builtinCount = rules.size();
+}
+
+RuleSet &RuleSet::global() {
+    static RuleSet rules;
+    return rules;
+}
+
+std::uint64_t RuleSet::keyOf(const Item &item, const std::vector<std::uint32_t> &limbs) {
+    switch (item.kind) {
+        case ITEM_OPERATION:
+            return (3ULL << 62) | ((std::uint64_t) item.opType << 32) | item.value;
+        case ITEM_VARIABLE:
+            return (1ULL << 62) | item.value;
+        default:
+            break;
+    }
+    Number number;
+    Number::restore(item.number, limbs.data(), limbs.size(), number); // Recorded here, so well formed.
+    return constantKey(number.toDouble());
+}
+
+std::uint64_t RuleSet::keyOf(Expression *expression) {
+    switch (expression->type) {
+        case EXPRESSION_OPERATION: {
+            auto operation = (Operation*) expression;
+            return (3ULL << 62) | ((std::uint64_t) operation->getOperationType() << 32) | operation->getOperandCount();
+        }
+        case EXPRESSION_VARIABLE:
+            return (1ULL << 62) | ((Variable*) expression)->getSymbol();
+        default:
+            return constantKey(((Constant*) expression)->getValue());
+    }
+}
+
+RuleStatus RuleSet::compile(const char *source, const std::vector<RuleVariable> &variables, bool pattern,
+                            std::vector<Item> &items, std::vector<std::uint32_t> &limbs) {
+    Parser parser {source};
+    if (parser.parse() == PARSING_FAILED) {
+        return RULE_MALFORMED;
+    }
+    Compiler compiler {parser.getTokens()};
+    if (compiler.compile() == COMPILATION_FAILED) {
+        return RULE_MALFORMED;
+    }
+    Expression *root = compiler.getRoot();
+    if (pattern) {
+        // Simplified, so the pattern has the shape of what it should match.
+        root = root->evaluate();
+        if (root->type != EXPRESSION_OPERATION) {
+            return RULE_NOT_OPERATION;
+        }
+    }
+    std::vector<Expression*> pending {root};
+    while (!pending.empty()) {
+        Expression *expression = pending.back();
+        pending.pop_back();
+        Item item {ITEM_CONSTANT, OP_ERR, 0, {}};
+        if (expression->type == EXPRESSION_OPERATION) {
+            auto operation = (Operation*) expression;
+            item.kind = ITEM_OPERATION;
+            item.opType = operation->getOperationType();
+            item.value = operation->getOperandCount();
+            for (std::uint32_t i = operation->getOperandCount(); i-- > 0;) {
+                pending.push_back(operation->getOperand(i));
+            }
+        } else if (expression->type == EXPRESSION_VARIABLE) {
+            item.kind = ITEM_VARIABLE;
+            item.value = ((Variable*) expression)->getSymbol();
+            for (std::size_t i = 0; i < variables.size(); i++) {
+                if (variables[i].name == ((Variable*) expression)->getVariableName()) {
+                    item.kind = ITEM_WILDCARD;
+                    item.value = (std::uint32_t) i;
+                }
+            }
+        } else {
+            item.number = ((Constant*) expression)->getNumber().record(limbs);
+        }
+        items.push_back(item);
+    }
+    return RULE_ADDED;
+}
+
+RuleStatus RuleSet::addRule(const char *pattern, const char *replacement, RuleAction action,
+                            const std::vector<RuleVariable> &variables) {
+    // Patterns are simplified without rules, in a context of their own, so nothing
+    // simplified this way is memoised or cached for anyone else.
+    Context context;
+    context.rewriting = false;
+    Context::Scope scope {context};
+    Rule rule {{}, {}, action, {}, {}};
+    for (const RuleVariable &variable : variables) {
+        rule.guards.push_back(variable.guard);
+    }
+    RuleStatus status = compile(pattern, variables, true, rule.pattern, rule.limbs);
+    if (status == RULE_ADDED && replacement != nullptr) {
+        status = compile(replacement, variables, false, rule.replacement, rule.limbs);
+    }
+    if (status != RULE_ADDED) {
+        return status;
+    }
+    rules.push_back(std::move(rule));
+    index((std::uint32_t) rules.size() - 1);
+    generation.fetch_add(1, std::memory_order_release);
+    SimplificationCache::global().clear(); // Its results were simplified without the rule.
+    return RULE_ADDED;
+}
+
+RuleStatus RuleSet::add(const char *pattern, const char *replacement, const std::vector<RuleVariable> &variables) {
+    return addRule(pattern, replacement, nullptr, variables);
+}
+
+RuleStatus RuleSet::add(const char *pattern, RuleAction action, const std::vector<RuleVariable> &variables) {
+    return addRule(pattern, nullptr, action, variables);
+}
+
+void RuleSet::index(std::uint32_t rule) {
+    const Rule &added = rules[rule];
+    rootTypes |= 1U << added.pattern[0].opType;
+    std::uint32_t branch = 0;
+    for (const Item &item : added.pattern) {
+        std::uint32_t next;
+        if (item.kind == ITEM_WILDCARD) {
+            next = branches[branch].wildcard;
+        } else {
+            auto child = branches[branch].children.find(keyOf(item, added.limbs));
+            next = child == branches[branch].children.end() ? 0 : child->second;
+        }
+        if (next == 0) {
+            next = (std::uint32_t) branches.size();
+            branches.emplace_back(); // May move the branches, so they are looked up again.
+            if (item.kind == ITEM_WILDCARD) {
+                branches[branch].wildcard = next;
+            } else {
+                branches[branch].children.emplace(keyOf(item, added.limbs), next);
+            }
+        }
+        branch = next;
+    }
+    branches[branch].rules.push_back(rule);
+}
+
+void RuleSet::collect(std::uint32_t branch, std::vector<Expression*> &pending, std::vector<std::uint32_t> &found) const {
+    const Branch &node = branches[branch];
+    if (pending.empty()) {
+        found.insert(found.end(), node.rules.begin(), node.rules.end());
+        return;
+    }
+    Expression *term = pending.back();
+    pending.pop_back();
+    if (node.wildcard != 0) {
+        collect(node.wildcard, pending, found); // A pattern variable takes the whole term.
+    }
+    auto child = node.children.find(keyOf(term));
+    if (child != node.children.end()) {
+        std::size_t mark = pending.size();
+        if (term->type == EXPRESSION_OPERATION) {
+            auto operation = (Operation*) term;
+            for (std::uint32_t i = operation->getOperandCount(); i-- > 0;) {
+                pending.push_back(operation->getOperand(i));
+            }
+        }
+        collect(child->second, pending, found);
+        pending.resize(mark);
+    }
+    pending.push_back(term);
+}
+
+bool RuleSet::match(const Rule &rule, Expression *expression, Expression **bound) const {
+    std::fill(bound, bound + rule.guards.size(), nullptr);
+    terms.assign(1, expression);
+    for (const Item &item : rule.pattern) {
+        Expression *term = terms.back();
+        terms.pop_back();
+        switch (item.kind) {
+            case ITEM_WILDCARD:
+                if (bound[item.value] == nullptr) {
+                    if (!satisfies(term, rule.guards[item.value])) {
+                        return false;
+                    }
+                    bound[item.value] = term;
+                } else if (bound[item.value] != term) {
+                    return false; // Hash-consed, so equal subtrees are the same node.
+                }
+                break;
+            case ITEM_OPERATION: {
+                if (term->type != EXPRESSION_OPERATION || ((Operation*) term)->getOperationType() != item.opType
+                    || ((Operation*) term)->getOperandCount() != item.value) {
+                    return false;
+                }
+                auto operation = (Operation*) term;
+                for (std::uint32_t i = operation->getOperandCount(); i-- > 0;) {
+                    terms.push_back(operation->getOperand(i));
+                }
+                break;
+            }
+            case ITEM_VARIABLE:
+                if (term->type != EXPRESSION_VARIABLE || ((Variable*) term)->getSymbol() != item.value) {
+                    return false;
+                }
+                break;
+            default: {
+                if (term->type != EXPRESSION_CONSTANT) {
+                    return false;
+                }
+                Number number;
+                Number::restore(item.number, rule.limbs.data(), rule.limbs.size(), number);
+                const Number &value = ((Constant*) term)->getNumber();
+                // A constant of a pattern also matches a double of the same value, as x ^ 1.0 is x.
+                if (number.isExact() && value.isExact() ? !number.identical(value) : number.toDouble() != value.toDouble()) {
+                    return false;
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+Expression *RuleSet::instantiate(const Rule &rule, Expression *const *bound) {
+    // Built from the end of the prefix order, so the operands of an operation are ready when it is reached.
+    std::vector<Expression*> built;
+    for (std::size_t i = rule.replacement.size(); i-- > 0;) {
+        const Item &item = rule.replacement[i];
+        switch (item.kind) {
+            case ITEM_WILDCARD:
+                built.push_back(bound[item.value]);
+                break;
+            case ITEM_VARIABLE:
+                built.push_back(Variable::create((symbol_t) item.value));
+                break;
+            case ITEM_CONSTANT: {
+                Number number;
+                Number::restore(item.number, rule.limbs.data(), rule.limbs.size(), number);
+                built.push_back(Constant::create(number));
+                break;
+            }
+            default: {
+                // The first operand is on top.
+                std::vector<Expression*> operands(built.rbegin(), built.rbegin() + item.value);
+                built.resize(built.size() - item.value);
+                built.push_back(Operation::create(item.opType, operands.data(), operands.size()));
+                break;
+            }
+        }
+    }
+    return built.back();
+}
+
+Expression *RuleSet::rewrite(Expression *expression) {
+    if (expression->type != EXPRESSION_OPERATION || (rootTypes & (1U << ((Operation*) expression)->getOperationType())) == 0
+        || depth >= RULE_MAX_DEPTH) {
+        return expression;
+    }
+    std::size_t base = candidates.size();
+    terms.assign(1, expression);
+    collect(0, terms, candidates);
+    std::sort(candidates.begin() + (std::ptrdiff_t) base, candidates.end()); // The first rule added wins.
+    Expression *result = expression;
+    for (std::size_t i = base; i < candidates.size() && result == expression; i++) {
+        const Rule &rule = rules[candidates[i]];
+        std::size_t bindingBase = bindings.size();
+        bindings.resize(bindingBase + rule.guards.size());
+        if (match(rule, expression, bindings.data() + bindingBase)) {
+            Expression *replaced;
+            depth++;
+            if (rule.action != nullptr) {
+                // Copied, since rewrites nested in the action may grow the bindings.
+                std::vector<Expression*> bound(bindings.begin() + (std::ptrdiff_t) bindingBase, bindings.end());
+                replaced = rule.action(bound.data());
+            } else {
+                replaced = instantiate(rule, bindings.data() + bindingBase)->evaluate();
+            }
+            depth--;
+            result = replaced == nullptr ? expression : replaced;
+        }
+        bindings.resize(bindingBase);
+    }
+    candidates.resize(base);
+    return result;
+}
+
+void RuleSet::clear() {
+    rules.resize(builtinCount);
+    branches.assign(1, Branch {});
+    rootTypes = 0;
+    for (std::uint32_t rule = 0; rule < rules.size(); rule++) {
+        index(rule);
+    }
+    generation.fetch_add(1, std::memory_order_release);
+    SimplificationCache::global().clear();
+}
+
+std::size_t RuleSet::size() const {
+    return rules.size();
+}
+
+std::uint64_t RuleSet::getGeneration() const {
+    return generation.load(std::memory_order_acquire);
+}
@@ -0,0 +1,151 @@
+#ifndef FLUXION_RULESET_H
+#define FLUXION_RULESET_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Expression.h"
+
+#define RULE_MAX_DEPTH 32 // Replacements are not rewritten again past this many nested rewrites, so rules undoing each other stop.
+
+/**
+ * What a pattern variable may match.
+ */
+enum RuleGuard {
+    GUARD_ANY,
+    GUARD_CONSTANT,
+    GUARD_INTEGER, // A constant integer.
+    GUARD_POSITIVE, // A constant greater than 0.
+    GUARD_NONZERO, // A constant other than 0.
+    GUARD_VARIABLE,
+    GUARD_NOT_CONSTANT
+};
+
+enum RuleStatus {
+    RULE_ADDED,
+    RULE_MALFORMED, // The pattern or the replacement does not parse.
+    RULE_NOT_OPERATION // The pattern simplifies to a constant or a variable, only operations are rewritten.
+};
+
+struct RuleVariable {
+    std::string name;
+    RuleGuard guard;
+};
+
+/**
+ * Computes the replacement of a rule from the expressions its pattern
+ * variables matched, in the order they were declared.
+ *
+ * @return the simplified replacement, or nullptr if the rule does not apply.
+ */
+typedef Expression *(*RuleAction)(Expression *const *bindings);
+
+/**
+ * Rewrite rules applied to every simplified operation, each one turns
+ * expressions matching a pattern into a replacement. Patterns are
+ * simplified like any expression, so they match simplified operations
+ * operand by operand, with the operands of + and * in their sorted order.
+ *
+ * Patterns are indexed by a discrimination tree, a trie over their nodes
+ * in prefix order where a pattern variable skips a whole subtree, so
+ * finding the rules matching an operation costs about the size of the
+ * part of it patterns reach, however many rules there are. When several
+ * rules match, the first one added is applied.
+ *
+ * The rules applied to powers are built in, other rules are added by
+ * the user. Adding rules while other threads simplify is not safe.
+ */
+class RuleSet {
+private:
+    enum ItemKind : std::uint8_t {
+        ITEM_OPERATION,
+        ITEM_CONSTANT,
+        ITEM_VARIABLE,
+        ITEM_WILDCARD // A pattern variable.
+    };
+    /**
+     * A node of a pattern or of a replacement, they are stored in prefix order.
+     */
+    struct Item {
+        ItemKind kind;
+        OperationType opType;
+        std::uint32_t value; // Operand count, symbol of a variable or index of a pattern variable.
+        NumberRecord number; // Of a constant, rules outlive the context they were compiled in.
+    };
+    struct Rule {
+        std::vector<Item> pattern;
+        std::vector<Item> replacement; // Empty if the action computes it.
+        RuleAction action;
+        std::vector<RuleGuard> guards; // Of each pattern variable.
+        std::vector<std::uint32_t> limbs; // Limbs of big constants.
+    };
+    /**
+     * A node of the discrimination tree, following it consumes one node of the matched expression.
+     */
+    struct Branch {
+        std::unordered_map<std::uint64_t, std::uint32_t> children; // By key of the node.
+        std::uint32_t wildcard = 0; // Branch after a pattern variable, 0 if none.
+        std::vector<std::uint32_t> rules; // Rules whose pattern ends here.
+    };
+    std::vector<Rule> rules;
+    std::vector<Branch> branches; // The root is the first.
+    std::size_t builtinCount;
+    std::uint32_t rootTypes; // Bit of the type of every operation a pattern starts with.
+    std::atomic<std::uint64_t> generation;
+    static std::uint64_t keyOf(const Item &item, const std::vector<std::uint32_t> &limbs);
+    static std::uint64_t keyOf(Expression *expression);
+    /**
+     * Parse and compile a pattern or a replacement in the current context, patterns are simplified.
+     */
+    static RuleStatus compile(const char *source, const std::vector<RuleVariable> &variables, bool pattern,
+                              std::vector<Item> &items, std::vector<std::uint32_t> &limbs);
+    RuleStatus addRule(const char *pattern, const char *replacement, RuleAction action, const std::vector<RuleVariable> &variables);
+    void index(std::uint32_t rule);
+    /**
+     * Collect the rules whose pattern may match the terms, the next term is the last.
+     */
+    void collect(std::uint32_t branch, std::vector<Expression*> &terms, std::vector<std::uint32_t> &found) const;
+    /**
+     * @param bindings Set to what each pattern variable matched, if the rule matches.
+     */
+    bool match(const Rule &rule, Expression *expression, Expression **bindings) const;
+    static Expression *instantiate(const Rule &rule, Expression *const *bindings);
+    RuleSet();
+public:
+    static RuleSet &global();
+    /**
+     * Add a rule rewriting matches of the pattern into the replacement,
+     * in which the pattern variables stand for what they matched.
+     *
+     * @param variables Pattern variables, other variables only match themselves.
+     */
+    RuleStatus add(const char *pattern, const char *replacement, const std::vector<RuleVariable> &variables);
+    /**
+     * Add a rule whose replacement is computed.
+     */
+    RuleStatus add(const char *pattern, RuleAction action, const std::vector<RuleVariable> &variables);
+    /**
+     * Apply the first rule matching a simplified expression.
+     *
+     * @return the simplified replacement, or the expression itself if no rule applies.
+     */
+    Expression *rewrite(Expression *expression);
+    /**
+     * Remove the rules added by the user, the built in rules are kept.
+     */
+    void clear();
+    /**
+     * @return number of rules, built in rules included.
+     */
+    std::size_t size() const;
+    /**
+     * @return a number that changes whenever rules are added or removed.
+     */
+    std::uint64_t getGeneration() const;
+    RuleSet(const RuleSet&) = delete;
+    RuleSet &operator=(const RuleSet&) = delete;
+};
+
+#endif //FLUXION_RULESET_H
@@ -0,0 +1,54 @@
+#include "Schedule.h"
+
+Schedule::Schedule(Expression *expression) {
+    // Post-order with an explicit stack, each node is expanded the first time it is reached.
+    std::unordered_map<Expression*, std::uint32_t, NodeHash> positions;
+    struct Visit {
+        Expression *expression;
+        bool expanded; // Its operands were pushed.
+    };
+    std::vector<Visit> visits {{expression, false}};
+    while (!visits.empty()) {
+        Visit &visit = visits.back();
+        Expression *current = visit.expression;
+        if (current->type != EXPRESSION_OPERATION) {
+            visits.pop_back();
+            if (current->type == EXPRESSION_VARIABLE && positions.emplace(current, variables.size()).second) {
+                variables.push_back((Variable*) current);
+            }
+        } else if (positions.count(current) != 0) {
+            visits.pop_back(); // Shared, already scheduled.
+        } else if (!visit.expanded) {
+            visit.expanded = true;
+            auto operation = (Operation*) current;
+            for (std::uint32_t i = operation->getOperandCount(); i-- > 0;) {
+                visits.push_back({operation->getOperand(i), false});
+            }
+        } else {
+            visits.pop_back();
+            positions[current] = (std::uint32_t) operations.size();
+            operations.push_back((Operation*) current);
+        }
+    }
+    uses.assign(operations.size(), 0);
+    for (Operation *operation : operations) {
+        for (std::uint32_t i = 0; i < operation->getOperandCount(); i++) {
+            Expression *operand = operation->getOperand(i);
+            if (operand->type == EXPRESSION_OPERATION) {
+                uses[positions[operand]]++;
+            }
+        }
+    }
+}
+
+const std::vector<Operation*> &Schedule::getOperations() const {
+    return this->operations;
+}
+
+std::uint32_t Schedule::getUses(std::size_t position) const {
+    return this->uses[position];
+}
+
+const std::vector<Variable*> &Schedule::getVariables() const {
+    return this->variables;
+}
@@ -0,0 +1,47 @@
+#ifndef FLUXION_SCHEDULE_H
+#define FLUXION_SCHEDULE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Expression.h"
+
+/**
+ * Hashes a node by its structural hash, which is already computed, so
+ * identical subtrees land in the same bucket.
+ */
+struct NodeHash {
+    std::size_t operator()(const Expression *expression) const {
+        return (std::size_t) expression->_hash;
+    }
+};
+
+/**
+ * Common subexpression elimination. Hash-consing makes identical subtrees
+ * of an expression the same node, so the tree is really a DAG. A schedule
+ * lists its distinct operations in topological order, operands before the
+ * operations using them, with how many times each is used, so evaluators
+ * compute every repeated subtree once rather than once per copy.
+ */
+class Schedule {
+private:
+    std::vector<Operation*> operations;
+    std::vector<std::uint32_t> uses; // References to each operation from the other operations.
+    std::vector<Variable*> variables;
+public:
+    /**
+     * @return the distinct operations, the expression itself last if it is one.
+     */
+    const std::vector<Operation*> &getOperations() const;
+    /**
+     * @return number of operands of the other operations that are the operation at this position.
+     */
+    std::uint32_t getUses(std::size_t position) const;
+    /**
+     * @return the distinct variables, in the order they are first reached.
+     */
+    const std::vector<Variable*> &getVariables() const;
+    explicit Schedule(Expression *expression);
+};
+
+#endif //FLUXION_SCHEDULE_H
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <iterator>
+#include "SimplificationCache.h"
+
+SimplificationCache::SimplificationCache() : capacity(CACHE_DEFAULT_CAPACITY), hits(0), misses(0), insertions(0), evictions(0) {
+
+}
+
+SimplificationCache &SimplificationCache::global() {
+    static SimplificationCache cache;
+    return cache;
+}
+
+SimplificationCache::Shard &SimplificationCache::shardOf(hash_t key) {
+    return shards[(key >> 59) % CACHE_SHARD_COUNT]; // Low bits are used by the index.
+}
+
+bool SimplificationCache::accepts(Expression *expression) const {
+    // Flat expressions take at least 9 bytes per node, too large trees would not
+    // fit in a shard anyway, and would make every miss expensive.
+    std::size_t limit = capacity.load(std::memory_order_relaxed) / CACHE_SHARD_COUNT / CACHE_MAX_ENTRY_FRACTION;
+    return expression->size >= CACHE_MIN_NODES && expression->size * (sizeof(std::uint8_t) + 2 * sizeof(std::uint32_t)) <= limit;
+}
+
+Expression *SimplificationCache::lookup(Expression *expression) {
+    Shard &shard = shardOf(expression->_hash);
+    std::lock_guard<std::mutex> lock {shard.mutex};
+    auto found = shard.index.find(expression->_hash);
+    // Only flatten the expression to verify when there is a candidate, most misses stop at the index.
+    if (found == shard.index.end() || !(found->second->input == FlatExpression {expression})) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return found->second->output.toExpression();
+}
+
+void SimplificationCache::insert(Expression *expression, Expression *result) {
+    if (capacity.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    Shard &shard = shardOf(expression->_hash);
+    {
+        std::lock_guard<std::mutex> lock {shard.mutex};
+        hash_t &candidate = shard.candidates[expression->_hash % CACHE_CANDIDATE_SLOTS];
+        if (candidate != expression->_hash) {
+            candidate = expression->_hash; // First miss, flattening is only worth it if it misses again.
+            return;
+        }
+        candidate = 0;
+    }
+    // Flattened outside the lock, so other threads only wait for the list and index updates.
+    Entry entry {expression->_hash, FlatExpression {expression}, FlatExpression {result}, 0};
+    entry.bytes = entry.input.bytes() + entry.output.bytes() + sizeof(Entry);
+    std::lock_guard<std::mutex> lock {shard.mutex};
+    auto found = shard.index.find(entry.key);
+    if (found != shard.index.end()) { // Replace the older entry, it is either the same or a collision.
+        shard.bytes -= found->second->bytes;
+        shard.entries.erase(found->second);
+        shard.index.erase(found);
+    }
+    shard.bytes += entry.bytes;
+    shard.entries.push_front(std::move(entry));
+    shard.index[shard.entries.front().key] = shard.entries.begin();
+    insertions.fetch_add(1, std::memory_order_relaxed);
+    evict(shard);
+}
+
+void SimplificationCache::evict(Shard &shard) {
+    std::size_t limit = capacity.load(std::memory_order_relaxed) / CACHE_SHARD_COUNT;
+    while (shard.bytes > limit && !shard.entries.empty()) {
+        Entry &last = shard.entries.back();
+        shard.bytes -= last.bytes;
+        shard.index.erase(last.key);
+        shard.entries.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void SimplificationCache::setCapacity(std::size_t bytes) {
+    capacity.store(bytes, std::memory_order_relaxed);
+    for (Shard &shard : shards) {
+        std::lock_guard<std::mutex> lock {shard.mutex};
+        evict(shard);
+    }
+}
+
+CacheStatistics SimplificationCache::getStatistics() {
+    CacheStatistics statistics {hits.load(), misses.load(), insertions.load(), evictions.load(), 0, 0, capacity.load()};
+    for (Shard &shard : shards) {
+        std::lock_guard<std::mutex> lock {shard.mutex};
+        statistics.entries += shard.entries.size();
+        statistics.bytes += shard.bytes;
+    }
+    return statistics;
+}
+
+void SimplificationCache::clear() {
+    for (Shard &shard : shards) {
+        std::lock_guard<std::mutex> lock {shard.mutex};
+        shard.entries.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+        std::fill(std::begin(shard.candidates), std::end(shard.candidates), 0);
+    }
+    hits = 0;
+    misses = 0;
+    insertions = 0;
+    evictions = 0;
+}
@@ -0,0 +1,95 @@
+#ifndef FLUXION_SIMPLIFICATIONCACHE_H
+#define FLUXION_SIMPLIFICATIONCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "Expression.h"
+#include "FlatExpression.h"
+
+#define CACHE_SHARD_COUNT 16 // Independently locked parts, so threads rarely wait on each other.
+#define CACHE_DEFAULT_CAPACITY (16 * 1024 * 1024)
+#define CACHE_MIN_NODES 4 // Smaller trees are faster to simplify than to look up.
+#define CACHE_MAX_ENTRY_FRACTION 16 // An entry may use at most this fraction of a shard.
+#define CACHE_CANDIDATE_SLOTS 1024 // Hashes of missed expressions remembered per shard.
+
+struct CacheStatistics {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t insertions;
+    std::uint64_t evictions;
+    std::uint64_t entries;
+    std::uint64_t bytes;
+    std::uint64_t capacity;
+};
+
+/**
+ * A bounded, thread safe cache of simplification results shared by
+ * every context, keyed by the structural hash of the simplified tree.
+ *
+ * Both the tree and its result are stored as flat expressions, so a hit is
+ * verified structurally, and the result is restored in the context of
+ * the caller. Each shard evicts its least recently used entries once
+ * it is over its share of the capacity.
+ *
+ * Results are only stored the second time their expression misses,
+ * until then the shard only remembers its hash, so expressions
+ * simplified once are never flattened.
+ */
+class SimplificationCache {
+private:
+    struct Entry {
+        hash_t key;
+        FlatExpression input;
+        FlatExpression output;
+        std::size_t bytes;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> entries; // Most recently used first.
+        std::unordered_map<hash_t, std::list<Entry>::iterator> index;
+        std::size_t bytes = 0;
+        hash_t candidates[CACHE_CANDIDATE_SLOTS] = {}; // Hashes of expressions inserted once, by their low bits.
+    };
+    Shard shards[CACHE_SHARD_COUNT];
+    std::atomic<std::size_t> capacity;
+    std::atomic<std::uint64_t> hits;
+    std::atomic<std::uint64_t> misses;
+    std::atomic<std::uint64_t> insertions;
+    std::atomic<std::uint64_t> evictions;
+    Shard &shardOf(hash_t key);
+    /**
+     * Evict least recently used entries of a locked shard until it fits its share.
+     */
+    void evict(Shard &shard);
+public:
+    /**
+     * @return true if the expression is worth caching.
+     */
+    bool accepts(Expression *expression) const;
+    /**
+     * Look for the simplified form of the expression.
+     *
+     * @return the cached result restored in the current context, or nullptr.
+     */
+    Expression *lookup(Expression *expression);
+    /**
+     * Store the simplified form of the expression, if it was inserted before.
+     */
+    void insert(Expression *expression, Expression *result);
+    /**
+     * Change the capacity in bytes, 0 disables the cache.
+     */
+    void setCapacity(std::size_t bytes);
+    CacheStatistics getStatistics();
+    /**
+     * Remove every entry and reset the counters.
+     */
+    void clear();
+    static SimplificationCache &global();
+    SimplificationCache();
+};
+
+#endif //FLUXION_SIMPLIFICATIONCACHE_H
@@ -0,0 +1,1567 @@
+#ifndef FLUXION_STATICFORMULA_H
+#define FLUXION_STATICFORMULA_H
+
+#if __cplusplus >= 201703L
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <utility>
+
+#define STATIC_NODES_PER_CHARACTER 4 // Nodes reserved per character of source, for the parsed and the simplified tree.
+#define STATIC_EXTRA_NODES 32 // Nodes reserved on top of those, short formulas simplify into relatively many.
+#define STATIC_MAX_DECIMALS 18 // Longest fraction of a literal, so its power of ten fits in 64 bits.
+#define STATIC_MAX_ROOT 64 // Largest root taken exactly, as NUMBER_MAX_ROOT.
+#define STATIC_MAX_POWER_BITS 65536 // Larger exact powers are left unevaluated, as NUMBER_MAX_POWER_BITS.
+#define STATIC_MAX_DISTRIBUTED_EXPONENT 1024 // As SIMPLIFY_MAX_DISTRIBUTED_EXPONENT.
+#define STATIC_MAX_INTEGER_EXPONENT 64 // As PROGRAM_MAX_INTEGER_EXPONENT.
+
+namespace fluxion {
+    enum StaticStatus {
+        STATIC_COMPILED,
+        STATIC_MALFORMED, // The source does not parse or does not compile.
+        STATIC_TOO_LARGE, // Simplifying needed more nodes than were reserved.
+        STATIC_NOT_FOLDABLE // A constant does not fit in 64 bits, or folding it would not give a finite double.
+    };
+
+    /**
+     * Kinds of nodes, in the order of ExpressionType.
+     */
+    enum StaticKind : std::uint8_t {
+        STATIC_CONSTANT,
+        STATIC_VARIABLE,
+        STATIC_OPERATION
+    };
+
+    /**
+     * Operations, in the order of OperationType, which decides how operations are sorted.
+     */
+    enum StaticOperation : std::uint8_t {
+        STATIC_ADD,
+        STATIC_MIN,
+        STATIC_DIV,
+        STATIC_MUL,
+        STATIC_EXP
+    };
+
+    /**
+     * Instructions, as the OpCode of a Program.
+     */
+    enum StaticOpCode : std::uint32_t {
+        STATIC_OPCODE_ADD,
+        STATIC_OPCODE_SUB,
+        STATIC_OPCODE_MUL,
+        STATIC_OPCODE_DIV,
+        STATIC_OPCODE_POW,
+        STATIC_OPCODE_POWI, // Power with the integer exponent stored in b.
+        STATIC_OPCODE_SQRT // Power of 0.5, b is unused.
+    };
+
+    enum StaticPower {
+        STATIC_POWER_FOLDED,
+        STATIC_POWER_IRRATIONAL, // Or too large, the power is kept as it is.
+        STATIC_POWER_NOT_FOLDABLE // The result would not be finite, or needs std::pow.
+    };
+
+    /**
+     * @return base ^ exponent by repeated squaring, as powi, so integer powers match Program.
+     */
+    inline double staticPowi(double base, std::int32_t exponent) {
+        unsigned n = exponent < 0 ? -exponent : exponent;
+        double result = 1;
+        for (; n != 0; n >>= 1) {
+            if (n & 1) {
+                result *= base;
+            }
+            base *= base;
+        }
+        return exponent < 0 ? 1 / result : result;
+    }
+
+    /**
+     * The compile time counterpart of Number, an exact rational whose parts
+     * fit in 64 bits, or a finite double. Exact arithmetic that overflows
+     * continues in doubles rather than in bignums, and arithmetic that would
+     * not give a finite double fails, compilers refuse to fold it.
+     */
+    struct StaticNumber {
+        bool exact = true;
+        std::int64_t numerator = 0; // Never INT64_MIN, so it can always be negated.
+        std::int64_t denominator = 1;
+        double inexact = 0;
+
+        static constexpr std::uint64_t magnitude(std::int64_t value) {
+            return value < 0 ? 0 - (std::uint64_t) value : (std::uint64_t) value;
+        }
+
+        static constexpr std::uint64_t gcd(std::uint64_t a, std::uint64_t b) {
+            while (b != 0) {
+                std::uint64_t remainder = a % b;
+                a = b;
+                b = remainder;
+            }
+            return a;
+        }
+
+        /**
+         * @return false if a + b overflows or is INT64_MIN.
+         */
+        static constexpr bool checkedAdd(std::int64_t a, std::int64_t b, std::int64_t &result) {
+            if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) {
+                return false;
+            }
+            result = a + b;
+            return result != INT64_MIN;
+        }
+
+        /**
+         * @return false if a * b overflows or is INT64_MIN.
+         */
+        static constexpr bool checkedMultiply(std::int64_t a, std::int64_t b, std::int64_t &result) {
+            if (a != 0 && b != 0 && magnitude(a) > (std::uint64_t) INT64_MAX / magnitude(b)) {
+                return false;
+            }
+            result = a * b;
+            return true;
+        }
+
+        /**
+         * @return the closest double to a / b, rounded once like Number::toDouble, b is at most 2^63.
+         */
+        static constexpr double quotientToDouble(bool negative, std::uint64_t a, std::uint64_t b) {
+            if (a == 0) {
+                return 0;
+            }
+            if (a <= (1ULL << 53) && b <= (1ULL << 53)) {
+                double result = (double) a / (double) b; // Both exact, so rounded once.
+                return negative ? -result : result;
+            }
+            // Long division up to 64 significant bits, the remainder only matters as a sticky bit.
+            std::uint64_t bits = a / b;
+            std::uint64_t remainder = a % b;
+            int exponent = 0;
+            while ((bits >> 63) == 0) {
+                bits <<= 1;
+                remainder <<= 1;
+                if (remainder >= b) {
+                    bits |= 1;
+                    remainder -= b;
+                }
+                exponent--;
+            }
+            // Round the 64 bits to 53, half to even.
+            std::uint64_t low = bits & 0x7ff;
+            bits >>= 11;
+            exponent += 11;
+            if (low > 0x400 || (low == 0x400 && (remainder != 0 || (bits & 1) != 0))) {
+                bits++;
+            }
+            double result = (double) bits;
+            for (; exponent > 0; exponent--) {
+                result *= 2;
+            }
+            for (; exponent < 0; exponent++) {
+                result /= 2; // Exact, quotients of 64 bit integers are far from subnormal.
+            }
+            return negative ? -result : result;
+        }
+
+        static constexpr StaticNumber integer(std::int64_t value) {
+            StaticNumber number;
+            number.numerator = value;
+            return number;
+        }
+
+        static constexpr StaticNumber real(double value) {
+            StaticNumber number;
+            number.exact = false;
+            number.inexact = value;
+            return number;
+        }
+
+        /**
+         * @return a / b reduced, a double if it does not fit in 64 bits.
+         */
+        static constexpr StaticNumber quotient(bool negative, std::uint64_t a, std::uint64_t b) {
+            std::uint64_t common = gcd(a, b);
+            a /= common;
+            b /= common;
+            if (a > (std::uint64_t) INT64_MAX || b > (std::uint64_t) INT64_MAX) {
+                return real(quotientToDouble(negative, a, b));
+            }
+            StaticNumber number;
+            number.numerator = negative ? -(std::int64_t) a : (std::int64_t) a;
+            number.denominator = (std::int64_t) b;
+            return number;
+        }
+
+        /**
+         * @return false if the denominator is 0, Number gives an infinity or NaN then.
+         */
+        static constexpr bool rational(std::int64_t numerator, std::int64_t denominator, StaticNumber &result) {
+            if (denominator == 0) {
+                return false;
+            }
+            result = quotient((numerator < 0) != (denominator < 0) && numerator != 0, magnitude(numerator), magnitude(denominator));
+            return true;
+        }
+
+        static constexpr bool addReals(double x, double y, StaticNumber &result) {
+            const double max = std::numeric_limits<double>::max();
+            if ((x > 0 && y > 0 && x > max - y) || (x < 0 && y < 0 && x < -max - y)) {
+                return false;
+            }
+            result = real(x + y);
+            return true;
+        }
+
+        static constexpr bool multiplyReals(double x, double y, StaticNumber &result) {
+            double a = x < 0 ? -x : x;
+            double b = y < 0 ? -y : y;
+            if (a > 1 && b > std::numeric_limits<double>::max() / a) {
+                return false;
+            }
+            result = real(x * y);
+            return true;
+        }
+
+        static constexpr bool divideReals(double x, double y, StaticNumber &result) {
+            double a = x < 0 ? -x : x;
+            double b = y < 0 ? -y : y;
+            if (y == 0 || (b < 1 && a > std::numeric_limits<double>::max() * b)) {
+                return false;
+            }
+            result = real(x / y);
+            return true;
+        }
+
+        static constexpr bool add(const StaticNumber &a, const StaticNumber &b, StaticNumber &result) {
+            if (a.exact && b.exact) {
+                std::int64_t numerator = 0;
+                std::int64_t denominator = 0;
+                if (a.denominator == 1 && b.denominator == 1) {
+                    if (checkedAdd(a.numerator, b.numerator, numerator)) {
+                        result = integer(numerator);
+                        return true;
+                    }
+                } else {
+                    auto common = (std::int64_t) gcd((std::uint64_t) a.denominator, (std::uint64_t) b.denominator);
+                    std::int64_t left = 0;
+                    std::int64_t right = 0;
+                    if (checkedMultiply(a.numerator, b.denominator / common, left)
+                        && checkedMultiply(b.numerator, a.denominator / common, right)
+                        && checkedAdd(left, right, numerator)
+                        && checkedMultiply(a.denominator, b.denominator / common, denominator)) {
+                        return rational(numerator, denominator, result);
+                    }
+                }
+            }
+            return addReals(a.toDouble(), b.toDouble(), result);
+        }
+
+        static constexpr bool multiply(const StaticNumber &a, const StaticNumber &b, StaticNumber &result) {
+            if (a.exact && b.exact) {
+                if (a.numerator == 0 || b.numerator == 0) {
+                    result = integer(0);
+                    return true;
+                }
+                // Cancel across first, so the product is already reduced.
+                auto left = (std::int64_t) gcd(magnitude(a.numerator), (std::uint64_t) b.denominator);
+                auto right = (std::int64_t) gcd(magnitude(b.numerator), (std::uint64_t) a.denominator);
+                std::int64_t numerator = 0;
+                std::int64_t denominator = 0;
+                if (checkedMultiply(a.numerator / left, b.numerator / right, numerator)
+                    && checkedMultiply(a.denominator / right, b.denominator / left, denominator)) {
+                    result.exact = true;
+                    result.numerator = numerator;
+                    result.denominator = denominator;
+                    return true;
+                }
+            }
+            return multiplyReals(a.toDouble(), b.toDouble(), result);
+        }
+
+        static constexpr bool divide(const StaticNumber &a, const StaticNumber &b, StaticNumber &result) {
+            if (b.isZero()) {
+                return false;
+            }
+            if (!a.exact || !b.exact) {
+                return divideReals(a.toDouble(), b.toDouble(), result);
+            }
+            StaticNumber reciprocal;
+            reciprocal.numerator = b.numerator < 0 ? -b.denominator : b.denominator;
+            reciprocal.denominator = (std::int64_t) magnitude(b.numerator);
+            return multiply(a, reciprocal, result);
+        }
+
+        static constexpr std::uint64_t bitLength(std::uint64_t value) {
+            std::uint64_t bits = 0;
+            for (; value != 0; value >>= 1) {
+                bits++;
+            }
+            return bits;
+        }
+
+        /**
+         * @return the integer q-th root of a value that is not negative, false if it is not a q-th power.
+         */
+        static constexpr bool integerRoot(std::int64_t value, std::int64_t q, std::int64_t &root) {
+            std::int64_t low = 0;
+            std::int64_t high = value;
+            while (low <= high) {
+                std::int64_t middle = low + (high - low) / 2;
+                std::int64_t power = 1;
+                bool fits = true;
+                for (std::int64_t i = 0; i < q && fits; i++) {
+                    fits = checkedMultiply(power, middle, power);
+                }
+                if (fits && power == value) {
+                    root = middle;
+                    return true;
+                }
+                if (fits && power < value) {
+                    low = middle + 1;
+                } else {
+                    high = middle - 1;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * a ^ b, as Number::power.
+         */
+        static constexpr StaticPower power(const StaticNumber &a, const StaticNumber &b, StaticNumber &result) {
+            if (!a.exact || !b.exact) {
+                return STATIC_POWER_NOT_FOLDABLE;
+            }
+            if (b.isZero() || a.isOne()) {
+                result = integer(1);
+                return STATIC_POWER_FOLDED;
+            }
+            if (b.isOne()) {
+                result = a;
+                return STATIC_POWER_FOLDED;
+            }
+            std::int64_t p = b.numerator;
+            std::int64_t q = b.denominator;
+            if (a.isZero()) {
+                result = a;
+                return p > 0 ? STATIC_POWER_FOLDED : STATIC_POWER_NOT_FOLDABLE;
+            }
+            StaticNumber base = a;
+            if (q != 1) {
+                // Only rationals whose parts are both q-th powers have a rational q-th root.
+                if (a.numerator < 0 || q > STATIC_MAX_ROOT || !integerRoot(a.numerator, q, base.numerator)
+                    || !integerRoot(a.denominator, q, base.denominator)) {
+                    return STATIC_POWER_IRRATIONAL;
+                }
+            }
+            if (base.denominator == 1 && magnitude(base.numerator) == 1) {
+                result = p % 2 == 0 ? integer(1) : base; // (-1) ^ p
+                return STATIC_POWER_FOLDED;
+            }
+            std::uint64_t bits = bitLength(magnitude(base.numerator));
+            bits = bits > bitLength((std::uint64_t) base.denominator) ? bits : bitLength((std::uint64_t) base.denominator);
+            std::uint64_t exponent = magnitude(p);
+            if (exponent > STATIC_MAX_POWER_BITS || bits * exponent > STATIC_MAX_POWER_BITS) {
+                return STATIC_POWER_IRRATIONAL;
+            }
+            std::int64_t numerator = base.numerator;
+            std::int64_t denominator = base.denominator;
+            std::int64_t numeratorPower = 1;
+            std::int64_t denominatorPower = 1;
+            bool fits = true;
+            for (std::uint64_t rest = exponent; rest != 0 && fits; rest >>= 1) {
+                if ((rest & 1) != 0) {
+                    fits = checkedMultiply(numeratorPower, numerator, numeratorPower)
+                        && checkedMultiply(denominatorPower, denominator, denominatorPower);
+                }
+                if (rest > 1 && fits) {
+                    fits = checkedMultiply(numerator, numerator, numerator) && checkedMultiply(denominator, denominator, denominator);
+                }
+            }
+            if (fits) {
+                if (p < 0) {
+                    result.numerator = numeratorPower < 0 ? -denominatorPower : denominatorPower;
+                    result.denominator = (std::int64_t) magnitude(numeratorPower);
+                } else {
+                    result.numerator = numeratorPower;
+                    result.denominator = denominatorPower;
+                }
+                result.exact = true;
+                return STATIC_POWER_FOLDED;
+            }
+            // Too large for 64 bits, continue in doubles.
+            StaticNumber square = real(base.toDouble());
+            StaticNumber product = real(1);
+            for (std::uint64_t rest = exponent; rest != 0; rest >>= 1) {
+                if ((rest & 1) != 0 && !multiplyReals(product.inexact, square.inexact, product)) {
+                    return STATIC_POWER_NOT_FOLDABLE;
+                }
+                if (rest > 1 && !multiplyReals(square.inexact, square.inexact, square)) {
+                    return STATIC_POWER_NOT_FOLDABLE;
+                }
+            }
+            if (p < 0) {
+                return divideReals(1, product.inexact, result) ? STATIC_POWER_FOLDED : STATIC_POWER_NOT_FOLDABLE;
+            }
+            result = product;
+            return STATIC_POWER_FOLDED;
+        }
+
+        /**
+         * Compare the fractions a / b and c / d, with b and d positive, without overflowing.
+         */
+        static constexpr int compareFractions(std::uint64_t a, std::uint64_t b, std::uint64_t c, std::uint64_t d) {
+            int sign = 1;
+            while (true) {
+                std::uint64_t left = a / b;
+                std::uint64_t right = c / d;
+                if (left != right) {
+                    return left < right ? -sign : sign;
+                }
+                std::uint64_t leftRemainder = a % b;
+                std::uint64_t rightRemainder = c % d;
+                if (leftRemainder == 0 || rightRemainder == 0) {
+                    return leftRemainder == rightRemainder ? 0 : (leftRemainder == 0 ? -sign : sign);
+                }
+                // r / b and s / d are in the opposite order of b / r and d / s.
+                a = b;
+                b = leftRemainder;
+                c = d;
+                d = rightRemainder;
+                sign = -sign;
+            }
+        }
+
+        /**
+         * Total order, by value, an exact number comes before a double of the same value, as Number::compare.
+         */
+        static constexpr int compare(const StaticNumber &a, const StaticNumber &b) {
+            if (a.exact && b.exact) {
+                int left = a.sign();
+                int right = b.sign();
+                if (left != right) {
+                    return left < right ? -1 : 1;
+                }
+                if (left == 0) {
+                    return 0;
+                }
+                int order = compareFractions(magnitude(a.numerator), (std::uint64_t) a.denominator,
+                                             magnitude(b.numerator), (std::uint64_t) b.denominator);
+                return left < 0 ? -order : order;
+            }
+            double x = a.toDouble();
+            double y = b.toDouble();
+            if (x != y) {
+                return x < y ? -1 : 1;
+            }
+            return a.exact == b.exact ? 0 : (a.exact ? -1 : 1);
+        }
+
+        constexpr StaticNumber operator-() const {
+            StaticNumber number = *this;
+            number.numerator = -numerator;
+            number.inexact = -inexact;
+            return number;
+        }
+
+        constexpr double toDouble() const {
+            return exact ? quotientToDouble(numerator < 0, magnitude(numerator), (std::uint64_t) denominator) : inexact;
+        }
+
+        constexpr bool isInteger() const {
+            if (exact) {
+                return denominator == 1;
+            }
+            double value = inexact < 0 ? -inexact : inexact;
+            return value >= 4503599627370496.0 || inexact == (double) (std::int64_t) inexact; // Doubles from 2^52 up are integers.
+        }
+
+        constexpr bool isZero() const {
+            return exact ? numerator == 0 : inexact == 0;
+        }
+
+        constexpr bool isOne() const {
+            return exact ? numerator == 1 && denominator == 1 : inexact == 1;
+        }
+
+        constexpr int sign() const {
+            return exact ? (numerator > 0) - (numerator < 0) : (inexact > 0) - (inexact < 0);
+        }
+
+        constexpr bool identical(const StaticNumber &other) const {
+            if (exact != other.exact) {
+                return false;
+            }
+            return exact ? numerator == other.numerator && denominator == other.denominator : inexact == other.inexact;
+        }
+    };
+
+    /**
+     * A hash-consed node of a formula being compiled.
+     */
+    struct StaticNode {
+        StaticKind kind = STATIC_CONSTANT;
+        StaticOperation opType = STATIC_ADD;
+        std::uint32_t first = 0; // Where the name starts in the source for variables, where the operands start for operations.
+        std::uint32_t count = 0; // Length of the name, or number of operands.
+        StaticNumber number;
+    };
+
+    /**
+     * A single instruction, dst = a op b, registers are numbered as in a Program.
+     */
+    struct StaticInstruction {
+        StaticOpCode opCode = STATIC_OPCODE_ADD;
+        std::uint32_t dst = 0;
+        std::uint32_t a = 0;
+        std::uint32_t b = 0;
+    };
+
+    /**
+     * A formula compiled to instructions, every instruction writes a new temporary.
+     */
+    template <std::size_t CAPACITY>
+    struct StaticProgram {
+        StaticStatus status = STATIC_COMPILED;
+        StaticInstruction instructions[CAPACITY] {};
+        std::uint32_t instructionCount = 0;
+        double constants[CAPACITY] {};
+        std::uint32_t constantCount = 0;
+        std::uint32_t names[CAPACITY] {}; // Where the name of each variable starts in the source.
+        std::uint32_t nameLengths[CAPACITY] {};
+        std::uint32_t variableCount = 0;
+        std::uint32_t result = 0;
+    };
+
+    /**
+     * Parses, simplifies and lowers a formula at compile time, following
+     * Parser and Compiler, then Operation::evaluate, then Program, step by
+     * step, so a formula is simplified into the same tree and evaluated in
+     * the same order as it would be at run time.
+     *
+     * Storage is fixed by CAPACITY, nodes are found by hash like in a
+     * NodeTable, and the temporary lists of the simplifier are stacks
+     * shared by nested calls, each one working above those of its caller.
+     */
+    template <std::size_t CAPACITY>
+    class StaticCompiler {
+    private:
+        enum PendingType : std::uint8_t {
+            PENDING_BINARY,
+            PENDING_NEGATION,
+            PENDING_PARENTHESIS
+        };
+        struct Pending {
+            PendingType type = PENDING_BINARY;
+            StaticOperation opType = STATIC_ADD;
+        };
+        /**
+         * A term of a sum, weight * expression, or a factor of a product, expression ^ weight.
+         */
+        struct Part {
+            std::uint32_t expression = 0;
+            StaticNumber weight;
+        };
+        static constexpr std::size_t tableSize() {
+            std::size_t size = 1;
+            while (size < CAPACITY * 2) {
+                size <<= 1;
+            }
+            return size;
+        }
+        static constexpr std::size_t TABLE_SIZE = tableSize();
+        static constexpr std::uint32_t NONE = 0xffffffffU;
+
+        std::string_view source;
+        StaticStatus status = STATIC_COMPILED;
+        StaticNode nodes[CAPACITY] {};
+        std::uint32_t nodeCount = 0;
+        std::uint32_t operands[CAPACITY * 3] {};
+        std::uint32_t operandCount = 0;
+        std::uint32_t table[TABLE_SIZE] {}; // Index of a node plus one, 0 for a free slot.
+        std::uint32_t simplified[CAPACITY] {}; // Simplified form of each node plus one, 0 if not known yet.
+        Part parts[CAPACITY] {};
+        std::uint32_t partCount = 0;
+        Part pending[CAPACITY] {};
+        std::uint32_t pendingCount = 0;
+        std::uint32_t scratch[CAPACITY] {}; // Operand stack of the parser, operands being gathered otherwise.
+        std::uint32_t scratchCount = 0;
+        Pending operators[CAPACITY] {};
+        std::uint32_t uses[CAPACITY] {};
+        std::uint32_t registers[CAPACITY] {}; // Register of variables and lowered shared operations, plus one.
+        bool visited[CAPACITY] {};
+        StaticProgram<CAPACITY> program {};
+
+        constexpr void fail(StaticStatus failure) {
+            if (status == STATIC_COMPILED) {
+                status = failure;
+            }
+        }
+
+        static constexpr std::uint64_t mix(std::uint64_t hash, std::uint64_t value) {
+            hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+            hash ^= hash >> 31;
+            return hash * 0xbf58476d1ce4e5b9ULL;
+        }
+
+        constexpr bool isOperation(std::uint32_t node, StaticOperation opType) const {
+            return nodes[node].kind == STATIC_OPERATION && nodes[node].opType == opType;
+        }
+
+        constexpr std::uint32_t operandOf(std::uint32_t node, std::uint32_t index) const {
+            return operands[nodes[node].first + index];
+        }
+
+        constexpr std::string_view nameOf(std::uint32_t node) const {
+            return source.substr(nodes[node].first, nodes[node].count);
+        }
+
+        constexpr bool sameNode(const StaticNode &a, const StaticNode &b) const {
+            if (a.kind != b.kind) {
+                return false;
+            }
+            switch (a.kind) {
+                case STATIC_CONSTANT:
+                    return a.number.identical(b.number);
+                case STATIC_VARIABLE:
+                    return source.substr(a.first, a.count) == source.substr(b.first, b.count);
+                default:
+                    break;
+            }
+            if (a.opType != b.opType || a.count != b.count) {
+                return false;
+            }
+            for (std::uint32_t i = 0; i < a.count; i++) {
+                if (operands[a.first + i] != operands[b.first + i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        constexpr std::uint64_t hashNode(const StaticNode &node) const {
+            std::uint64_t hash = mix(node.kind, node.opType);
+            switch (node.kind) {
+                case STATIC_CONSTANT:
+                    // Doubles are rare, they all share a hash.
+                    return node.number.exact ? mix(mix(hash, (std::uint64_t) node.number.numerator), (std::uint64_t) node.number.denominator) : hash;
+                case STATIC_VARIABLE:
+                    for (std::uint32_t i = 0; i < node.count; i++) {
+                        hash = mix(hash, (std::uint8_t) source[node.first + i]);
+                    }
+                    return hash;
+                default:
+                    for (std::uint32_t i = 0; i < node.count; i++) {
+                        hash = mix(hash, operands[node.first + i]);
+                    }
+                    return hash;
+            }
+        }
+
+        /**
+         * @return the existing node identical to the given one, or the given one stored as a new node.
+         */
+        constexpr std::uint32_t intern(const StaticNode &node) {
+            std::size_t slot = hashNode(node) & (TABLE_SIZE - 1);
+            while (table[slot] != 0) {
+                if (sameNode(nodes[table[slot] - 1], node)) {
+                    if (node.kind == STATIC_OPERATION) {
+                        operandCount -= node.count; // The operands were stored for the new node.
+                    }
+                    return table[slot] - 1;
+                }
+                slot = (slot + 1) & (TABLE_SIZE - 1);
+            }
+            if (nodeCount == CAPACITY) {
+                fail(STATIC_TOO_LARGE);
+                return 0;
+            }
+            nodes[nodeCount] = node;
+            table[slot] = ++nodeCount;
+            return nodeCount - 1;
+        }
+
+        constexpr std::uint32_t constant(const StaticNumber &number) {
+            StaticNode node;
+            node.number = number;
+            return intern(node);
+        }
+
+        constexpr std::uint32_t variable(std::uint32_t first, std::uint32_t length) {
+            StaticNode node;
+            node.kind = STATIC_VARIABLE;
+            node.first = first;
+            node.count = length;
+            return intern(node);
+        }
+
+        /**
+         * Total order of nodes, as Expression::compare.
+         */
+        constexpr int compare(std::uint32_t a, std::uint32_t b) const {
+            if (a == b) {
+                return 0;
+            }
+            const StaticNode &left = nodes[a];
+            const StaticNode &right = nodes[b];
+            if (left.kind != right.kind) {
+                return left.kind < right.kind ? -1 : 1;
+            }
+            switch (left.kind) {
+                case STATIC_CONSTANT:
+                    return StaticNumber::compare(left.number, right.number);
+                case STATIC_VARIABLE: {
+                    int order = nameOf(a).compare(nameOf(b));
+                    return (order > 0) - (order < 0);
+                }
+                default:
+                    break;
+            }
+            if (left.opType != right.opType) {
+                return left.opType < right.opType ? -1 : 1;
+            }
+            std::uint32_t shorter = left.count < right.count ? left.count : right.count;
+            for (std::uint32_t i = 0; i < shorter; i++) {
+                int order = compare(operands[left.first + i], operands[right.first + i]);
+                if (order != 0) {
+                    return order;
+                }
+            }
+            return left.count < right.count ? -1 : 1;
+        }
+
+        /**
+         * Create an operation, sorting the operands of + and *, as Operation::create.
+         */
+        constexpr std::uint32_t operation(StaticOperation opType, const std::uint32_t *items, std::uint32_t count) {
+            if (operandCount + count > CAPACITY * 3) {
+                fail(STATIC_TOO_LARGE);
+                return 0;
+            }
+            StaticNode node;
+            node.kind = STATIC_OPERATION;
+            node.opType = opType;
+            node.first = operandCount;
+            node.count = count;
+            for (std::uint32_t i = 0; i < count; i++) {
+                operands[operandCount + i] = items[i];
+            }
+            if (opType == STATIC_ADD || opType == STATIC_MUL) {
+                for (std::uint32_t i = 1; i < count; i++) {
+                    std::uint32_t item = operands[operandCount + i];
+                    std::uint32_t j = i;
+                    for (; j > 0 && compare(item, operands[operandCount + j - 1]) < 0; j--) {
+                        operands[operandCount + j] = operands[operandCount + j - 1];
+                    }
+                    operands[operandCount + j] = item;
+                }
+            }
+            operandCount += count;
+            return intern(node);
+        }
+
+        constexpr std::uint32_t operation(std::uint32_t left, std::uint32_t right, StaticOperation opType) {
+            std::uint32_t items[] = {left, right};
+            return operation(opType, items, 2);
+        }
+
+        constexpr void pushPart(Part *stack, std::uint32_t &count, std::uint32_t expression, const StaticNumber &weight) {
+            if (count == CAPACITY) {
+                fail(STATIC_TOO_LARGE);
+                return;
+            }
+            stack[count].expression = expression;
+            stack[count].weight = weight;
+            count++;
+        }
+
+        constexpr void pushScratch(std::uint32_t value) {
+            if (scratchCount == CAPACITY) {
+                fail(STATIC_TOO_LARGE);
+                return;
+            }
+            scratch[scratchCount++] = value;
+        }
+
+        constexpr StaticNumber add(const StaticNumber &a, const StaticNumber &b) {
+            StaticNumber result;
+            if (!StaticNumber::add(a, b, result)) {
+                fail(STATIC_NOT_FOLDABLE);
+            }
+            return result;
+        }
+
+        constexpr StaticNumber multiply(const StaticNumber &a, const StaticNumber &b) {
+            StaticNumber result;
+            if (!StaticNumber::multiply(a, b, result)) {
+                fail(STATIC_NOT_FOLDABLE);
+            }
+            return result;
+        }
+
+        static constexpr bool isSmallInteger(const StaticNumber &value) {
+            double magnitude = value.toDouble();
+            magnitude = magnitude < 0 ? -magnitude : magnitude;
+            return value.isInteger() && magnitude <= STATIC_MAX_DISTRIBUTED_EXPONENT;
+        }
+
+        /**
+         * Merge parts from base up with the same expression by adding their weights, keeping the first of each.
+         */
+        constexpr void group(std::uint32_t base) {
+            std::uint32_t kept = base;
+            for (std::uint32_t part = base; part < partCount; part++) {
+                std::uint32_t i = base;
+                while (i < kept && parts[i].expression != parts[part].expression) {
+                    i++;
+                }
+                if (i == kept) {
+                    parts[kept++] = parts[part];
+                } else {
+                    parts[i].weight = add(parts[i].weight, parts[part].weight);
+                }
+            }
+            partCount = kept;
+        }
+
+        constexpr void addTerm(std::uint32_t term, const StaticNumber &weight, StaticNumber &sumConstant) {
+            if (nodes[term].kind == STATIC_CONSTANT) {
+                sumConstant = add(sumConstant, multiply(weight, nodes[term].number));
+            } else if (isOperation(term, STATIC_ADD)) {
+                for (std::uint32_t i = 0; i < nodes[term].count; i++) {
+                    addTerm(operandOf(term, i), weight, sumConstant); // Simplified sums have no sum operands.
+                }
+            } else if (isOperation(term, STATIC_MUL) && nodes[operandOf(term, 0)].kind == STATIC_CONSTANT) {
+                // The coefficient is the first factor, since constants are sorted first.
+                std::uint32_t count = nodes[term].count;
+                std::uint32_t rest = count == 2 ? operandOf(term, 1) : operation(STATIC_MUL, operands + nodes[term].first + 1, count - 1);
+                pushPart(parts, partCount, rest, multiply(weight, nodes[operandOf(term, 0)].number));
+            } else {
+                pushPart(parts, partCount, term, weight);
+            }
+        }
+
+        constexpr void addFactor(std::uint32_t factor, const StaticNumber &exponent, StaticNumber &coefficient) {
+            if (nodes[factor].kind == STATIC_CONSTANT) {
+                StaticNumber value;
+                StaticPower folded = StaticNumber::power(nodes[factor].number, exponent, value);
+                if (folded == STATIC_POWER_FOLDED) {
+                    coefficient = multiply(coefficient, value);
+                } else if (folded == STATIC_POWER_IRRATIONAL) {
+                    pushPart(parts, partCount, factor, exponent);
+                } else {
+                    fail(STATIC_NOT_FOLDABLE);
+                }
+            } else if (isOperation(factor, STATIC_MUL) && isSmallInteger(exponent)) {
+                // (ab)^n = a^n b^n only holds for integer n.
+                for (std::uint32_t i = 0; i < nodes[factor].count; i++) {
+                    addFactor(operandOf(factor, i), exponent, coefficient);
+                }
+            } else if (isOperation(factor, STATIC_EXP) && nodes[operandOf(factor, 1)].kind == STATIC_CONSTANT
+                       && isSmallInteger(exponent)) {
+                pushPart(parts, partCount, operandOf(factor, 0), multiply(exponent, nodes[operandOf(factor, 1)].number));
+            } else {
+                pushPart(parts, partCount, factor, exponent);
+            }
+        }
+
+        constexpr std::uint32_t buildSum(std::uint32_t base, const StaticNumber &sumConstant) {
+            group(base);
+            std::uint32_t gathered = scratchCount;
+            for (std::uint32_t i = base; i < partCount; i++) {
+                const Part term = parts[i];
+                if (term.weight.isZero()) {
+                    continue; // Cancelled out.
+                }
+                if (term.weight.isOne()) {
+                    pushScratch(term.expression);
+                } else if (isOperation(term.expression, STATIC_MUL)) {
+                    // Put the coefficient back in front of the other factors, keeping the product flat.
+                    std::uint32_t factors = scratchCount;
+                    pushScratch(constant(term.weight));
+                    for (std::uint32_t j = 0; j < nodes[term.expression].count; j++) {
+                        pushScratch(operandOf(term.expression, j));
+                    }
+                    std::uint32_t product = operation(STATIC_MUL, scratch + factors, scratchCount - factors);
+                    scratchCount = factors;
+                    pushScratch(product);
+                } else {
+                    pushScratch(operation(constant(term.weight), term.expression, STATIC_MUL));
+                }
+            }
+            if (!sumConstant.isZero() || scratchCount == gathered) {
+                pushScratch(constant(sumConstant));
+            }
+            std::uint32_t result = scratchCount - gathered == 1 ? scratch[gathered]
+                : operation(STATIC_ADD, scratch + gathered, scratchCount - gathered);
+            scratchCount = gathered;
+            return result;
+        }
+
+        constexpr std::uint32_t buildProduct(std::uint32_t base, StaticNumber coefficient) {
+            if (coefficient.isZero()) {
+                return constant(StaticNumber::integer(0));
+            }
+            group(base);
+            // Irrational powers of a constant may have combined into a rational one, 2 ^ (1/2) * 2 ^ (1/2) = 2.
+            for (std::uint32_t i = base; i < partCount; i++) {
+                StaticNumber value;
+                if (nodes[parts[i].expression].kind == STATIC_CONSTANT) {
+                    StaticPower folded = StaticNumber::power(nodes[parts[i].expression].number, parts[i].weight, value);
+                    if (folded == STATIC_POWER_FOLDED) {
+                        coefficient = multiply(coefficient, value);
+                        parts[i].weight = StaticNumber::integer(0);
+                    } else if (folded == STATIC_POWER_NOT_FOLDABLE) {
+                        fail(STATIC_NOT_FOLDABLE);
+                    }
+                }
+            }
+            std::uint32_t gathered = scratchCount;
+            if (!coefficient.isOne()) {
+                pushScratch(constant(coefficient));
+            }
+            for (std::uint32_t i = base; i < partCount; i++) {
+                const Part factor = parts[i];
+                if (factor.weight.isZero()) {
+                    continue; // x / x = 1.
+                }
+                if (factor.weight.isOne()) {
+                    pushScratch(factor.expression);
+                } else {
+                    pushScratch(operation(factor.expression, constant(factor.weight), STATIC_EXP));
+                }
+            }
+            std::uint32_t count = scratchCount - gathered;
+            std::uint32_t result = count == 0 ? constant(coefficient)
+                : (count == 1 ? scratch[gathered] : operation(STATIC_MUL, scratch + gathered, count));
+            scratchCount = gathered;
+            return result;
+        }
+
+        constexpr std::uint32_t simplifySum(std::uint32_t root) {
+            std::uint32_t base = partCount;
+            StaticNumber sumConstant = StaticNumber::integer(0);
+            std::uint32_t bottom = pendingCount;
+            pushPart(pending, pendingCount, root, StaticNumber::integer(1));
+            while (pendingCount > bottom && status == STATIC_COMPILED) {
+                Part part = pending[--pendingCount];
+                if (isOperation(part.expression, STATIC_ADD)) {
+                    for (std::uint32_t i = nodes[part.expression].count; i-- > 0;) {
+                        pushPart(pending, pendingCount, operandOf(part.expression, i), part.weight);
+                    }
+                } else if (isOperation(part.expression, STATIC_MIN)) {
+                    pushPart(pending, pendingCount, operandOf(part.expression, 1), -part.weight);
+                    pushPart(pending, pendingCount, operandOf(part.expression, 0), part.weight);
+                } else {
+                    addTerm(evaluate(part.expression), part.weight, sumConstant);
+                }
+            }
+            pendingCount = bottom;
+            std::uint32_t result = buildSum(base, sumConstant);
+            partCount = base;
+            return result;
+        }
+
+        constexpr std::uint32_t simplifyProduct(std::uint32_t root) {
+            std::uint32_t base = partCount;
+            StaticNumber coefficient = StaticNumber::integer(1);
+            std::uint32_t bottom = pendingCount;
+            pushPart(pending, pendingCount, root, StaticNumber::integer(1));
+            while (pendingCount > bottom && status == STATIC_COMPILED) {
+                Part part = pending[--pendingCount];
+                if (isOperation(part.expression, STATIC_MUL)) {
+                    for (std::uint32_t i = nodes[part.expression].count; i-- > 0;) {
+                        pushPart(pending, pendingCount, operandOf(part.expression, i), part.weight);
+                    }
+                } else if (isOperation(part.expression, STATIC_DIV)) {
+                    pushPart(pending, pendingCount, operandOf(part.expression, 1), -part.weight);
+                    pushPart(pending, pendingCount, operandOf(part.expression, 0), part.weight);
+                } else {
+                    addFactor(evaluate(part.expression), part.weight, coefficient);
+                }
+            }
+            pendingCount = bottom;
+            std::uint32_t result = buildProduct(base, coefficient);
+            partCount = base;
+            return result;
+        }
+
+        constexpr std::uint32_t simplifyPower(std::uint32_t root) {
+            std::uint32_t base = evaluate(operandOf(root, 0));
+            std::uint32_t exponent = evaluate(operandOf(root, 1));
+            if (nodes[base].kind == STATIC_CONSTANT && nodes[exponent].kind == STATIC_CONSTANT) {
+                StaticNumber value;
+                StaticPower folded = StaticNumber::power(nodes[base].number, nodes[exponent].number, value);
+                if (folded == STATIC_POWER_FOLDED) {
+                    return constant(value);
+                } else if (folded == STATIC_POWER_NOT_FOLDABLE) {
+                    fail(STATIC_NOT_FOLDABLE);
+                }
+                return operation(base, exponent, STATIC_EXP); // Irrational, such as 2 ^ (1/2).
+            }
+            if (nodes[base].kind == STATIC_CONSTANT && nodes[base].number.isOne()) {
+                return base; // 1 ^ x = 1
+            }
+            if (nodes[exponent].kind == STATIC_CONSTANT) {
+                const StaticNumber value = nodes[exponent].number;
+                if (value.isZero()) {
+                    return constant(StaticNumber::integer(1));
+                }
+                if (value.isOne()) {
+                    return base;
+                }
+                if (isSmallInteger(value)) {
+                    // Integer powers of products and powers are distributed, so they combine with other factors.
+                    std::uint32_t bottom = partCount;
+                    StaticNumber coefficient = StaticNumber::integer(1);
+                    addFactor(base, value, coefficient);
+                    std::uint32_t result = buildProduct(bottom, coefficient);
+                    partCount = bottom;
+                    return result;
+                }
+            }
+            return operation(base, exponent, STATIC_EXP);
+        }
+
+        /**
+         * Simplify a node, memoised, as Operation::evaluate.
+         */
+        constexpr std::uint32_t evaluate(std::uint32_t node) {
+            if (nodes[node].kind != STATIC_OPERATION || status != STATIC_COMPILED) {
+                return node;
+            }
+            if (simplified[node] != 0) {
+                return simplified[node] - 1;
+            }
+            std::uint32_t result = node;
+            switch (nodes[node].opType) {
+                case STATIC_ADD:
+                case STATIC_MIN:
+                    result = simplifySum(node);
+                    break;
+                case STATIC_MUL:
+                case STATIC_DIV:
+                    result = simplifyProduct(node);
+                    break;
+                default:
+                    result = simplifyPower(node);
+                    break;
+            }
+            simplified[node] = result + 1;
+            if (simplified[result] == 0) {
+                simplified[result] = result + 1; // Simplified expressions are already as simple as they get.
+            }
+            return result;
+        }
+
+        static constexpr bool isDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        static constexpr bool isIdentifierStart(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        }
+
+        static constexpr int getPrecedence(StaticOperation opType) {
+            switch (opType) {
+                case STATIC_ADD:
+                case STATIC_MIN:
+                    return 1;
+                case STATIC_MUL:
+                case STATIC_DIV:
+                    return 2;
+                default:
+                    return 4;
+            }
+        }
+
+        static constexpr int getOperandPrecedence(const Pending &pending) {
+            switch (pending.type) {
+                case PENDING_NEGATION:
+                    return 3; // Binds tighter than * and /, but looser than ^, so -a^2 = -(a^2).
+                case PENDING_PARENTHESIS:
+                    return 0;
+                default:
+                    break;
+            }
+            // Left associative operators only take tighter operators to their right, so a - b - c = (a - b) - c.
+            int precedence = getPrecedence(pending.opType);
+            return pending.opType == STATIC_EXP ? precedence : precedence + 1;
+        }
+
+        constexpr void reduce(std::uint32_t &operatorCount) {
+            Pending top = operators[--operatorCount];
+            std::uint32_t right = scratch[--scratchCount];
+            if (top.type == PENDING_NEGATION) {
+                if (nodes[right].kind == STATIC_CONSTANT) {
+                    scratch[scratchCount++] = constant(-nodes[right].number);
+                } else {
+                    scratch[scratchCount++] = operation(constant(StaticNumber::integer(-1)), right, STATIC_MUL);
+                }
+                return;
+            }
+            std::uint32_t left = scratch[scratchCount - 1];
+            scratch[scratchCount - 1] = operation(left, right, top.opType);
+        }
+
+        /**
+         * Read a number at position, exactly, as Parser::consumeNumber in exact mode.
+         */
+        constexpr std::uint32_t readNumber(std::size_t &position) {
+            std::int64_t mantissa = 0;
+            std::int64_t power = 1;
+            std::uint32_t decimals = 0;
+            bool fits = true;
+            for (; position < source.size() && isDigit(source[position]); position++) {
+                fits = fits && StaticNumber::checkedMultiply(mantissa, 10, mantissa)
+                    && StaticNumber::checkedAdd(mantissa, source[position] - '0', mantissa);
+            }
+            if (position < source.size() && source[position] == '.') {
+                position++;
+                if (position == source.size() || !isDigit(source[position])) {
+                    fail(STATIC_MALFORMED); // There must be digits after the dot.
+                    return 0;
+                }
+                for (; position < source.size() && isDigit(source[position]); position++, decimals++) {
+                    fits = fits && decimals < STATIC_MAX_DECIMALS && StaticNumber::checkedMultiply(mantissa, 10, mantissa)
+                        && StaticNumber::checkedAdd(mantissa, source[position] - '0', mantissa);
+                    power *= fits ? 10 : 1;
+                }
+            }
+            StaticNumber number;
+            if (!fits || !StaticNumber::rational(mantissa, power, number)) {
+                fail(STATIC_NOT_FOLDABLE);
+                return 0;
+            }
+            return constant(number);
+        }
+
+        /**
+         * Parse and compile the source, as Parser then Compiler::compileExpression.
+         */
+        constexpr std::uint32_t parse() {
+            std::uint32_t operatorCount = 0;
+            bool expectOperand = true;
+            std::size_t position = 0;
+            while (status == STATIC_COMPILED) {
+                while (position < source.size() && (source[position] == ' ' || source[position] == '\t'
+                                                    || source[position] == '\n' || source[position] == '\r')) {
+                    position++;
+                }
+                if (position == source.size()) {
+                    break;
+                }
+                char c = source[position];
+                if (expectOperand) {
+                    if (isDigit(c)) {
+                        scratch[scratchCount++] = readNumber(position);
+                        expectOperand = false;
+                        continue;
+                    } else if (isIdentifierStart(c)) {
+                        std::size_t start = position;
+                        while (position < source.size() && (isIdentifierStart(source[position]) || isDigit(source[position]))) {
+                            position++;
+                        }
+                        scratch[scratchCount++] = variable((std::uint32_t) start, (std::uint32_t) (position - start));
+                        expectOperand = false;
+                        continue;
+                    } else if (c == '(') {
+                        operators[operatorCount++] = {PENDING_PARENTHESIS, STATIC_ADD};
+                    } else if (c == '-') {
+                        operators[operatorCount++] = {PENDING_NEGATION, STATIC_MIN};
+                    } else {
+                        fail(STATIC_MALFORMED); // Only - can be used as a prefix.
+                    }
+                    position++;
+                    continue;
+                }
+                StaticOperation opType = STATIC_ADD;
+                switch (c) {
+                    case '+':
+                        break;
+                    case '-':
+                        opType = STATIC_MIN;
+                        break;
+                    case '*':
+                        opType = STATIC_MUL;
+                        break;
+                    case '/':
+                        opType = STATIC_DIV;
+                        break;
+                    case '^':
+                        opType = STATIC_EXP;
+                        break;
+                    case ')':
+                        while (operatorCount > 0 && operators[operatorCount - 1].type != PENDING_PARENTHESIS) {
+                            reduce(operatorCount);
+                        }
+                        if (operatorCount == 0) {
+                            fail(STATIC_MALFORMED); // An unmatched ).
+                        }
+                        operatorCount--;
+                        position++;
+                        continue;
+                    default:
+                        fail(STATIC_MALFORMED); // Two operands in a row, or a malformed token.
+                        continue;
+                }
+                // Operators that bind tighter than this one have all their operands.
+                while (operatorCount > 0 && getPrecedence(opType) < getOperandPrecedence(operators[operatorCount - 1])) {
+                    reduce(operatorCount);
+                }
+                operators[operatorCount++] = {PENDING_BINARY, opType};
+                expectOperand = true;
+                position++;
+            }
+            if (expectOperand) {
+                fail(STATIC_MALFORMED); // Expected an operand, but the input ended.
+            }
+            while (operatorCount > 0 && status == STATIC_COMPILED) {
+                if (operators[operatorCount - 1].type == PENDING_PARENTHESIS) {
+                    fail(STATIC_MALFORMED); // Unbalanced parentheses.
+                    break;
+                }
+                reduce(operatorCount);
+            }
+            std::uint32_t root = scratchCount == 0 ? 0 : scratch[scratchCount - 1];
+            scratchCount = 0;
+            return root;
+        }
+
+        /**
+         * Count the uses of every operation and number the variables, as Schedule.
+         */
+        constexpr void schedule(std::uint32_t node) {
+            if (visited[node]) {
+                return;
+            }
+            visited[node] = true;
+            if (nodes[node].kind == STATIC_VARIABLE) {
+                // Variables are bound in the order of their names, as in a Program.
+                std::uint32_t position = program.variableCount++;
+                for (; position > 0 && nameOf(node) < source.substr(program.names[position - 1], program.nameLengths[position - 1]); position--) {
+                    program.names[position] = program.names[position - 1];
+                    program.nameLengths[position] = program.nameLengths[position - 1];
+                }
+                program.names[position] = nodes[node].first;
+                program.nameLengths[position] = nodes[node].count;
+            } else if (nodes[node].kind == STATIC_OPERATION) {
+                for (std::uint32_t i = 0; i < nodes[node].count; i++) {
+                    std::uint32_t operand = operandOf(node, i);
+                    schedule(operand);
+                    uses[operand]++;
+                }
+            }
+        }
+
+        constexpr std::uint32_t constantRegister(double value) {
+            program.constants[program.constantCount] = value;
+            return program.constantCount++;
+        }
+
+        constexpr std::uint32_t emit(StaticOpCode opCode, std::uint32_t a, std::uint32_t b) {
+            if (program.instructionCount == CAPACITY || program.constantCount == CAPACITY) {
+                fail(STATIC_TOO_LARGE);
+                return 0;
+            }
+            StaticInstruction &instruction = program.instructions[program.instructionCount];
+            instruction.opCode = opCode;
+            instruction.a = a;
+            instruction.b = b;
+            instruction.dst = (2U << 30) | program.instructionCount++;
+            return instruction.dst;
+        }
+
+        constexpr std::uint32_t lowerPower(std::uint32_t base, double exponent) {
+            auto integral = (std::int64_t) exponent;
+            if (exponent == (double) integral && integral >= -STATIC_MAX_INTEGER_EXPONENT && integral <= STATIC_MAX_INTEGER_EXPONENT) {
+                return emit(STATIC_OPCODE_POWI, base, (std::uint32_t) (std::int32_t) integral);
+            } else if (exponent == 0.5) {
+                return emit(STATIC_OPCODE_SQRT, base, 0);
+            }
+            return emit(STATIC_OPCODE_POW, base, constantRegister(exponent));
+        }
+
+        constexpr bool isShared(std::uint32_t node) const {
+            return uses[node] > 1;
+        }
+
+        constexpr std::uint32_t lowerSum(std::uint32_t sum) {
+            StaticNumber total = StaticNumber::real(0);
+            std::uint32_t accumulator = 0;
+            bool started = false;
+            std::uint32_t subtracted = scratchCount;
+            for (std::uint32_t i = 0; i < nodes[sum].count; i++) {
+                std::uint32_t term = operandOf(sum, i);
+                if (nodes[term].kind == STATIC_CONSTANT) {
+                    if (!StaticNumber::addReals(total.inexact, nodes[term].number.toDouble(), total)) {
+                        fail(STATIC_NOT_FOLDABLE);
+                    }
+                    continue;
+                }
+                if (isOperation(term, STATIC_MUL) && !isShared(term)) {
+                    std::uint32_t coefficient = operandOf(term, 0);
+                    if (nodes[coefficient].kind == STATIC_CONSTANT && nodes[coefficient].number.toDouble() < 0) {
+                        pushScratch(term);
+                        continue;
+                    }
+                }
+                std::uint32_t value = lower(term);
+                accumulator = started ? emit(STATIC_OPCODE_ADD, accumulator, value) : value;
+                started = true;
+            }
+            for (std::uint32_t i = subtracted; i < scratchCount; i++) {
+                std::uint32_t term = scratch[i];
+                double coefficient = nodes[operandOf(term, 0)].number.toDouble();
+                const std::uint32_t *factors = operands + nodes[term].first + 1;
+                if (!started) {
+                    accumulator = lowerProduct(coefficient, factors, nodes[term].count - 1);
+                    started = true;
+                } else {
+                    std::uint32_t value = lowerProduct(-coefficient, factors, nodes[term].count - 1);
+                    accumulator = emit(STATIC_OPCODE_SUB, accumulator, value);
+                }
+            }
+            scratchCount = subtracted;
+            if (!started) {
+                return constantRegister(total.inexact);
+            }
+            if (total.inexact != 0) {
+                accumulator = emit(STATIC_OPCODE_ADD, accumulator, constantRegister(total.inexact));
+            }
+            return accumulator;
+        }
+
+        constexpr std::uint32_t lowerProduct(double coefficient, const std::uint32_t *factors, std::uint32_t count) {
+            std::uint32_t accumulator = 0;
+            bool started = false;
+            std::uint32_t divisors = scratchCount;
+            StaticNumber product = StaticNumber::real(coefficient);
+            for (std::uint32_t i = 0; i < count; i++) {
+                std::uint32_t factor = factors[i];
+                if (nodes[factor].kind == STATIC_CONSTANT) {
+                    if (!StaticNumber::multiplyReals(product.inexact, nodes[factor].number.toDouble(), product)) {
+                        fail(STATIC_NOT_FOLDABLE);
+                    }
+                    continue;
+                }
+                if (isOperation(factor, STATIC_EXP) && !isShared(factor)) {
+                    std::uint32_t exponent = operandOf(factor, 1);
+                    if (nodes[exponent].kind == STATIC_CONSTANT && nodes[exponent].number.toDouble() < 0) {
+                        pushScratch(factor);
+                        continue;
+                    }
+                }
+                std::uint32_t value = lower(factor);
+                accumulator = started ? emit(STATIC_OPCODE_MUL, accumulator, value) : value;
+                started = true;
+            }
+            if (!started || product.inexact != 1) {
+                std::uint32_t value = constantRegister(product.inexact);
+                accumulator = started ? emit(STATIC_OPCODE_MUL, value, accumulator) : value;
+            }
+            for (std::uint32_t i = divisors; i < scratchCount; i++) {
+                std::uint32_t power = scratch[i];
+                std::uint32_t value = lower(operandOf(power, 0));
+                double exponent = -nodes[operandOf(power, 1)].number.toDouble();
+                if (exponent != 1) {
+                    value = lowerPower(value, exponent);
+                }
+                accumulator = emit(STATIC_OPCODE_DIV, accumulator, value);
+            }
+            scratchCount = divisors;
+            return accumulator;
+        }
+
+        constexpr std::uint32_t lowerOperation(std::uint32_t node) {
+            StaticOperation opType = nodes[node].opType;
+            if (opType == STATIC_ADD) {
+                return lowerSum(node);
+            } else if (opType == STATIC_MUL) {
+                return lowerProduct(1, operands + nodes[node].first, nodes[node].count);
+            }
+            std::uint32_t left = operandOf(node, 0);
+            std::uint32_t right = operandOf(node, 1);
+            std::uint32_t base = lower(left);
+            if (opType == STATIC_EXP && nodes[right].kind == STATIC_CONSTANT && nodes[left].kind != STATIC_CONSTANT) {
+                return lowerPower(base, nodes[right].number.toDouble());
+            }
+            // Two constants left by the simplifier are computed the way Program folds them, the compiler folds them again.
+            std::uint32_t value = lower(right);
+            switch (opType) {
+                case STATIC_MIN:
+                    return emit(STATIC_OPCODE_SUB, base, value);
+                case STATIC_DIV:
+                    return emit(STATIC_OPCODE_DIV, base, value);
+                default:
+                    return emit(STATIC_OPCODE_POW, base, value);
+            }
+        }
+
+        /**
+         * Lower a node to instructions, as Program::lower, shared operations are lowered once.
+         */
+        constexpr std::uint32_t lower(std::uint32_t node) {
+            if (status != STATIC_COMPILED) {
+                return 0;
+            }
+            switch (nodes[node].kind) {
+                case STATIC_CONSTANT:
+                    if (program.constantCount == CAPACITY) {
+                        fail(STATIC_TOO_LARGE);
+                        return 0;
+                    }
+                    return constantRegister(nodes[node].number.toDouble());
+                case STATIC_VARIABLE:
+                    return (1U << 30) | (registers[node] - 1);
+                default:
+                    break;
+            }
+            if (!isShared(node)) {
+                return lowerOperation(node);
+            }
+            if (registers[node] == 0) {
+                registers[node] = lowerOperation(node) + 1;
+            }
+            return registers[node] - 1;
+        }
+    public:
+        explicit constexpr StaticCompiler(std::string_view source) : source(source) {
+
+        }
+
+        /**
+         * @return the program computing the simplified formula, its status tells if it compiled.
+         */
+        constexpr StaticProgram<CAPACITY> compile() {
+            std::uint32_t root = parse();
+            root = evaluate(root);
+            if (status == STATIC_COMPILED) {
+                schedule(root);
+                for (std::uint32_t i = 0; i < program.variableCount; i++) {
+                    registers[variable(program.names[i], program.nameLengths[i])] = i + 1;
+                }
+                program.result = lower(root);
+            }
+            program.status = status;
+            return program;
+        }
+    };
+
+    template <std::size_t CAPACITY>
+    constexpr StaticProgram<CAPACITY> compileStatic(std::string_view source) {
+        StaticCompiler<CAPACITY> compiler {source};
+        return compiler.compile();
+    }
+
+    /**
+     * A formula parsed, simplified and compiled to straight-line arithmetic
+     * at compile time, Source::text() returns its source. Create one with
+     * FLUXION_FORMULA, which needs C++17:
+     *
+     *     auto area = FLUXION_FORMULA("(a + b) * h / 2");
+     *     double value = area(3.0, 2.0, 4.0); // a, b, h
+     *
+     * Formulas are simplified as by Session::simplify with exact numbers,
+     * and computed as a Program would compute the result, variables are
+     * bound in the order of their names. Exact constants that do not fit in
+     * 64 bits continue in doubles rather than bignums. A formula that does
+     * not parse, or whose simplification folds constants into something
+     * that is not a finite double, such as 1 / 0, does not compile.
+     */
+    template <typename Source>
+    class StaticFormula {
+    private:
+        static constexpr std::string_view source {Source::text()};
+        static constexpr std::size_t CAPACITY = source.size() * STATIC_NODES_PER_CHARACTER + STATIC_EXTRA_NODES;
+        static constexpr StaticProgram<CAPACITY> program = compileStatic<CAPACITY>(source);
+        static_assert(program.status != STATIC_MALFORMED, "The formula is malformed.");
+        static_assert(program.status != STATIC_TOO_LARGE, "The formula simplifies into more nodes than are reserved for it.");
+        static_assert(program.status != STATIC_NOT_FOLDABLE, "The formula folds constants that do not fit in 64 bits, or are not finite.");
+
+        template <std::uint32_t REGISTER>
+        static inline double read(const double *values, const double *temporaries) {
+            if constexpr ((REGISTER >> 30) == 0) {
+                return program.constants[REGISTER];
+            } else if constexpr ((REGISTER >> 30) == 1) {
+                return values[REGISTER & 0x3fffffffU];
+            } else {
+                return temporaries[REGISTER & 0x3fffffffU];
+            }
+        }
+
+        template <std::size_t INDEX>
+        static inline void step(const double *values, double *temporaries) {
+            constexpr StaticInstruction instruction = program.instructions[INDEX];
+            double a = read<instruction.a>(values, temporaries);
+            if constexpr (instruction.opCode == STATIC_OPCODE_POWI) {
+                temporaries[INDEX] = staticPowi(a, (std::int32_t) instruction.b);
+            } else if constexpr (instruction.opCode == STATIC_OPCODE_SQRT) {
+                temporaries[INDEX] = std::sqrt(a);
+            } else {
+                double b = read<instruction.b>(values, temporaries);
+                if constexpr (instruction.opCode == STATIC_OPCODE_ADD) {
+                    temporaries[INDEX] = a + b;
+                } else if constexpr (instruction.opCode == STATIC_OPCODE_SUB) {
+                    temporaries[INDEX] = a - b;
+                } else if constexpr (instruction.opCode == STATIC_OPCODE_MUL) {
+                    temporaries[INDEX] = a * b;
+                } else if constexpr (instruction.opCode == STATIC_OPCODE_DIV) {
+                    temporaries[INDEX] = a / b;
+                } else {
+                    temporaries[INDEX] = std::pow(a, b);
+                }
+            }
+        }
+
+        template <std::size_t... INDICES>
+        static inline double run(const double *values, std::index_sequence<INDICES...>) {
+            double temporaries[sizeof...(INDICES) + 1] {};
+            (step<INDICES>(values, temporaries), ...);
+            return read<program.result>(values, temporaries);
+        }
+    public:
+        static constexpr std::size_t variableCount = program.variableCount;
+
+        /**
+         * @return name of the variable bound at an index.
+         */
+        static constexpr std::string_view getVariable(std::size_t index) {
+            return source.substr(program.names[index], program.nameLengths[index]);
+        }
+
+        /**
+         * @param values Value of each variable, in the order of getVariable.
+         */
+        double evaluate(const double *values) const {
+            return run(values, std::make_index_sequence<program.instructionCount> {});
+        }
+
+        template <typename... Values>
+        double operator()(Values... values) const {
+            static_assert(sizeof...(Values) == variableCount, "Pass one value per variable, in the order of their names.");
+            const double bound[] = {(double) values..., 0};
+            return evaluate(bound);
+        }
+    };
+}
+
+/**
+ * Compile a formula given as a string literal, see fluxion::StaticFormula.
+ */
+#define FLUXION_FORMULA(formula) \
+    ([] { \
+        struct FluxionSource { \
+            static constexpr const char *text() {return formula;} \
+        }; \
+        return fluxion::StaticFormula<FluxionSource> {}; \
+    }())
+
+#endif
+
+#endif //FLUXION_STATICFORMULA_H
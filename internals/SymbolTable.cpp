@@ -0,0 +1,77 @@
+#include "SymbolTable.h"
+
+namespace {
+    /**
+     * @return the chunk holding a symbol, and sets offset to its position in the chunk.
+     */
+    inline std::uint32_t chunkOf(symbol_t symbol, std::uint32_t &offset) {
+        // Chunk k starts at symbol 64 * (2^k - 1), so it is the highest bit of symbol / 64 + 1.
+        std::uint64_t position = ((std::uint64_t) symbol >> SYMBOL_FIRST_CHUNK_BITS) + 1;
+        std::uint32_t chunk = 0;
+#if defined(__GNUC__)
+        chunk = 63 - (std::uint32_t) __builtin_clzll(position);
+#else
+        while ((position >> (chunk + 1)) != 0) {
+            chunk++;
+        }
+#endif
+        offset = (std::uint32_t) (symbol - (((1ULL << chunk) - 1) << SYMBOL_FIRST_CHUNK_BITS));
+        return chunk;
+    }
+}
+
+SymbolTable::SymbolTable() : count(0) {
+    for (std::atomic<std::string*> &chunk : chunks) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+SymbolTable::~SymbolTable() {
+    for (std::atomic<std::string*> &chunk : chunks) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+SymbolTable &SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+std::string &SymbolTable::slotOf(symbol_t symbol) const {
+    std::uint32_t offset;
+    std::uint32_t chunk = chunkOf(symbol, offset);
+    return chunks[chunk].load(std::memory_order_acquire)[offset];
+}
+
+symbol_t SymbolTable::intern(StringSlice name) {
+    // Names never move, so the slices of the cache stay valid for the life of the thread.
+    thread_local Index seen;
+    auto known = seen.find(name);
+    if (known != seen.end()) {
+        return known->second;
+    }
+    std::lock_guard<std::mutex> lock {mutex};
+    auto found = symbols.find(name);
+    if (found == symbols.end()) {
+        symbol_t symbol = count.load(std::memory_order_relaxed);
+        std::uint32_t offset;
+        std::uint32_t chunk = chunkOf(symbol, offset);
+        if (offset == 0) {
+            chunks[chunk].store(new std::string[(std::size_t) 1 << (chunk + SYMBOL_FIRST_CHUNK_BITS)], std::memory_order_release);
+        }
+        std::string &slot = slotOf(symbol);
+        slot.assign(name.data, name.length);
+        found = symbols.emplace(StringSlice {slot.data(), slot.size()}, symbol).first;
+        count.store(symbol + 1, std::memory_order_release);
+    }
+    seen.emplace(found->first, found->second);
+    return found->second;
+}
+
+const std::string &SymbolTable::getName(symbol_t symbol) const {
+    return slotOf(symbol);
+}
+
+std::size_t SymbolTable::size() const {
+    return count.load(std::memory_order_acquire);
+}
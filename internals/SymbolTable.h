@@ -0,0 +1,75 @@
+#ifndef FLUXION_SYMBOLTABLE_H
+#define FLUXION_SYMBOLTABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "util.h"
+
+#define SYMBOL_FIRST_CHUNK_BITS 6 // The first chunk of names holds 64 of them, each next one twice as many.
+#define SYMBOL_CHUNK_COUNT 27 // Enough chunks for every 32-bit symbol.
+
+/**
+ * Dense id of an interned name.
+ */
+typedef std::uint32_t symbol_t;
+
+/**
+ * Process wide interner of variable names. Each distinct name is given
+ * a symbol the first time it is seen, symbols are dense and never
+ * reused, so variables compare, hash and bind by integer rather than
+ * by string.
+ *
+ * Interning is thread safe, each thread remembers the names it has
+ * seen, so only names new to a thread take the lock. Names are kept for
+ * the life of the process and never move, reading one takes no lock.
+ *
+ * Neither the table nor the cache of each thread ever reclaims a name,
+ * so both grow with every distinct name for the life of the process, or
+ * of the thread for its cache.
+ */
+class SymbolTable {
+private:
+    struct SliceHash {
+        std::size_t operator()(StringSlice slice) const {
+            return (std::size_t) hashValue(slice);
+        }
+    };
+    struct SliceEqual {
+        bool operator()(StringSlice a, StringSlice b) const {
+            return a.length == b.length && std::char_traits<char>::compare(a.data, b.data, a.length) == 0;
+        }
+    };
+    typedef std::unordered_map<StringSlice, symbol_t, SliceHash, SliceEqual> Index; // Keys point into the names.
+    std::mutex mutex;
+    Index symbols;
+    std::atomic<std::string*> chunks[SYMBOL_CHUNK_COUNT]; // Chunk k holds the names of 64 << k symbols.
+    std::atomic<symbol_t> count;
+    /**
+     * @return where the name of a symbol is stored, its chunk must exist.
+     */
+    std::string &slotOf(symbol_t symbol) const;
+    SymbolTable();
+public:
+    static SymbolTable &global();
+    /**
+     * @return the symbol of the name, the same for every call with an equal name.
+     */
+    symbol_t intern(StringSlice name);
+    /**
+     * @param symbol A symbol returned by intern.
+     * @return its name, valid for the life of the process.
+     */
+    const std::string &getName(symbol_t symbol) const;
+    /**
+     * @return number of distinct names interned.
+     */
+    std::size_t size() const;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable &operator=(const SymbolTable&) = delete;
+    ~SymbolTable();
+};
+
+#endif //FLUXION_SYMBOLTABLE_H
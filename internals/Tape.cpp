@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include "Tape.h"
+
+Tape::Tape(Expression *expression) : program(expression), result(0), slotCount(0) {
+    // Constants and variables keep their registers, the instruction at
+    // position i writes slot temporaryBase + i, so no slot is overwritten.
+    std::uint32_t temporaryBase = program.getTemporaryBase();
+    std::vector<std::uint32_t> current(program.getRegisterCount() - temporaryBase); // Slot holding each temporary.
+    auto slotOf = [&](std::uint32_t reg) {
+        return reg < temporaryBase ? reg : current[reg - temporaryBase];
+    };
+    const std::vector<Instruction> &source = program.getInstructions();
+    instructions.reserve(source.size());
+    for (const Instruction &instruction : source) {
+        Instruction renamed = instruction;
+        renamed.a = slotOf(instruction.a);
+        if (instruction.opCode != OPCODE_POWI && instruction.opCode != OPCODE_SQRT) {
+            renamed.b = slotOf(instruction.b);
+        }
+        renamed.dst = temporaryBase + (std::uint32_t) instructions.size();
+        current[instruction.dst - temporaryBase] = renamed.dst;
+        instructions.push_back(renamed);
+    }
+    this->result = slotOf(program.getResult());
+    this->slotCount = temporaryBase + (std::uint32_t) instructions.size();
+}
+
+const std::vector<std::string> &Tape::getVariables() const {
+    return program.getVariables();
+}
+
+double Tape::evaluate(const double *values, double *gradient) const {
+    double stackSlots[2 * TAPE_STACK_SLOTS];
+    std::vector<double> heapSlots;
+    double *v = stackSlots;
+    if (slotCount > TAPE_STACK_SLOTS) {
+        heapSlots.resize(2 * (std::size_t) slotCount);
+        v = heapSlots.data();
+    }
+    double *adjoint = v + slotCount;
+    const std::vector<double> &constants = program.getConstants();
+    std::size_t variableBase = program.getVariableBase();
+    std::size_t variableCount = program.getVariables().size();
+    for (std::size_t i = 0; i < constants.size(); i++) {
+        v[i] = constants[i];
+    }
+    for (std::size_t i = 0; i < variableCount; i++) {
+        v[variableBase + i] = values[i];
+    }
+    // Forward sweep, like Program::evaluate.
+    for (const Instruction &instruction : instructions) {
+        double a = v[instruction.a];
+        switch (instruction.opCode) {
+            case OPCODE_ADD:
+                v[instruction.dst] = a + v[instruction.b];
+                break;
+            case OPCODE_SUB:
+                v[instruction.dst] = a - v[instruction.b];
+                break;
+            case OPCODE_MUL:
+                v[instruction.dst] = a * v[instruction.b];
+                break;
+            case OPCODE_DIV:
+                v[instruction.dst] = a / v[instruction.b];
+                break;
+            case OPCODE_POW:
+                v[instruction.dst] = std::pow(a, v[instruction.b]);
+                break;
+            case OPCODE_POWI:
+                v[instruction.dst] = powi(a, (std::int32_t) instruction.b);
+                break;
+            case OPCODE_SQRT:
+                v[instruction.dst] = std::sqrt(a);
+                break;
+        }
+    }
+    // Reverse sweep, each instruction passes the adjoint of its slot on to its operands.
+    std::fill(adjoint, adjoint + slotCount, 0.0);
+    adjoint[result] = 1;
+    for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
+        const Instruction &instruction = *it;
+        double g = adjoint[instruction.dst];
+        if (g == 0) {
+            continue; // Does not reach the result, or only through a zero factor.
+        }
+        double a = v[instruction.a];
+        switch (instruction.opCode) {
+            case OPCODE_ADD:
+                adjoint[instruction.a] += g;
+                adjoint[instruction.b] += g;
+                break;
+            case OPCODE_SUB:
+                adjoint[instruction.a] += g;
+                adjoint[instruction.b] -= g;
+                break;
+            case OPCODE_MUL:
+                adjoint[instruction.a] += g * v[instruction.b];
+                adjoint[instruction.b] += g * a;
+                break;
+            case OPCODE_DIV:
+                adjoint[instruction.a] += g / v[instruction.b];
+                adjoint[instruction.b] -= g * v[instruction.dst] / v[instruction.b];
+                break;
+            case OPCODE_POW: {
+                double b = v[instruction.b];
+                adjoint[instruction.a] += g * b * std::pow(a, b - 1);
+                if (a > 0) {
+                    adjoint[instruction.b] += g * v[instruction.dst] * std::log(a);
+                }
+                break;
+            }
+            case OPCODE_POWI: {
+                auto exponent = (std::int32_t) instruction.b;
+                if (exponent != 0) {
+                    adjoint[instruction.a] += g * exponent * powi(a, exponent - 1);
+                }
+                break;
+            }
+            case OPCODE_SQRT:
+                adjoint[instruction.a] += g * 0.5 / v[instruction.dst];
+                break;
+        }
+    }
+    for (std::size_t i = 0; i < variableCount; i++) {
+        gradient[i] = adjoint[variableBase + i];
+    }
+    return v[result];
+}
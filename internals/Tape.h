@@ -0,0 +1,39 @@
+#ifndef FLUXION_TAPE_H
+#define FLUXION_TAPE_H
+
+#include <string>
+#include <vector>
+#include "Expression.h"
+#include "Bytecode.h"
+
+#define TAPE_STACK_SLOTS 128 // Tapes with at most this many slots are differentiated without allocating.
+
+/**
+ * Computes the value of an expression together with its gradient, by
+ * reverse mode automatic differentiation. The expression is lowered once
+ * into a register program, whose temporaries are then renamed so every
+ * instruction writes a slot of its own, keeping each intermediate value
+ * around for the reverse sweep. A forward and a reverse sweep over the
+ * tape give every partial derivative, however many variables there are.
+ */
+class Tape {
+private:
+    Program program;
+    std::vector<Instruction> instructions; // Those of the program, each writing its own slot.
+    std::uint32_t result;
+    std::uint32_t slotCount;
+public:
+    /**
+     * @return names of the variables, in the order values and derivatives are given.
+     */
+    const std::vector<std::string> &getVariables() const;
+    /**
+     * @param values Value of each variable, in the order of getVariables.
+     * @param gradient Set to the partial derivative with respect to each variable, in the same order.
+     * @return value of the expression.
+     */
+    double evaluate(const double *values, double *gradient) const;
+    explicit Tape(Expression *expression);
+};
+
+#endif //FLUXION_TAPE_H
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned size) : workers(new Worker[size == 0 ? 1 : size]), size(size == 0 ? 1 : size),
+                                        generation(0), remaining(0), stopping(false) {
+    for (unsigned i = 0; i < this->size; i++) {
+        threads.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock {mutex};
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+ThreadPool &ThreadPool::global() {
+    static ThreadPool pool {std::thread::hardware_concurrency()};
+    return pool;
+}
+
+unsigned ThreadPool::getSize() const {
+    return this->size;
+}
+
+bool ThreadPool::takeChunk(unsigned worker, Chunk &chunk) {
+    {
+        Worker &own = workers[worker];
+        std::lock_guard<std::mutex> lock {own.mutex};
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.back(); // Newest first, it is the one most likely to be in cache.
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+    for (unsigned i = 1; i < size; i++) {
+        Worker &victim = workers[(worker + i) % size];
+        std::lock_guard<std::mutex> lock {victim.mutex};
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front(); // Oldest, away from where the owner works.
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(unsigned worker) {
+    std::size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock {mutex};
+            wake.wait(lock, [&] {return stopping || generation != seen;});
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        Chunk chunk {};
+        while (takeChunk(worker, chunk)) {
+            for (std::size_t index = chunk.begin; index < chunk.end; index++) {
+                (*chunk.job)(index, worker);
+            }
+            if (remaining.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock {mutex};
+                finished.notify_all();
+            }
+        }
+    }
+}
+
+void ThreadPool::run(std::size_t count, const Job &body) {
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> running {runMutex};
+    std::size_t chunkSize = std::max<std::size_t>(1, count / ((std::size_t) size * POOL_CHUNKS_PER_WORKER));
+    std::size_t chunks = (count + chunkSize - 1) / chunkSize;
+    // Workers get contiguous runs of chunks, so neighbouring sources stay on one worker unless stolen.
+    std::size_t perWorker = (chunks + size - 1) / size;
+    remaining = chunks; // Before any chunk is visible, a worker may already be looking for one.
+    for (std::size_t i = 0; i < chunks; i++) {
+        Worker &worker = workers[i / perWorker];
+        std::lock_guard<std::mutex> lock {worker.mutex};
+        worker.chunks.push_front({i * chunkSize, std::min(count, (i + 1) * chunkSize), &body});
+    }
+    std::unique_lock<std::mutex> lock {mutex};
+    generation++;
+    wake.notify_all();
+    finished.wait(lock, [&] {return remaining.load() == 0;});
+}
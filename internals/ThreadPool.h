@@ -0,0 +1,67 @@
+#ifndef FLUXION_THREADPOOL_H
+#define FLUXION_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define POOL_CHUNKS_PER_WORKER 8 // More chunks balance better, fewer cost less synchronisation.
+
+/**
+ * A fixed set of worker threads running parallel loops with work
+ * stealing, each worker takes chunks of the loop from the back of its
+ * own queue, and when it runs out, steals from the front of the others.
+ */
+class ThreadPool {
+public:
+    /**
+     * Body of a parallel loop, called with the index of the iteration
+     * and the index of the worker running it.
+     */
+    typedef std::function<void(std::size_t index, unsigned worker)> Job;
+private:
+    struct Chunk {
+        std::size_t begin;
+        std::size_t end;
+        const Job *job; // Carried by the chunk, so a worker still looking for work after a loop cannot mix loops up.
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+    std::vector<std::thread> threads;
+    std::unique_ptr<Worker[]> workers;
+    unsigned size;
+    std::mutex mutex; // Guards starting and finishing loops.
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::size_t generation; // Incremented for every loop, so workers know there is new work.
+    std::atomic<std::size_t> remaining; // Chunks not yet completed.
+    bool stopping;
+    std::mutex runMutex; // Only one loop runs at a time.
+    void work(unsigned worker);
+    bool takeChunk(unsigned worker, Chunk &chunk);
+public:
+    /**
+     * Run job for every index in [0, count), returning once all are done.
+     * Must not be called from inside a job.
+     */
+    void run(std::size_t count, const Job &job);
+    unsigned getSize() const;
+    /**
+     * @return the pool shared by the library, with one worker per hardware thread.
+     */
+    static ThreadPool &global();
+    explicit ThreadPool(unsigned size);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+};
+
+#endif //FLUXION_THREADPOOL_H
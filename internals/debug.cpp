@@ -1,17 +1,17 @@
 #include <iostream>
 #include "debug.h"
 
-void debug::printToken(Token *token) {
+void debug::printToken(const Token &token) {
     char ops[] = {'+', '-', '/', '*', '^', '!'};
-    switch (token->getTokenType()) {
+    switch (token.getTokenType()) {
         case TOKEN_CONSTANT:
-            std::cout << "CONSTANT (" << dynamic_cast<ConstantToken*>(token)->getValue() << ")\n";
+            std::cout << "CONSTANT (" << token.getValue().toDouble() << ")\n";
             break;
         case TOKEN_VARIABLE:
-            std::cout << "VARIABLE (" << dynamic_cast<VariableToken*>(token)->getName() << ")\n";
+            std::cout << "VARIABLE (" << SymbolTable::global().getName(token.getSymbol()) << ")\n";
             break;
         case TOKEN_OPERATOR:
-            std::cout << "OPERATOR (" << ops[dynamic_cast<OperatorToken*>(token)->getOperationType()] << ")\n";
+            std::cout << "OPERATOR (" << ops[token.getOperationType()] << ")\n";
             break;
         case TOKEN_LEFT_PAREN:
             std::cout << "LEFT PAREN\n";
@@ -25,10 +25,10 @@ void debug::printToken(Token *token) {
     }
 }
 
-void debug::printTokens(const std::vector<Token*>& tokens) {
+void debug::printTokens(const std::vector<Token>& tokens) {
     std::cout << "DEBUG\nINDEX | LOCATION |   TYPE   |" << "\n";
-    for (auto token : tokens) {
-        std::cout << token->getIndex() << "\t" << token->getLocation() << "\t";
-        printToken(token);
+    for (std::size_t i = 0; i < tokens.size(); i++) {
+        std::cout << i << "\t" << tokens[i].getLocation() << "\t";
+        printToken(tokens[i]);
     }
 }
\ No newline at end of file
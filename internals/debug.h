@@ -5,8 +5,8 @@
 #include "Parser.h"
 
 namespace debug {
-    void printToken(Token *token);
-    void printTokens(const std::vector<Token*>& tokens);
+    void printToken(const Token &token);
+    void printTokens(const std::vector<Token>& tokens);
 }
 
 #endif //FLUXION_DEBUG_H
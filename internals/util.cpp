@@ -1,12 +1,41 @@
 #include <cmath>
+#include <cstring>
 #include "util.h"
+#include "NumberFormat.h"
 
-std::string hashValue(double value) {
-    return std::to_string(std::hash<double>{}(value));
+hash_t hashValue(std::uint64_t value) {
+    // splitmix64 finalizer, spreads the bits of small integers and enums.
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
 }
 
-std::string hashValue(const std::string& value) {
-    return std::to_string(std::hash<std::string>{}(value));
+hash_t hashValue(double value) {
+    if (value == 0.0) {
+        value = 0.0; // -0 and 0 are the same constant.
+    } else if (std::isnan(value)) {
+        value = NAN; // All NaNs are the same constant as well.
+    }
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return hashValue(bits);
+}
+
+hash_t hashValue(StringSlice value) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (std::size_t i = 0; i < value.length; i++) {
+        hash = (hash ^ (unsigned char) value.data[i]) * 0x100000001b3ULL;
+    }
+    return hashValue(hash);
+}
+
+hash_t hashValue(const std::string& value) {
+    return hashValue(StringSlice {value.data(), value.size()});
+}
+
+hash_t hashCombine(hash_t seed, hash_t value) {
+    return hashValue((std::uint64_t) (seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2))));
 }
 
 /**
@@ -94,11 +123,7 @@ namespace typing {
     }
 
     std::string prettyPrintNumber(double number) {
-        double integer_part;
-        if (std::modf(number, &integer_part) == 0.0) { // If it is actually an integer.
-            return std::to_string((int) integer_part);
-        } else {
-            return std::to_string(number);
-        }
+        char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+        return std::string(buffer, formatNumber(number, buffer));
     }
 };
\ No newline at end of file
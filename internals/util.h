@@ -2,11 +2,40 @@
 #define FLUXION_UTIL_H
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
-std::string hashValue(double value);
-std::string hashValue(const std::string &value);
+/**
+ * Fixed width structural hash used by expressions.
+ */
+typedef std::uint64_t hash_t;
+
+/**
+ * A non owning view of a part of a string, such as a name
+ * inside the source code.
+ */
+struct StringSlice {
+    const char *data;
+    std::size_t length;
+    inline std::string toString() const {return std::string(data, length);}
+    inline bool operator==(const std::string &other) const {
+        return other.size() == length && other.compare(0, length, data, length) == 0;
+    }
+};
+
+hash_t hashValue(double value);
+hash_t hashValue(const std::string &value);
+hash_t hashValue(StringSlice value);
+hash_t hashValue(std::uint64_t value);
+/**
+ * Mix a value into an existing hash, order dependent.
+ *
+ * @param seed Hash to combine into.
+ * @param value Value to add.
+ * @return the combined hash.
+ */
+hash_t hashCombine(hash_t seed, hash_t value);
 /**
  * Check if str equals to one of the chars.
  * @param chars
@@ -14,14 +43,6 @@ std::string hashValue(const std::string &value);
  * @return
  */
 bool contains(const char *chars, const std::string& str);
-template <typename T>
-std::vector<T> reverseVector(std::vector<T> vector) {
-    std::vector<T> newVector;
-    for (int i = vector.size() - 1; i >= 0; i--) {
-        newVector.push_back(vector[i]);
-    }
-    return newVector;
-}
 namespace typing {
     bool isNumber(const char *c_str);
     bool isIdentifier(const char *c_str);